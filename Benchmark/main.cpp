@@ -0,0 +1,76 @@
+#include "vulkEngBenchmark.hpp"
+
+//std
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+	bool parseScene(const std::string& name, VulkanEngine::BenchmarkScene& scene) {
+		using VulkanEngine::BenchmarkScene;
+		if (name == "cubes") scene = BenchmarkScene::Cubes;
+		else if (name == "unique-meshes") scene = BenchmarkScene::UniqueMeshes;
+		else if (name == "hierarchy") scene = BenchmarkScene::Hierarchy;
+		else return false;
+		return true;
+	}
+
+	bool parseCount(const std::string& text, uint32_t& count) {
+		try {
+			count = static_cast<uint32_t>(std::stoul(text));
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		return true;
+	}
+
+	bool parseArgs(int argc, char** argv, VulkanEngine::BenchmarkConfig& config) {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			size_t equals = arg.find('=');
+			std::string flag = arg.substr(0, equals);
+			std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+
+			bool ok = true;
+			if (flag == "--scene") ok = parseScene(value, config.scene);
+			else if (flag == "--objects") ok = parseCount(value, config.objectCount);
+			else if (flag == "--depth") ok = parseCount(value, config.hierarchyDepth);
+			else if (flag == "--warmup") ok = parseCount(value, config.warmupFrames);
+			else if (flag == "--frames") ok = parseCount(value, config.frames);
+			else if (flag == "--width") ok = parseCount(value, config.width);
+			else if (flag == "--height") ok = parseCount(value, config.height);
+			else if (flag == "--msaa") ok = parseCount(value, config.msaaSamples);
+			else if (flag == "--job-threads") ok = parseCount(value, config.jobThreads);
+			else if (flag == "--output") config.outputPath = value;
+			else if (arg == "--window") config.headless = false;
+			else ok = false;
+			if (!ok) return false;
+		}
+		return config.width > 0 && config.height > 0 && config.msaaSamples > 0;
+	}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	VulkanEngine::BenchmarkConfig config{};
+	if (!parseArgs(argc, argv, config)) {
+		std::cerr << "usage: " << argv[0]
+			<< " [--scene=cubes|unique-meshes|hierarchy] [--objects=<n>] [--depth=<n>]"
+			<< " [--warmup=<frames>] [--frames=<frames>] [--width=<px>] [--height=<px>]"
+			<< " [--msaa=1|2|4|8] [--job-threads=<n>] [--window] [--output=<path>|-]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try {
+		VulkanEngine::VulkEngBenchmark benchmark{ config };
+		benchmark.run();
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
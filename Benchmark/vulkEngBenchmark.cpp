@@ -0,0 +1,334 @@
+#include "vulkEngBenchmark.hpp"
+#include "vulkEngRenderSystem.hpp"
+#include "vulkEngUploadBatch.hpp"
+
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+//std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace VulkanEngine
+{
+	namespace {
+		constexpr float FRAME_DT = 1.f / 60.f;
+
+		// unit cube centered at the origin, every face shaded from base
+		std::vector<VulkEngModel::Vertex> makeCubeVertices(glm::vec3 base) {
+			const glm::vec3 corners[8] = {
+				{-.5f, -.5f, -.5f}, {.5f, -.5f, -.5f}, {.5f, .5f, -.5f}, {-.5f, .5f, -.5f},
+				{-.5f, -.5f, .5f}, {.5f, -.5f, .5f}, {.5f, .5f, .5f}, {-.5f, .5f, .5f} };
+			const int faces[6][4] = {
+				{0, 3, 7, 4}, {1, 5, 6, 2}, {0, 4, 5, 1}, {3, 2, 6, 7}, {4, 7, 6, 5}, {0, 1, 2, 3} };
+
+			std::vector<VulkEngModel::Vertex> vertices;
+			vertices.reserve(36);
+			for (int f = 0; f < 6; f++) {
+				glm::vec3 color = base * (0.5f + 0.1f * f);
+				const int* q = faces[f];
+				for (int index : { q[0], q[1], q[2], q[0], q[2], q[3] }) {
+					vertices.push_back({ corners[index], color });
+				}
+			}
+			return vertices;
+		}
+
+		glm::vec3 meshColor(uint32_t index) {
+			return {
+				0.3f + 0.7f * static_cast<float>((index * 37) % 101) / 100.f,
+				0.3f + 0.7f * static_cast<float>((index * 59) % 103) / 102.f,
+				0.3f + 0.7f * static_cast<float>((index * 83) % 107) / 106.f };
+		}
+
+		double percentile(std::vector<double> sorted, double p) {
+			if (sorted.empty()) {
+				return 0.0;
+			}
+			size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+			return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+		}
+
+		void writeDistribution(std::ostream& out, std::vector<double> samples) {
+			std::sort(samples.begin(), samples.end());
+			double mean = 0.0;
+			for (double sample : samples) {
+				mean += sample;
+			}
+			mean = samples.empty() ? 0.0 : mean / samples.size();
+			out << "{\"samples\": " << samples.size()
+				<< ", \"mean\": " << mean
+				<< ", \"min\": " << (samples.empty() ? 0.0 : samples.front())
+				<< ", \"p50\": " << percentile(samples, 50)
+				<< ", \"p90\": " << percentile(samples, 90)
+				<< ", \"p99\": " << percentile(samples, 99)
+				<< ", \"max\": " << (samples.empty() ? 0.0 : samples.back()) << "}";
+		}
+
+		// as a JSON string, quotes included
+		void writeJsonString(std::ostream& out, const char* text) {
+			out << '"';
+			for (const char* c = text; *c != '\0'; c++) {
+				unsigned char character = static_cast<unsigned char>(*c);
+				if (character == '"' || character == '\\') {
+					out << '\\' << *c;
+				}
+				else if (character < 0x20) {
+					const char* hex = "0123456789abcdef";
+					out << "\\u00" << hex[character >> 4] << hex[character & 0xF];
+				}
+				else {
+					out << *c;
+				}
+			}
+			out << '"';
+		}
+
+		const char* sceneName(BenchmarkScene scene) {
+			switch (scene) {
+			case BenchmarkScene::Cubes: return "cubes";
+			case BenchmarkScene::UniqueMeshes: return "unique-meshes";
+			case BenchmarkScene::Hierarchy: return "hierarchy";
+			}
+			return "unknown";
+		}
+	}
+
+	VulkEngBenchmark::VulkEngBenchmark(const BenchmarkConfig& benchmarkConfig)
+		: config{ benchmarkConfig },
+		vulkanWindow{ static_cast<int>(benchmarkConfig.width), static_cast<int>(benchmarkConfig.height), "Vulkan Engine Benchmark", benchmarkConfig.headless }
+	{
+		buildScene();
+	}
+
+	void VulkEngBenchmark::buildScene() {
+		VulkEngUploadBatch uploads{ vulkanDevice };
+		uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(config.objectCount))));
+
+		switch (config.scene) {
+		case BenchmarkScene::Cubes: {
+			std::shared_ptr<VulkEngModel> cube = std::make_shared<VulkEngModel>(vulkanDevice, uploads, makeCubeVertices({ 1.f, 1.f, 1.f }));
+			uniqueMeshCount = 1;
+			for (uint32_t i = 0; i < config.objectCount; i++) {
+				addGridObject(cube, i, columns);
+			}
+			break;
+		}
+		case BenchmarkScene::UniqueMeshes:
+			uniqueMeshCount = config.objectCount;
+			for (uint32_t i = 0; i < config.objectCount; i++) {
+				addGridObject(std::make_shared<VulkEngModel>(vulkanDevice, uploads, makeCubeVertices(meshColor(i))), i, columns);
+			}
+			break;
+		case BenchmarkScene::Hierarchy:
+			uniqueMeshCount = 1;
+			buildHierarchy(std::make_shared<VulkEngModel>(vulkanDevice, uploads, makeCubeVertices({ 1.f, 1.f, 1.f })));
+			break;
+		}
+
+		vulkanDevice.waitForUpload(uploads.submit());
+		for (const auto& obj : gameObjects) {
+			verticesPerFrame += obj.model->getVertexCount();
+		}
+	}
+
+	// lays objects out on a grid covering clip space, since the renderer has no camera
+	void VulkEngBenchmark::addGridObject(std::shared_ptr<VulkEngModel> model, uint32_t index, uint32_t columns) {
+		float cell = 2.f / static_cast<float>(columns);
+		auto obj = VulkEngGameObj::createGameObject();
+		obj.model = std::move(model);
+		obj.transform.translation = {
+			-1.f + cell * (static_cast<float>(index % columns) + .5f),
+			-1.f + cell * (static_cast<float>(index / columns) + .5f),
+			.5f };
+		obj.transform.scale = glm::vec3{ cell * .5f };
+		obj.transform.rotationRadians = { 0.f, 0.01f * static_cast<float>(index), 0.f };
+		gameObjects.push_back(std::move(obj));
+	}
+
+	// Each chain starts at a grid cell and every node is offset, scaled and yawed relative to its
+	// parent. Only yaw and uniform scale are used so world transforms compose exactly into the
+	// translation/rotation/scale of TransformComponent.
+	void VulkEngBenchmark::buildHierarchy(std::shared_ptr<VulkEngModel> model) {
+		uint32_t depth = std::max(config.hierarchyDepth, 1u);
+		uint32_t chains = (config.objectCount + depth - 1) / depth;
+		uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(chains))));
+		float cell = 2.f / static_cast<float>(columns);
+
+		for (uint32_t i = 0; i < config.objectCount; i++) {
+			uint32_t chain = i / depth;
+			bool root = i % depth == 0;
+			HierarchyNode node{};
+			node.parent = root ? -1 : static_cast<int32_t>(i - 1);
+			node.localTranslation = root
+				? glm::vec3{ -1.f + cell * (static_cast<float>(chain % columns) + .5f), -1.f + cell * (static_cast<float>(chain / columns) + .5f), .5f }
+				: glm::vec3{ .6f, 0.f, 0.f };
+			node.localScale = root ? cell * .3f : .85f;
+			node.localYaw = 0.f;
+			node.yawSpeed = 0.5f + 0.05f * static_cast<float>(i % depth);
+			hierarchy.push_back(node);
+
+			auto obj = VulkEngGameObj::createGameObject();
+			obj.model = model;
+			gameObjects.push_back(std::move(obj));
+		}
+		updateHierarchy(0.f);
+	}
+
+	void VulkEngBenchmark::updateHierarchy(float dt) {
+		for (size_t i = 0; i < hierarchy.size(); i++) {
+			HierarchyNode& node = hierarchy[i];
+			node.localYaw = glm::mod(node.localYaw + node.yawSpeed * dt, 2.f * glm::pi<float>());
+
+			TransformComponent& world = gameObjects[i].transform;
+			if (node.parent < 0) {
+				world.translation = node.localTranslation;
+				world.scale = glm::vec3{ node.localScale };
+				world.rotationRadians = { 0.f, node.localYaw, 0.f };
+				continue;
+			}
+
+			// parents precede their children, so the parent's world transform is already current
+			const TransformComponent& parent = gameObjects[node.parent].transform;
+			float yaw = parent.rotationRadians.y;
+			glm::vec3 offset = parent.scale.x * node.localTranslation;
+			world.translation = parent.translation + glm::vec3{
+				glm::cos(yaw) * offset.x + glm::sin(yaw) * offset.z,
+				offset.y,
+				-glm::sin(yaw) * offset.x + glm::cos(yaw) * offset.z };
+			world.scale = parent.scale * node.localScale;
+			world.rotationRadians = { 0.f, yaw + node.localYaw, 0.f };
+		}
+	}
+
+	void VulkEngBenchmark::run() {
+		VulkEngRenderSystem vulkEngRenderSystem{
+			vulkanDevice,
+			vulkEngRenderer.getSwapChainRenderTarget(),
+			vulkEngRenderer.getGpuProfiler() };
+		VulkEngGpuProfiler& gpuProfiler = vulkEngRenderer.getGpuProfiler();
+
+		cpuFrameMilliseconds.reserve(config.frames);
+		gpuFrameMilliseconds.reserve(config.frames);
+
+		uint32_t totalFrames = config.warmupFrames + config.frames;
+		auto start = std::chrono::steady_clock::now();
+		auto measuredStart = start;
+		for (uint32_t frame = 0; frame < totalFrames && !vulkanWindow.shouldClose(); frame++) {
+			if (frame == config.warmupFrames) {
+				measuredStart = std::chrono::steady_clock::now();
+			}
+			auto frameStart = std::chrono::steady_clock::now();
+
+			vulkanWindow.pollEvents();
+			if (config.scene == BenchmarkScene::Hierarchy) {
+				updateHierarchy(FRAME_DT);
+			}
+
+			if (auto commandBuffer = vulkEngRenderer.beginFrame()) {
+				vulkEngRenderSystem.prepareFrame(jobSystem, gameObjects);
+				vulkEngRenderer.beginSwapChainRenderPass(commandBuffer);
+				vulkEngRenderSystem.renderGameObjects(commandBuffer, gameObjects);
+				vulkEngRenderer.endSwapChainRenderPass(commandBuffer);
+				vulkEngRenderer.endFrame();
+			}
+
+			if (frame < config.warmupFrames) {
+				continue;
+			}
+			cpuFrameMilliseconds.push_back(
+				std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+
+			// the profiler reports frames MAX_FRAMES_IN_FLIGHT behind; until then its results are from
+			// warmup frames
+			if (frame < config.warmupFrames + VulkEngSwapChain::MAX_FRAMES_IN_FLIGHT) {
+				continue;
+			}
+			for (const auto& result : gpuProfiler.getResults()) {
+				if (result.depth == 0 && result.name == "frame") {
+					gpuFrameMilliseconds.push_back(result.milliseconds);
+				}
+				if (result.hasStatistics) {
+					passStatistics.push_back(result.statistics);
+					passOverdraw.push_back(result.overdraw());
+				}
+			}
+		}
+		vkDeviceWaitIdle(vulkanDevice.device());
+		double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - measuredStart).count();
+
+		if (config.outputPath == "-") {
+			writeReport(std::cout, totalSeconds);
+			return;
+		}
+		std::ofstream out{ config.outputPath, std::ios::trunc };
+		if (!out) {
+			throw std::runtime_error("failed to open benchmark output file: " + config.outputPath);
+		}
+		writeReport(out, totalSeconds);
+		std::cout << "wrote benchmark report to " << config.outputPath << std::endl;
+	}
+
+	void VulkEngBenchmark::writeReport(std::ostream& out, double totalSeconds) {
+		GpuPipelineStatistics average{};
+		for (const auto& stats : passStatistics) {
+			average.inputAssemblyVertices += stats.inputAssemblyVertices;
+			average.inputAssemblyPrimitives += stats.inputAssemblyPrimitives;
+			average.vertexShaderInvocations += stats.vertexShaderInvocations;
+			average.clippingInvocations += stats.clippingInvocations;
+			average.clippingPrimitives += stats.clippingPrimitives;
+			average.fragmentShaderInvocations += stats.fragmentShaderInvocations;
+		}
+		uint64_t samples = std::max<uint64_t>(passStatistics.size(), 1);
+		double overdraw = 0.0;
+		for (double passOverdrawSample : passOverdraw) {
+			overdraw += passOverdrawSample;
+		}
+
+		out << "{\n"
+			<< "  \"scene\": \"" << sceneName(config.scene) << "\",\n"
+			<< "  \"device\": ";
+		writeJsonString(out, vulkanDevice.properties.deviceName);
+		out << ",\n"
+			<< "  \"headless\": " << (config.headless ? "true" : "false") << ",\n"
+			<< "  \"extent\": [" << config.width << ", " << config.height << "],\n"
+			<< "  \"msaaSamples\": " << static_cast<uint32_t>(vulkEngRenderer.getSampleCount()) << ",\n"
+			<< "  \"objects\": " << gameObjects.size() << ",\n"
+			<< "  \"jobThreads\": " << jobSystem.getThreadCount() << ",\n"
+			<< "  \"uniqueMeshes\": " << uniqueMeshCount << ",\n"
+			<< "  \"hierarchyDepth\": " << (config.scene == BenchmarkScene::Hierarchy ? config.hierarchyDepth : 0) << ",\n"
+			<< "  \"warmupFrames\": " << config.warmupFrames << ",\n"
+			<< "  \"frames\": " << cpuFrameMilliseconds.size() << ",\n"
+			<< "  \"totalSeconds\": " << totalSeconds << ",\n"
+			<< "  \"drawsPerFrame\": " << gameObjects.size() << ",\n"
+			<< "  \"verticesPerFrame\": " << verticesPerFrame << ",\n"
+			<< "  \"cpuFrameMs\": ";
+		writeDistribution(out, cpuFrameMilliseconds);
+		out << ",\n  \"gpuFrameMs\": ";
+		if (vulkEngRenderer.getGpuProfiler().isEnabled()) {
+			writeDistribution(out, gpuFrameMilliseconds);
+		}
+		else {
+			out << "null";
+		}
+		out << ",\n  \"pipelineStatistics\": ";
+		if (!passStatistics.empty()) {
+			out << "{\"vertexShaderInvocations\": " << average.vertexShaderInvocations / samples
+				<< ", \"clippingPrimitives\": " << average.clippingPrimitives / samples
+				<< ", \"fragmentShaderInvocations\": " << average.fragmentShaderInvocations / samples
+				<< ", \"overdraw\": " << overdraw / samples << "}";
+		}
+		else {
+			out << "null";
+		}
+		out << "\n}" << std::endl;
+	}
+
+} // namespace VulkanEngine
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "vulkEngWindow.hpp"
+#include "vulkEngDevice.hpp"
+#include "vulkEngRenderer.hpp"
+#include "vulkEngGameObj.hpp"
+#include "vulkEngJobSystem.hpp"
+
+//std
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace VulkanEngine {
+
+	enum class BenchmarkScene {
+		Cubes,			// objectCount instances of one cube mesh
+		UniqueMeshes,	// objectCount cubes, each with its own vertex buffer
+		Hierarchy		// chains of hierarchyDepth cubes whose world transforms are rebuilt every frame
+	};
+
+	struct BenchmarkConfig {
+		BenchmarkScene scene = BenchmarkScene::Cubes;
+		uint32_t objectCount = 1000;
+		uint32_t hierarchyDepth = 16;
+		uint32_t warmupFrames = 60;
+		uint32_t frames = 600;
+		uint32_t width = 1280;
+		uint32_t height = 720;
+		bool headless = true;
+		// requested samples per pixel; the report has the count the device allowed
+		uint32_t msaaSamples = 1;
+		// job system worker threads besides the main thread, 0 for one per remaining hardware thread
+		uint32_t jobThreads = 0;
+		// "-" writes the report to stdout, where it follows the device's startup log
+		std::string outputPath = "benchmark.json";
+	};
+
+	// Renders a synthetic scene for a fixed number of frames as fast as the device allows and
+	// reports CPU and GPU frame times as JSON.
+	class VulkEngBenchmark {
+
+	public:
+		VulkEngBenchmark(const BenchmarkConfig& benchmarkConfig);
+
+		VulkEngBenchmark(const VulkEngBenchmark&) = delete;
+		VulkEngBenchmark& operator=(const VulkEngBenchmark&) = delete;
+
+		void run();
+
+	private:
+		struct HierarchyNode {
+			int32_t parent;
+			glm::vec3 localTranslation;
+			float localScale;
+			float localYaw;
+			float yawSpeed;
+		};
+
+		void buildScene();
+		void addGridObject(std::shared_ptr<VulkEngModel> model, uint32_t index, uint32_t columns);
+		void buildHierarchy(std::shared_ptr<VulkEngModel> model);
+		void updateHierarchy(float dt);
+		void writeReport(std::ostream& out, double totalSeconds);
+
+		BenchmarkConfig config;
+		VulkEngJobSystem jobSystem{ config.jobThreads };
+		VulkEngWindow vulkanWindow;
+		VulkEngDevice vulkanDevice{ vulkanWindow };
+		VulkEngRenderer vulkEngRenderer{ vulkanWindow, vulkanDevice, PresentPolicy::Uncapped, config.msaaSamples };
+
+		std::vector<VulkEngGameObj> gameObjects;
+		std::vector<HierarchyNode> hierarchy;
+		uint32_t uniqueMeshCount = 0;
+		uint64_t verticesPerFrame = 0;
+
+		std::vector<double> cpuFrameMilliseconds;
+		std::vector<double> gpuFrameMilliseconds;
+		std::vector<GpuPipelineStatistics> passStatistics;
+		std::vector<double> passOverdraw;
+	};
+
+} // namespace VulkanEngine
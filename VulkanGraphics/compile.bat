@@ -1,3 +1,7 @@
-C:\VulkanSDK\1.4.335.0\Bin\glslc.exe shaders/simpleShader.vert -o shaders/simpleShader.vert.spv
-C:\VulkanSDK\1.4.335.0\Bin\glslc.exe shaders/simpleShader.frag -o shaders/simpleShader.frag.spv
+"%VULKAN_SDK%\Bin\glslc.exe" shaders/simpleShader.vert -o shaders/simpleShader.vert.spv
+"%VULKAN_SDK%\Bin\glslc.exe" shaders/simpleShader.frag -o shaders/simpleShader.frag.spv
+"%VULKAN_SDK%\Bin\glslc.exe" shaders/depthOnly.vert -o shaders/depthOnly.vert.spv
+"%VULKAN_SDK%\Bin\glslc.exe" shaders/culledShader.vert -o shaders/culledShader.vert.spv
+"%VULKAN_SDK%\Bin\glslc.exe" shaders/occlusionCull.comp -o shaders/occlusionCull.comp.spv
+"%VULKAN_SDK%\Bin\glslc.exe" shaders/depthPyramid.comp -o shaders/depthPyramid.comp.spv
 pause
\ No newline at end of file
@@ -4,11 +4,161 @@
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
-int main() {
-	VulkanEngine::VulkEngApp app;
+namespace {
+
+	bool parsePresentPolicy(const std::string& name, VulkanEngine::PresentPolicy& policy) {
+		using VulkanEngine::PresentPolicy;
+		if (name == "lowlatency") policy = PresentPolicy::LowLatency;
+		else if (name == "powersaving") policy = PresentPolicy::PowerSaving;
+		else if (name == "uncapped") policy = PresentPolicy::Uncapped;
+		else if (name == "vsync") policy = PresentPolicy::VSync;
+		else return false;
+		return true;
+	}
+
+	bool parseCullMode(const std::string& name, VkCullModeFlags& cullMode) {
+		if (name == "back") cullMode = VK_CULL_MODE_BACK_BIT;
+		else if (name == "front") cullMode = VK_CULL_MODE_FRONT_BIT;
+		else if (name == "none") cullMode = VK_CULL_MODE_NONE;
+		else return false;
+		return true;
+	}
+
+	bool parseCount(const std::string& text, uint32_t& count) {
+		try {
+			count = static_cast<uint32_t>(std::stoul(text));
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		return true;
+	}
+
+	bool parseMilliseconds(const std::string& text, double& milliseconds) {
+		try {
+			milliseconds = std::stod(text);
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		return milliseconds > 0.0;
+	}
+
+	bool parseReadback(const std::string& text, VulkanEngine::FrameReadbackConfig& readback) {
+		using VulkanEngine::ReadbackOutput;
+		size_t separator = text.find(':');
+		if (separator == std::string::npos || separator + 1 == text.size()) return false;
+		std::string output = text.substr(0, separator);
+		if (output == "raw") readback.output = ReadbackOutput::RawSequence;
+		else if (output == "png") readback.output = ReadbackOutput::PngSequence;
+		else if (output == "pipe") readback.output = ReadbackOutput::Pipe;
+		else return false;
+		readback.target = text.substr(separator + 1);
+		return true;
+	}
+
+	bool parseSampleCount(const std::string& text, uint32_t& samples) {
+		if (text == "1") samples = 1;
+		else if (text == "2") samples = 2;
+		else if (text == "4") samples = 4;
+		else if (text == "8") samples = 8;
+		else return false;
+		return true;
+	}
+
+	bool parseArgs(int argc, char** argv, VulkanEngine::VulkEngAppConfig& config) {
+		const std::string presentFlag = "--present=";
+		const std::string gpuProfileFlag = "--gpu-profile=";
+		const std::string cpuTraceFlag = "--cpu-trace=";
+		const std::string cpuTraceFileFlag = "--cpu-trace-file=";
+		const std::string captureFlag = "--capture=";
+		const std::string replayFlag = "--replay=";
+		const std::string hotReloadFlag = "--hot-reload=";
+		const std::string cullFlag = "--cull=";
+		const std::string depthPrepassFlag = "--depth-prepass";
+		const std::string occlusionCullingFlag = "--occlusion-culling";
+		const std::string objectColorsFlag = "--object-colors";
+		const std::string msaaFlag = "--msaa=";
+		const std::string dynamicResolutionFlag = "--dynamic-resolution=";
+		const std::string readbackFlag = "--readback=";
+		const std::string readbackIntervalFlag = "--readback-interval=";
+		const std::string jobThreadsFlag = "--job-threads=";
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			if (arg.rfind(presentFlag, 0) == 0) {
+				if (!parsePresentPolicy(arg.substr(presentFlag.size()), config.presentPolicy)) return false;
+			}
+			else if (arg.rfind(gpuProfileFlag, 0) == 0) {
+				if (!parseCount(arg.substr(gpuProfileFlag.size()), config.gpuProfileLogInterval)) return false;
+			}
+			else if (arg.rfind(cpuTraceFlag, 0) == 0) {
+				if (!parseCount(arg.substr(cpuTraceFlag.size()), config.cpuTraceFrames)) return false;
+			}
+			else if (arg.rfind(cpuTraceFileFlag, 0) == 0) {
+				config.cpuTracePath = arg.substr(cpuTraceFileFlag.size());
+			}
+			else if (arg.rfind(captureFlag, 0) == 0) {
+				config.capturePath = arg.substr(captureFlag.size());
+			}
+			else if (arg.rfind(replayFlag, 0) == 0) {
+				config.replayPath = arg.substr(replayFlag.size());
+			}
+			else if (arg.rfind(hotReloadFlag, 0) == 0) {
+				config.hotReloadDirectory = arg.substr(hotReloadFlag.size());
+			}
+			else if (arg.rfind(cullFlag, 0) == 0) {
+				if (!parseCullMode(arg.substr(cullFlag.size()), config.cullMode)) return false;
+			}
+			else if (arg == depthPrepassFlag) {
+				config.depthPrepass = true;
+			}
+			else if (arg == occlusionCullingFlag) {
+				config.occlusionCulling = true;
+			}
+			else if (arg == objectColorsFlag) {
+				config.objectColors = true;
+			}
+			else if (arg.rfind(msaaFlag, 0) == 0) {
+				if (!parseSampleCount(arg.substr(msaaFlag.size()), config.msaaSamples)) return false;
+			}
+			else if (arg.rfind(dynamicResolutionFlag, 0) == 0) {
+				if (!parseMilliseconds(arg.substr(dynamicResolutionFlag.size()), config.dynamicResolutionTarget)) return false;
+			}
+			else if (arg.rfind(readbackFlag, 0) == 0) {
+				if (!parseReadback(arg.substr(readbackFlag.size()), config.readback)) return false;
+			}
+			else if (arg.rfind(readbackIntervalFlag, 0) == 0) {
+				if (!parseCount(arg.substr(readbackIntervalFlag.size()), config.readback.interval)) return false;
+			}
+			else if (arg.rfind(jobThreadsFlag, 0) == 0) {
+				if (!parseCount(arg.substr(jobThreadsFlag.size()), config.jobThreads)) return false;
+			}
+			else {
+				return false;
+			}
+		}
+		return true;
+	}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	VulkanEngine::VulkEngAppConfig config{};
+	if (!parseArgs(argc, argv, config)) {
+		std::cerr << "usage: " << argv[0] << " [--present=lowlatency|powersaving|uncapped|vsync] [--gpu-profile=<frames>]"
+			<< " [--cpu-trace=<frames>] [--cpu-trace-file=<path>]"
+			<< " [--capture=<path>] [--replay=<path>] [--hot-reload=<shader source dir>]"
+			<< " [--cull=back|front|none] [--depth-prepass] [--occlusion-culling] [--object-colors]"
+			<< " [--msaa=1|2|4|8] [--dynamic-resolution=<GPU ms per frame>]"
+			<< " [--readback=raw:<dir>|png:<dir>|pipe:<command>] [--readback-interval=<frames>]"
+			<< " [--job-threads=<worker threads>]" << std::endl;
+		return EXIT_FAILURE;
+	}
 
 	try {
+		VulkanEngine::VulkEngApp app{ config };
 		app.run();
 	}
 	catch (const std::exception& e) {
@@ -16,4 +166,4 @@ int main() {
 		return EXIT_FAILURE;
 	}
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
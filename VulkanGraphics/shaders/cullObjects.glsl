@@ -0,0 +1,13 @@
+// Per object data of the occlusion culling path, written by VulkEngOcclusionCulling::prepareFrame.
+
+struct ObjectData {
+	mat4 transform;
+	// local space bounds of the model; w unused
+	vec4 boundsMin;
+	vec4 boundsMax;
+	uint vertexCount;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects {
+	ObjectData objects[];
+};
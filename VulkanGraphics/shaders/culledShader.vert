@@ -0,0 +1,15 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "cullObjects.glsl"
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+	// occlusionCull.comp emits one draw per object with firstInstance set to the object's index
+	gl_Position = objects[gl_InstanceIndex].transform * vec4(position, 1.0);
+	fragColor = color;
+}
@@ -0,0 +1,15 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+
+// same computation as simpleShader.vert, so the shading pass's EQUAL depth test passes
+invariant gl_Position;
+
+layout(push_constant) uniform Push {
+	mat4 transform;
+	vec3 color;
+} push;
+
+void main() {
+	gl_Position = push.transform * vec4(position, 1.0);
+}
@@ -8,6 +8,11 @@ layout(push_constant) uniform Push {
 	vec3 color;
 } push;
 
+// debug view: every object flat in its push constant color instead of its vertex colors,
+// selected with VulkEngRenderSystem::setShaderFeatures
+layout(constant_id = 0) const bool OBJECT_COLOR = false;
+
 void main() {
-	outColor = vec4(fragColor, 1.0);
+	vec3 color = OBJECT_COLOR ? push.color : fragColor;
+	outColor = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -5,6 +5,9 @@ layout(location = 1) in vec3 color;
 
 layout(location = 0) out vec3 fragColor;
 
+// the depth prepass (depthOnly.vert) must produce bit identical depth for the EQUAL test
+invariant gl_Position;
+
 layout(push_constant) uniform Push {
 	mat4 transform;
 	vec3 color;
@@ -1,5 +1,9 @@
 #include "vulkEngApp.hpp"
 #include "vulkEngRenderSystem.hpp"
+#include "vulkEngCpuProfiler.hpp"
+#include "vulkEngShaderHotReload.hpp"
+#include "vulkEngOcclusionCulling.hpp"
+#include "vulkEngDynamicResolution.hpp"
 
 //libs
 #define GLM_FORCE_RADIANS
@@ -10,37 +14,296 @@
 //std
 #include <stdexcept>
 #include <array>
+#include <chrono>
+#include <iostream>
 #include <vector>
 
 namespace VulkanEngine
 {
-	VulkEngApp::VulkEngApp()
+
+	VulkEngApp::VulkEngApp(const VulkEngAppConfig& appConfig) : config{ appConfig }
 	{
+		if (config.occlusionCulling && config.depthPrepass) {
+			throw std::runtime_error("occlusion culling does not support a depth prepass!");
+		}
+		if (config.occlusionCulling && config.msaaSamples > 1) {
+			throw std::runtime_error("occlusion culling does not support multisampling!");
+		}
+		if (config.occlusionCulling && config.dynamicResolutionTarget > 0.0) {
+			throw std::runtime_error("occlusion culling does not support dynamic resolution!");
+		}
+		if (config.occlusionCulling && config.objectColors) {
+			throw std::runtime_error("occlusion culling does not support object colors!");
+		}
+		uint32_t samples = static_cast<uint32_t>(vulkEngRenderer.getSampleCount());
+		if (samples < config.msaaSamples) {
+			std::cout << "MSAA limited to " << samples << " samples by the device" << std::endl;
+		}
+		vulkEngRenderer.getGpuProfiler().setLogInterval(config.gpuProfileLogInterval);
 		loadGameObjects();
+
+		lastExtent = vulkanWindow.getExtent();
+		if (replay && replay->getModelCount() != models.size()) {
+			throw std::runtime_error("frame capture was recorded with a different set of models!");
+		}
+		if (!config.capturePath.empty()) {
+			recorder = std::make_unique<VulkEngFrameRecorder>(
+				config.capturePath, lastExtent.width, lastExtent.height, static_cast<uint32_t>(models.size()));
+		}
 	}
 
 	VulkEngApp::~VulkEngApp() {}
 
 	void VulkEngApp::run()
 	{
-		VulkEngRenderSystem vulkEngRenderSystem{ vulkanDevice, vulkEngRenderer.getSwapChainRenderPass() };
+		VulkEngRenderGraph renderGraph{ vulkanDevice };
+		RenderGraphImage swapChainImage = vulkEngRenderer.importSwapChain(renderGraph);
+		std::unique_ptr<VulkEngDynamicResolution> dynamicResolution;
+		if (config.dynamicResolutionTarget > 0.0) {
+			if (!vulkEngRenderer.canTransferToSwapChain() || !vulkEngRenderer.getGpuProfiler().isEnabled()) {
+				throw std::runtime_error("dynamic resolution needs GPU timestamps and swap chain images that can be blitted to!");
+			}
+			DynamicResolutionConfig dynamicResolutionConfig{};
+			dynamicResolutionConfig.targetMilliseconds = config.dynamicResolutionTarget;
+			dynamicResolution = std::make_unique<VulkEngDynamicResolution>(dynamicResolutionConfig);
+		}
+
+		RenderGraphImageDesc depthDesc{};
+		depthDesc.format = vulkEngRenderer.getSwapChainDepthFormat();
+		depthDesc.samples = vulkEngRenderer.getSampleCount();
+		depthDesc.dynamicResolution = dynamicResolution != nullptr;
+		RenderGraphImage depthImage = renderGraph.createImage("depth", depthDesc);
+		// with dynamic resolution, the scene is rendered into this at the render scale and then
+		// blitted up to the swap chain image
+		RenderGraphImage sceneImage = swapChainImage;
+		if (dynamicResolution) {
+			RenderGraphImageDesc sceneDesc{};
+			sceneDesc.format = vulkEngRenderer.getSwapChainImageFormat();
+			sceneDesc.dynamicResolution = true;
+			sceneImage = renderGraph.createImage("scene color", sceneDesc);
+		}
+		// multisampled, the scene is drawn into this and resolved into the scene image
+		bool multisampled = depthDesc.samples != VK_SAMPLE_COUNT_1_BIT;
+		RenderGraphImage colorImage = sceneImage;
+		if (multisampled) {
+			RenderGraphImageDesc colorDesc{};
+			colorDesc.format = vulkEngRenderer.getSwapChainImageFormat();
+			colorDesc.samples = depthDesc.samples;
+			colorDesc.dynamicResolution = depthDesc.dynamicResolution;
+			colorImage = renderGraph.createImage("multisampled color", colorDesc);
+		}
+
+		std::unique_ptr<VulkEngFrameReadback> readback;
+		if (config.readback.output != ReadbackOutput::None) {
+			if (!vulkEngRenderer.canReadBackSwapChain()) {
+				throw std::runtime_error("frame readback needs swap chain images that can be copied from!");
+			}
+			readback = std::make_unique<VulkEngFrameReadback>(
+				vulkanDevice, config.readback, VulkEngSwapChain::MAX_FRAMES_IN_FLIGHT);
+		}
+
+		const VkClearColorValue clearColor{ {0.01f, 0.01f, 0.01f, 1.0f} };
+		std::unique_ptr<VulkEngOcclusionCulling> occlusionCulling;
+		// the pipelines need the pass's render target, so the render system is created after compiling
+		std::unique_ptr<VulkEngRenderSystem> vulkEngRenderSystem;
+		if (config.occlusionCulling) {
+			occlusionCulling = std::make_unique<VulkEngOcclusionCulling>(vulkanDevice);
+			occlusionCulling->addPasses(renderGraph, swapChainImage, depthImage, clearColor);
+			if (readback) {
+				readback->addReadbackPass(renderGraph, swapChainImage, vulkEngRenderer.getSwapChainImageFormat());
+			}
+			renderGraph.compile();
+			occlusionCulling->createPipelines(config.cullMode);
+		}
+		else {
+			RenderGraphPass depthPrepass{};
+			if (config.depthPrepass) {
+				depthPrepass = renderGraph.addPass("depth prepass")
+					.writeDepth(depthImage, VK_ATTACHMENT_LOAD_OP_CLEAR)
+					.setExecute([&](VkCommandBuffer commandBuffer) {
+						vulkEngRenderSystem->renderDepthPrepass(commandBuffer, gameObjects);
+					})
+					.pass();
+			}
+			auto forward = renderGraph.addPass("forward")
+				.writeColor(colorImage, VK_ATTACHMENT_LOAD_OP_CLEAR, clearColor)
+				.setExecute([&](VkCommandBuffer commandBuffer) {
+					vulkEngRenderSystem->renderGameObjects(commandBuffer, gameObjects);
+				});
+			if (multisampled) {
+				forward.resolveColor(sceneImage);
+			}
+			if (config.depthPrepass) {
+				forward.readDepth(depthImage);
+			}
+			else {
+				forward.writeDepth(depthImage, VK_ATTACHMENT_LOAD_OP_CLEAR);
+			}
+			RenderGraphPass forwardPass = forward.pass();
+			if (dynamicResolution) {
+				dynamicResolution->addUpscalePass(renderGraph, sceneImage, swapChainImage);
+			}
+			if (readback) {
+				readback->addReadbackPass(renderGraph, swapChainImage, vulkEngRenderer.getSwapChainImageFormat());
+			}
+			renderGraph.compile();
+
+			RenderSystemConfig renderSystemConfig{};
+			renderSystemConfig.cullMode = config.cullMode;
+			if (config.depthPrepass) {
+				renderSystemConfig.depthPrepass = true;
+				renderSystemConfig.depthPrepassTarget = renderGraph.getRenderTarget(depthPrepass);
+			}
+			vulkEngRenderSystem = std::make_unique<VulkEngRenderSystem>(
+				vulkanDevice,
+				renderGraph.getRenderTarget(forwardPass),
+				vulkEngRenderer.getGpuProfiler(),
+				renderSystemConfig);
+			if (config.objectColors) {
+				SpecializationConstants features;
+				features.set(SHADER_FEATURE_OBJECT_COLOR, true);
+				vulkEngRenderSystem->setShaderFeatures(features);
+			}
+		}
+
+		// declared after the render system so its worker stops before the pipelines it rebuilds go away
+		std::unique_ptr<VulkEngShaderHotReload> hotReload;
+		if (!config.hotReloadDirectory.empty()) {
+			hotReload = std::make_unique<VulkEngShaderHotReload>(vulkanDevice, config.hotReloadDirectory);
+			if (occlusionCulling) {
+				hotReload->watch(occlusionCulling->getPipelineVariants());
+			}
+			else {
+				hotReload->watch(vulkEngRenderSystem->getPipelineVariants());
+				if (auto* depthPrepassVariants = vulkEngRenderSystem->getDepthPrepassVariants()) {
+					hotReload->watch(*depthPrepassVariants);
+				}
+			}
+		}
+
+		VulkEngCpuProfiler::setThreadName("main");
+		VulkEngCpuProfiler::beginCapture(config.cpuTraceFrames, config.cpuTracePath);
+
+		uint32_t replayedFrames = 0;
+		auto replayStart = std::chrono::steady_clock::now();
 
-		vkDeviceWaitIdle(vulkanDevice.device());
 		while (!vulkanWindow.shouldClose())
 		{
-			vulkanWindow.pollEvents();
-			
-			if (auto commandBuffer = vulkEngRenderer.beginFrame()) {
-				vulkEngRenderer.beginSwapChainRenderPass(commandBuffer);
-				vulkEngRenderSystem.renderGameObjects(commandBuffer, gameObjects);
-				vulkEngRenderer.endSwapChainRenderPass(commandBuffer);
-				vulkEngRenderer.endFrame();
+			{
+				VulkEngCpuScope frameScope{ "frame" };
+				{
+					VulkEngCpuScope scope{ "pollEvents" };
+					vulkanWindow.pollEvents();
+				}
+				jobSystem.runMainThreadJobs();
+				if (vulkanWindow.isMinimized()) {
+					vulkanWindow.waitEvents();
+					continue;
+				}
+
+				if (replay) {
+					if (!replayFrame()) {
+						break;
+					}
+					replayedFrames++;
+				}
+				else {
+					updateGameObjects();
+					recordFrame();
+				}
+
+				if (hotReload) {
+					hotReload->applyPendingReloads();
+				}
+
+				if (auto commandBuffer = vulkEngRenderer.beginFrame()) {
+					if (dynamicResolution) {
+						dynamicResolution->update(renderGraph, vulkEngRenderer.getGpuProfiler());
+					}
+					if (readback) {
+						readback->beginFrame(static_cast<uint32_t>(vulkEngRenderer.getFrameIndex()));
+					}
+					if (occlusionCulling) {
+						occlusionCulling->prepareFrame(
+							jobSystem,
+							static_cast<uint32_t>(vulkEngRenderer.getFrameIndex()),
+							vulkEngRenderer.getSwapChainExtent(),
+							gameObjects);
+					}
+					else {
+						vulkEngRenderSystem->prepareFrame(jobSystem, gameObjects);
+					}
+					vulkEngRenderer.executeRenderGraph(commandBuffer, renderGraph, swapChainImage);
+					vulkEngRenderer.endFrame();
+				}
+			}
+			// after the frame scope has closed, so the last captured frame is complete
+			VulkEngCpuProfiler::endFrame();
+		}
+
+		vkDeviceWaitIdle(vulkanDevice.device());
+		if (readback) {
+			readback->flush();
+			std::cout << "read back " << readback->getWrittenFrameCount() << " frames";
+			if (!config.readback.target.empty()) {
+				std::cout << " to " << config.readback.target;
+			}
+			std::cout << std::endl;
+		}
+
+		if (replay) {
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - replayStart).count();
+			std::cout << "replayed " << replayedFrames << " frames in " << seconds << " s ("
+				<< (seconds > 0.0 ? replayedFrames / seconds : 0.0) << " fps)" << std::endl;
+		}
+		if (recorder) {
+			std::cout << "captured " << recorder->getFrameCount() << " frames to " << config.capturePath << std::endl;
+		}
+	}
+
+	void VulkEngApp::updateGameObjects() {
+		VulkEngCpuScope scope{ "updateGameObjects" };
+		jobSystem.parallelFor("updateGameObjects", static_cast<uint32_t>(gameObjects.size()), VulkEngJobSystem::DEFAULT_GRAIN_SIZE,
+			[this](uint32_t begin, uint32_t end) {
+				for (uint32_t index = begin; index < end; index++) {
+					auto& obj = gameObjects[index];
+					int i = static_cast<int>(index) + 1;
+					obj.transform.rotationRadians.y =
+						glm::mod<float>(obj.transform.rotationRadians.y + 0.001f * i, 2.f * glm::pi<float>());
+					obj.transform.rotationRadians.x =
+						glm::mod<float>(obj.transform.rotationRadians.x + 0.001f * i, 2.f * glm::pi<float>());
+				}
+			});
+	}
+
+	bool VulkEngApp::replayFrame() {
+		if (!replay->readFrame(frameEvents, gameObjects, models)) {
+			return false;
+		}
+		for (const auto& event : frameEvents) {
+			if (event.type == FrameEvent::Type::Resize) {
+				vulkanWindow.resizeHeadless(event.a, event.b);
 			}
 		}
+		return true;
 	}
 
-	// temporary helper function, creates a 1x1x1 cube centered at offset
-	std::unique_ptr<VulkEngModel> createCubeModel(VulkEngDevice& device, glm::vec3 offset) {
+	void VulkEngApp::recordFrame() {
+		if (!recorder) {
+			return;
+		}
+
+		frameEvents.clear();
+		VkExtent2D extent = vulkanWindow.getExtent();
+		if (extent.width != lastExtent.width || extent.height != lastExtent.height) {
+			frameEvents.push_back({ FrameEvent::Type::Resize, static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height) });
+			lastExtent = extent;
+		}
+		recorder->recordFrame(frameEvents, gameObjects, models);
+	}
+
+	// temporary helper function, creates a 1x1x1 cube centered at offset, its faces wound clockwise seen from outside
+	std::unique_ptr<VulkEngModel> createCubeModel(VulkEngDevice& device, VulkEngUploadBatch& batch, glm::vec3 offset, bool positionStream) {
 		std::vector<VulkEngModel::Vertex> vertices{
 
 			// left face (white)
@@ -53,19 +316,19 @@ namespace VulkanEngine
 
 			// right face (yellow)
 			{{.5f, -.5f, -.5f}, {.8f, .8f, .1f}},
-			{{.5f, .5f, .5f}, {.8f, .8f, .1f}},
 			{{.5f, -.5f, .5f}, {.8f, .8f, .1f}},
+			{{.5f, .5f, .5f}, {.8f, .8f, .1f}},
 			{{.5f, -.5f, -.5f}, {.8f, .8f, .1f}},
-			{{.5f, .5f, -.5f}, {.8f, .8f, .1f}},
 			{{.5f, .5f, .5f}, {.8f, .8f, .1f}},
+			{{.5f, .5f, -.5f}, {.8f, .8f, .1f}},
 
 			// top face (orange, remember y axis points down)
 			{{-.5f, -.5f, -.5f}, {.9f, .6f, .1f}},
-			{{.5f, -.5f, .5f}, {.9f, .6f, .1f}},
 			{{-.5f, -.5f, .5f}, {.9f, .6f, .1f}},
+			{{.5f, -.5f, .5f}, {.9f, .6f, .1f}},
 			{{-.5f, -.5f, -.5f}, {.9f, .6f, .1f}},
-			{{.5f, -.5f, -.5f}, {.9f, .6f, .1f}},
 			{{.5f, -.5f, .5f}, {.9f, .6f, .1f}},
+			{{.5f, -.5f, -.5f}, {.9f, .6f, .1f}},
 
 			// bottom face (red)
 			{{-.5f, .5f, -.5f}, {.8f, .1f, .1f}},
@@ -77,11 +340,11 @@ namespace VulkanEngine
 
 			// nose face (blue)
 			{{-.5f, -.5f, 0.5f}, {.1f, .1f, .8f}},
-			{{.5f, .5f, 0.5f}, {.1f, .1f, .8f}},
 			{{-.5f, .5f, 0.5f}, {.1f, .1f, .8f}},
+			{{.5f, .5f, 0.5f}, {.1f, .1f, .8f}},
 			{{-.5f, -.5f, 0.5f}, {.1f, .1f, .8f}},
-			{{.5f, -.5f, 0.5f}, {.1f, .1f, .8f}},
 			{{.5f, .5f, 0.5f}, {.1f, .1f, .8f}},
+			{{.5f, -.5f, 0.5f}, {.1f, .1f, .8f}},
 
 			// tail face (green)
 			{{-.5f, -.5f, -0.5f}, {.1f, .8f, .1f}},
@@ -95,14 +358,19 @@ namespace VulkanEngine
 		for (auto& v : vertices) {
 			v.position += offset;
 		}
-		return std::make_unique<VulkEngModel>(device, vertices);
+		return std::make_unique<VulkEngModel>(device, batch, vertices, positionStream);
 	}
 
 	void VulkEngApp::loadGameObjects() {
-		std::shared_ptr<VulkEngModel> cubeModel = createCubeModel(vulkanDevice, { 0.f, 0.f, 0.f });
+		// all uploads share one submission; frames submitted later on the graphics queue are ordered after it
+		VulkEngUploadBatch uploads{ vulkanDevice };
+		std::shared_ptr<VulkEngModel> cubeModel = createCubeModel(vulkanDevice, uploads, { 0.f, 0.f, 0.f }, config.depthPrepass);
+		uploads.submit();
+		models.push_back(cubeModel);
 
 		auto cube1 = VulkEngGameObj::createGameObject();
 		cube1.model = cubeModel;
+		cube1.color = { .1f, .8f, .8f };
 		cube1.transform.translation = { 0.0f, 0.0f, 0.5f };
 		cube1.transform.scale = { 0.5f, 0.5f, 0.5f };
 
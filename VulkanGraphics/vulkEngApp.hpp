@@ -4,12 +4,50 @@
 #include "vulkEngDevice.hpp"
 #include "vulkEngRenderer.hpp"
 #include "vulkEngGameObj.hpp"
+#include "vulkEngFrameCapture.hpp"
+#include "vulkEngFrameReadback.hpp"
+#include "vulkEngJobSystem.hpp"
 
 //std
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace VulkanEngine {
+
+	struct VulkEngAppConfig {
+		PresentPolicy presentPolicy = PresentPolicy::LowLatency;
+		// frames between GPU profile log lines, 0 disables them
+		uint32_t gpuProfileLogInterval = 0;
+		// frames recorded into a Chrome trace at startup, 0 disables the capture
+		uint32_t cpuTraceFrames = 0;
+		std::string cpuTracePath = "cpu_trace.json";
+		// records every rendered frame to this file when set
+		std::string capturePath;
+		// plays a capture back headlessly, as fast as possible, instead of running interactively
+		std::string replayPath;
+		// recompiles and reloads shaders from this GLSL source directory while running when set
+		std::string hotReloadDirectory;
+		VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+		// renders depth in a pass of its own first, so the shading pass only shades visible pixels
+		bool depthPrepass = false;
+		// draws only what a depth pyramid test on the GPU finds visible, see VulkEngOcclusionCulling;
+		// not combined with depthPrepass
+		bool occlusionCulling = false;
+		// debug view shading every object flat in its VulkEngGameObj::color; not combined with
+		// occlusionCulling
+		bool objectColors = false;
+		// samples per pixel, capped to what the device supports; above 1 the frame is rendered
+		// multisampled and resolved into the swap chain image
+		uint32_t msaaSamples = 1;
+		// GPU milliseconds per frame to hold by lowering the render resolution, see
+		// VulkEngDynamicResolution; 0 always renders at the full resolution
+		double dynamicResolutionTarget = 0.0;
+		// reads the presented frames back and streams them out unless readback.output is None
+		FrameReadbackConfig readback;
+		// job system worker threads besides the main thread, 0 for one per remaining hardware thread
+		uint32_t jobThreads = 0;
+	};
 	
 	class VulkEngApp {
 
@@ -17,7 +55,7 @@ namespace VulkanEngine {
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
 
-		VulkEngApp();
+		VulkEngApp(const VulkEngAppConfig& appConfig = {});
 		~VulkEngApp();
 
 		VulkEngApp(const VulkEngApp&) = delete;
@@ -27,13 +65,32 @@ namespace VulkanEngine {
 
 	private:
 		void loadGameObjects();
+		void updateGameObjects();
+		bool replayFrame();
+		void recordFrame();
 
-		VulkEngWindow vulkanWindow{ WIDTH, HEIGHT, "Vulkan Engine Window" };
+		VulkEngAppConfig config;
+		// created on the main thread, which makes it the one MainThread jobs run on
+		VulkEngJobSystem jobSystem{ config.jobThreads };
+		std::unique_ptr<VulkEngFrameReplay> replay{
+			config.replayPath.empty() ? nullptr : std::make_unique<VulkEngFrameReplay>(config.replayPath) };
+		VulkEngWindow vulkanWindow{
+			replay ? static_cast<int>(replay->getWidth()) : WIDTH,
+			replay ? static_cast<int>(replay->getHeight()) : HEIGHT,
+			"Vulkan Engine Window",
+			replay != nullptr };
 		VulkEngDevice vulkanDevice{ vulkanWindow };
-		VulkEngRenderer vulkEngRenderer{ vulkanWindow, vulkanDevice };
+		// everything is drawn through the render graph, into its own attachments
+		VulkEngRenderer vulkEngRenderer{ vulkanWindow, vulkanDevice, config.presentPolicy, config.msaaSamples, false };
 
+		// captures refer to models by their index in this list
+		std::vector<std::shared_ptr<VulkEngModel>> models;
 		std::vector<VulkEngGameObj> gameObjects;
 
+		std::unique_ptr<VulkEngFrameRecorder> recorder;
+		std::vector<FrameEvent> frameEvents;
+		VkExtent2D lastExtent{};
+
 	};
 
 } // namespace VulkanEngine
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "vulkEngComputePipeline.hpp"
+
+//std
+#include <cassert>
+#include <stdexcept>
+
+namespace VulkanEngine {
+
+	VulkEngComputePipeline::VulkEngComputePipeline(
+		VulkEngDevice& device,
+		const std::string& compFilepath,
+		uint32_t pushConstantSize,
+		const SpecializationConstants& specializationConstants
+	) : vulkanDevice{ device }
+	{
+		shaderModule = vulkanDevice.shaderCache().loadModule(compFilepath);
+		const ShaderReflection& reflection = shaderModule->getReflection();
+		if (reflection.stage != VK_SHADER_STAGE_COMPUTE_BIT) {
+			throw std::runtime_error("compute shader module is not a compute shader: " + compFilepath + "!");
+		}
+		layout = vulkanDevice.layoutCache().getReflectedLayout({ &reflection }, pushConstantSize);
+
+		VkSpecializationInfo specializationInfo{};
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationConstants.getEntries().size());
+		specializationInfo.pMapEntries = specializationConstants.getEntries().data();
+		specializationInfo.dataSize = specializationConstants.getData().size() * sizeof(uint32_t);
+		specializationInfo.pData = specializationConstants.getData().data();
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = shaderModule->getHandle();
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.stage.pSpecializationInfo = specializationConstants.empty() ? nullptr : &specializationInfo;
+		pipelineInfo.layout = layout.pipelineLayout;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineInfo.basePipelineIndex = -1;
+
+		if (vkCreateComputePipelines(vulkanDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline!");
+		}
+	}
+
+	VulkEngComputePipeline::~VulkEngComputePipeline() {
+		if (computePipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(vulkanDevice.device(), computePipeline, nullptr);
+		}
+	}
+
+	void VulkEngComputePipeline::bind(VkCommandBuffer commandBuffer) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	}
+
+	void VulkEngComputePipeline::bindDescriptorSet(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, uint32_t set) {
+		vkCmdBindDescriptorSets(
+			commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout.pipelineLayout, set, 1, &descriptorSet, 0, nullptr);
+	}
+
+	void VulkEngComputePipeline::pushConstants(VkCommandBuffer commandBuffer, const void* data) {
+		assert(layout.pushConstantSize > 0 && "Compute pipeline has no push constants");
+		vkCmdPushConstants(
+			commandBuffer, layout.pipelineLayout, layout.pushConstantStages, 0, layout.pushConstantSize, data);
+	}
+
+} // namespace VulkanEngine
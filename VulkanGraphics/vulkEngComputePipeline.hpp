@@ -0,0 +1,43 @@
+#pragma once
+
+#include "vulkEngDevice.hpp"
+#include "vulkEngPipeline.hpp"
+#include "vulkEngLayoutCache.hpp"
+
+//std
+#include <memory>
+#include <string>
+
+namespace VulkanEngine {
+
+	// A compute pipeline with the layout reflected from its shader. pushConstantSize is sizeof the
+	// C++ push constant struct, 0 when the shader declares none.
+	class VulkEngComputePipeline {
+	public:
+		VulkEngComputePipeline(
+			VulkEngDevice& device,
+			const std::string& compFilepath,
+			uint32_t pushConstantSize,
+			const SpecializationConstants& specializationConstants = {});
+		~VulkEngComputePipeline();
+
+		VulkEngComputePipeline(const VulkEngComputePipeline&) = delete;
+		VulkEngComputePipeline& operator=(const VulkEngComputePipeline&) = delete;
+
+		void bind(VkCommandBuffer commandBuffer);
+		void bindDescriptorSet(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, uint32_t set = 0);
+		void pushConstants(VkCommandBuffer commandBuffer, const void* data);
+
+		// owned by the device's layout cache
+		VkPipelineLayout getPipelineLayout() const { return layout.pipelineLayout; }
+		VkDescriptorSetLayout getDescriptorSetLayout(uint32_t set) const { return layout.setLayouts[set]; }
+		const VulkEngShaderModule& getShader() const { return *shaderModule; }
+
+	private:
+		VulkEngDevice& vulkanDevice;
+		std::shared_ptr<VulkEngShaderModule> shaderModule;
+		ReflectedLayout layout;
+		VkPipeline computePipeline = VK_NULL_HANDLE;
+	};
+
+} // namespace VulkanEngine
@@ -0,0 +1,177 @@
+#include "vulkEngCpuProfiler.hpp"
+
+//std
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace VulkanEngine
+{
+	namespace {
+		constexpr uint32_t EVENTS_PER_THREAD = 1 << 16;
+
+		struct TraceEvent {
+			const char* name;
+			int64_t start;
+			int64_t end;
+		};
+
+		// Written only by its owning thread. count is published with release semantics, so the
+		// writer of the trace can read every event below it while the owner keeps appending.
+		struct ThreadBuffer {
+			std::unique_ptr<TraceEvent[]> events{ new TraceEvent[EVENTS_PER_THREAD] };
+			std::atomic<uint32_t> count{ 0 };
+			std::atomic<uint32_t> generation{ 0 };
+			std::atomic<uint32_t> dropped{ 0 };
+			std::string name;
+			uint32_t threadId;
+		};
+
+		std::atomic<bool> capturing{ false };
+		// bumped by every capture; a thread lazily clears its buffer the first time it records
+		// into a new generation, so no other thread ever writes to it
+		std::atomic<uint32_t> captureGeneration{ 0 };
+		uint32_t framesRemaining = 0;
+		uint32_t framesCaptured = 0;
+		std::string capturePath;
+
+		std::mutex registryMutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> registry;
+		thread_local ThreadBuffer* threadBuffer = nullptr;
+
+		const auto epoch = std::chrono::steady_clock::now();
+
+		ThreadBuffer& currentThreadBuffer() {
+			if (threadBuffer == nullptr) {
+				std::lock_guard<std::mutex> lock{ registryMutex };
+				registry.push_back(std::make_unique<ThreadBuffer>());
+				threadBuffer = registry.back().get();
+				threadBuffer->threadId = static_cast<uint32_t>(registry.size());
+			}
+			return *threadBuffer;
+		}
+
+		void writeEscaped(std::ostream& out, const char* text) {
+			for (const char* c = text; *c != '\0'; c++) {
+				if (*c == '"' || *c == '\\') out << '\\';
+				out << *c;
+			}
+		}
+
+		void writeTrace() {
+			std::ofstream out{ capturePath, std::ios::trunc };
+			if (!out) {
+				std::cerr << "failed to open cpu trace file " << capturePath << std::endl;
+				return;
+			}
+
+			uint32_t generation = captureGeneration.load(std::memory_order_relaxed);
+			uint32_t dropped = 0;
+			bool first = true;
+			// microseconds with nanosecond digits; the default precision turns into scientific notation
+			// after a second and rounds timestamps out of order
+			out << std::fixed << std::setprecision(3);
+			out << "{\"traceEvents\":[\n";
+
+			std::lock_guard<std::mutex> lock{ registryMutex };
+			for (const auto& buffer : registry) {
+				if (!buffer->name.empty()) {
+					out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+						<< buffer->threadId << ",\"args\":{\"name\":\"";
+					writeEscaped(out, buffer->name.c_str());
+					out << "\"}}";
+					first = false;
+				}
+				if (buffer->generation.load(std::memory_order_acquire) != generation) {
+					continue;
+				}
+
+				uint32_t count = buffer->count.load(std::memory_order_acquire);
+				dropped += buffer->dropped.load(std::memory_order_relaxed);
+				for (uint32_t i = 0; i < count; i++) {
+					const TraceEvent& event = buffer->events[i];
+					out << (first ? "" : ",\n") << "{\"name\":\"";
+					writeEscaped(out, event.name);
+					out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+						<< ",\"ts\":" << event.start / 1000.0
+						<< ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+					first = false;
+				}
+			}
+			out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+			std::cout << "wrote cpu trace of " << framesCaptured << " frames to " << capturePath;
+			if (dropped > 0) {
+				std::cout << " (" << dropped << " events dropped)";
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	void VulkEngCpuProfiler::beginCapture(uint32_t frameCount, const std::string& path) {
+		if (frameCount == 0) {
+			return;
+		}
+		capturePath = path;
+		framesRemaining = frameCount;
+		framesCaptured = 0;
+		captureGeneration.fetch_add(1, std::memory_order_relaxed);
+		capturing.store(true, std::memory_order_release);
+	}
+
+	bool VulkEngCpuProfiler::isCapturing() { return capturing.load(std::memory_order_relaxed); }
+
+	void VulkEngCpuProfiler::endFrame() {
+		if (!isCapturing()) {
+			return;
+		}
+		framesCaptured++;
+		if (--framesRemaining == 0) {
+			capturing.store(false, std::memory_order_relaxed);
+			writeTrace();
+		}
+	}
+
+	void VulkEngCpuProfiler::setThreadName(const char* name) {
+		ThreadBuffer& buffer = currentThreadBuffer();
+		std::lock_guard<std::mutex> lock{ registryMutex };
+		buffer.name = name;
+	}
+
+	void VulkEngCpuProfiler::record(const char* name, int64_t startNanoseconds, int64_t endNanoseconds) {
+		ThreadBuffer& buffer = currentThreadBuffer();
+		uint32_t generation = captureGeneration.load(std::memory_order_relaxed);
+		if (buffer.generation.load(std::memory_order_relaxed) != generation) {
+			buffer.count.store(0, std::memory_order_relaxed);
+			buffer.dropped.store(0, std::memory_order_relaxed);
+			buffer.generation.store(generation, std::memory_order_release);
+		}
+
+		uint32_t index = buffer.count.load(std::memory_order_relaxed);
+		if (index >= EVENTS_PER_THREAD) {
+			buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		buffer.events[index] = { name, startNanoseconds, endNanoseconds };
+		buffer.count.store(index + 1, std::memory_order_release);
+	}
+
+	int64_t VulkEngCpuProfiler::now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	VulkEngCpuScope::VulkEngCpuScope(const char* name)
+		: name{ VulkEngCpuProfiler::isCapturing() ? name : nullptr }, start{ this->name != nullptr ? VulkEngCpuProfiler::now() : 0 } {}
+
+	VulkEngCpuScope::~VulkEngCpuScope() {
+		if (name != nullptr && VulkEngCpuProfiler::isCapturing()) {
+			VulkEngCpuProfiler::record(name, start, VulkEngCpuProfiler::now());
+		}
+	}
+
+} // namespace VulkanEngine
@@ -0,0 +1,45 @@
+#pragma once
+
+//std
+#include <cstdint>
+#include <string>
+
+namespace VulkanEngine {
+
+	// Scoped CPU instrumentation exported as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+	// Every thread appends to its own buffer without locking; nothing is recorded, beyond one
+	// relaxed atomic load per scope, unless a capture is running.
+	class VulkEngCpuProfiler {
+
+	public:
+		// Records the next frameCount frames, then writes them to path.
+		static void beginCapture(uint32_t frameCount, const std::string& path);
+		static bool isCapturing();
+
+		// Call once per frame from the main thread; writes the trace when the capture is complete.
+		static void endFrame();
+
+		// Names the calling thread in the trace.
+		static void setThreadName(const char* name);
+
+		// name must outlive the capture; string literals are expected.
+		static void record(const char* name, int64_t startNanoseconds, int64_t endNanoseconds);
+		static int64_t now();
+	};
+
+	// Records the time between construction and destruction as a trace event.
+	class VulkEngCpuScope {
+
+	public:
+		VulkEngCpuScope(const char* name);
+		~VulkEngCpuScope();
+
+		VulkEngCpuScope(const VulkEngCpuScope&) = delete;
+		VulkEngCpuScope& operator=(const VulkEngCpuScope&) = delete;
+
+	private:
+		const char* name;
+		int64_t start;
+	};
+
+} // namespace VulkanEngine
@@ -1,6 +1,12 @@
 #include "vulkEngDevice.hpp"
+#include "vulkEngUploadBatch.hpp"
+#include "vulkEngCpuProfiler.hpp"
+#include "vulkEngShaderCache.hpp"
+#include "vulkEngLayoutCache.hpp"
+#include "vulkEngSamplerCache.hpp"
 
 // std headers
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <set>
@@ -47,17 +53,39 @@ void DestroyDebugUtilsMessengerEXT(
 }
 
 // class member functions
-VulkEngDevice::VulkEngDevice(VulkEngWindow &window) : window{window} {
+VulkEngDevice::VulkEngDevice(VulkEngWindow &window)
+    : window{window}, headless{window.isHeadless()} {
+  if (headless) {
+    deviceExtensions.clear();
+  }
   createInstance();
   setupDebugMessenger();
   createSurface();
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  shaderCache_ = std::make_unique<VulkEngShaderCache>(device_);
+  layoutCache_ = std::make_unique<VulkEngLayoutCache>(device_);
+  samplerCache_ = std::make_unique<VulkEngSamplerCache>(device_, properties.limits.maxSamplerAnisotropy);
 }
 
 VulkEngDevice::~VulkEngDevice() {
+  vkDeviceWaitIdle(device_);
+  retireCompletedUploads(true);
+  releaseCompletedFrames(UINT64_MAX);
+  for (VkFence fence : freeFences) {
+    vkDestroyFence(device_, fence, nullptr);
+  }
+  for (VkSemaphore semaphore : freeSemaphores) {
+    vkDestroySemaphore(device_, semaphore, nullptr);
+  }
+
+  samplerCache_.reset();
+  layoutCache_.reset();
+  shaderCache_.reset();
   vkDestroyCommandPool(device_, commandPool, nullptr);
+  vkDestroyCommandPool(device_, transferCommandPool, nullptr);
+  vkDestroyCommandPool(device_, computeCommandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
   if (enableValidationLayers) {
@@ -79,7 +107,15 @@ void VulkEngDevice::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  // 1.3 where the loader has it, for dynamic rendering; a 1.0 loader has no vkEnumerateInstanceVersion
+  auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+      vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+  if (enumerateInstanceVersion != nullptr) {
+    uint32_t loaderVersion = VK_API_VERSION_1_0;
+    enumerateInstanceVersion(&loaderVersion);
+    instanceApiVersion = std::min(loaderVersion, static_cast<uint32_t>(VK_API_VERSION_1_3));
+  }
+  appInfo.apiVersion = instanceApiVersion;
 
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -135,9 +171,14 @@ void VulkEngDevice::pickPhysicalDevice() {
 
 void VulkEngDevice::createLogicalDevice() {
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+  queueFamilies = indices;
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  std::set<uint32_t> uniqueQueueFamilies = {
+      indices.graphicsFamily,
+      indices.presentFamily,
+      indices.transferFamily,
+      indices.computeFamily};
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -149,18 +190,62 @@ void VulkEngDevice::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+  deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+  // block compressed textures are loaded as they are, in whichever family the device supports
+  deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+  deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+  enabledFeatures = deviceFeatures;
+
+  VkPhysicalDeviceVulkan13Features supportedVulkan13Features = {};
+  supportedVulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+  if (instanceApiVersion >= VK_API_VERSION_1_3 && properties.apiVersion >= VK_API_VERSION_1_3) {
+    VkPhysicalDeviceFeatures2 supportedFeatures2 = {};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &supportedVulkan13Features;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+  }
+  dynamicRenderingEnabled = supportedVulkan13Features.dynamicRendering == VK_TRUE;
+
+  VkPhysicalDeviceVulkan13Features vulkan13Features = {};
+  vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+  vulkan13Features.dynamicRendering = VK_TRUE;
+
+  // optional, queried through vkGetPhysicalDeviceMemoryProperties2, which needs Vulkan 1.1
+  std::vector<const char *> extensions = deviceExtensions;
+  if (instanceApiVersion >= VK_API_VERSION_1_1 && properties.apiVersion >= VK_API_VERSION_1_1) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(
+        physicalDevice,
+        nullptr,
+        &extensionCount,
+        availableExtensions.data());
+    for (const auto &extension : availableExtensions) {
+      if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        memoryBudgetEnabled = true;
+      }
+    }
+  }
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = dynamicRenderingEnabled ? &vulkan13Features : nullptr;
 
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -177,31 +262,43 @@ void VulkEngDevice::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+  vkGetDeviceQueue(device_, indices.computeFamily, 0, &computeQueue_);
 }
 
 void VulkEngDevice::createCommandPool() {
-  QueueFamilyIndices queueFamilyIndices = findPhysicalQueueFamilies();
+  commandPool = createCommandPool(queueFamilies.graphicsFamily);
+  transferCommandPool = createCommandPool(queueFamilies.transferFamily);
+  computeCommandPool = createCommandPool(queueFamilies.computeFamily);
+}
 
+VkCommandPool VulkEngDevice::createCommandPool(uint32_t queueFamily) {
   VkCommandPoolCreateInfo poolInfo = {};
   poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-  poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+  poolInfo.queueFamilyIndex = queueFamily;
   poolInfo.flags =
       VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-  if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+  VkCommandPool pool;
+  if (vkCreateCommandPool(device_, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
     throw std::runtime_error("failed to create command pool!");
   }
+  return pool;
 }
 
-void VulkEngDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+void VulkEngDevice::createSurface() {
+  if (!headless) {
+    window.createWindowSurface(instance, &surface_);
+  }
+}
 
 bool VulkEngDevice::isDeviceSuitable(VkPhysicalDevice device) {
   QueueFamilyIndices indices = findQueueFamilies(device);
 
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
+  bool swapChainAdequate = headless;
+  if (extensionsSupported && !headless) {
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
     swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
   }
@@ -261,11 +358,13 @@ bool VulkEngDevice::checkValidationLayerSupport() {
 }
 
 std::vector<const char *> VulkEngDevice::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-  std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  std::vector<const char *> extensions;
+  if (!headless) {
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -326,25 +425,51 @@ QueueFamilyIndices VulkEngDevice::findQueueFamilies(VkPhysicalDevice device) {
   std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
   vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-  int i = 0;
+  bool transferFamilyHasValue = false;
+  bool computeFamilyHasValue = false;
+  uint32_t i = 0;
   for (const auto &queueFamily : queueFamilies) {
-    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+    if (queueFamily.queueCount == 0) {
+      i++;
+      continue;
+    }
+    bool graphics = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+    bool compute = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+    bool transfer = queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT;
+
+    if (graphics && !indices.graphicsFamilyHasValue) {
       indices.graphicsFamily = i;
+      indices.graphicsTimestampValidBits = queueFamily.timestampValidBits;
       indices.graphicsFamilyHasValue = true;
     }
     VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-    if (queueFamily.queueCount > 0 && presentSupport) {
+    if (headless) {
+      presentSupport = graphics;
+    } else {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+    }
+    if (presentSupport && !indices.presentFamilyHasValue) {
       indices.presentFamily = i;
       indices.presentFamilyHasValue = true;
     }
-    if (indices.isComplete()) {
-      break;
+    // a transfer-only family is usually a DMA engine that runs alongside the graphics queue
+    if (transfer && !graphics && !compute && !transferFamilyHasValue) {
+      indices.transferFamily = i;
+      transferFamilyHasValue = true;
+    }
+    if (compute && !graphics && !computeFamilyHasValue) {
+      indices.computeFamily = i;
+      computeFamilyHasValue = true;
     }
 
     i++;
   }
 
+  if (indices.graphicsFamilyHasValue) {
+    if (!transferFamilyHasValue) indices.transferFamily = indices.graphicsFamily;
+    if (!computeFamilyHasValue) indices.computeFamily = indices.graphicsFamily;
+  }
+
   return indices;
 }
 
@@ -390,17 +515,77 @@ VkFormat VulkEngDevice::findSupportedFormat(
   throw std::runtime_error("failed to find supported format!");
 }
 
+MemoryBudget VulkEngDevice::getDeviceLocalBudget() {
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+  budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+  VkPhysicalDeviceMemoryProperties2 memProperties = {};
+  memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+  if (memoryBudgetEnabled) {
+    memProperties.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memProperties);
+  } else {
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties.memoryProperties);
+  }
+
+  MemoryBudget budget{};
+  const VkPhysicalDeviceMemoryProperties &heaps = memProperties.memoryProperties;
+  for (uint32_t i = 0; i < heaps.memoryHeapCount; i++) {
+    if ((heaps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0) {
+      continue;
+    }
+    if (memoryBudgetEnabled) {
+      budget.budget += budgetProperties.heapBudget[i];
+      budget.usage += budgetProperties.heapUsage[i];
+    } else {
+      budget.budget += heaps.memoryHeaps[i].size;
+    }
+  }
+  return budget;
+}
+
+VkFormatFeatureFlags VulkEngDevice::getOptimalTilingFeatures(VkFormat format) {
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+  return props.optimalTilingFeatures;
+}
+
+VkSampleCountFlagBits VulkEngDevice::getUsableSampleCount(uint32_t requested) const {
+  VkSampleCountFlags counts = properties.limits.framebufferColorSampleCounts &
+                              properties.limits.framebufferDepthSampleCounts;
+  for (VkSampleCountFlagBits count :
+       {VK_SAMPLE_COUNT_64_BIT,
+        VK_SAMPLE_COUNT_32_BIT,
+        VK_SAMPLE_COUNT_16_BIT,
+        VK_SAMPLE_COUNT_8_BIT,
+        VK_SAMPLE_COUNT_4_BIT,
+        VK_SAMPLE_COUNT_2_BIT}) {
+    if (static_cast<uint32_t>(count) <= requested && (counts & count)) {
+      return count;
+    }
+  }
+  return VK_SAMPLE_COUNT_1_BIT;
+}
+
 uint32_t VulkEngDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+  uint32_t typeIndex;
+  if (!tryFindMemoryType(typeFilter, properties, typeIndex)) {
+    throw std::runtime_error("failed to find suitable memory type!");
+  }
+  return typeIndex;
+}
+
+bool VulkEngDevice::tryFindMemoryType(
+    uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t &typeIndex) {
   VkPhysicalDeviceMemoryProperties memProperties;
   vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
   for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
     if ((typeFilter & (1 << i)) &&
         (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-      return i;
+      typeIndex = i;
+      return true;
     }
   }
-
-  throw std::runtime_error("failed to find suitable memory type!");
+  return false;
 }
 
 void VulkEngDevice::createBuffer(
@@ -435,15 +620,48 @@ void VulkEngDevice::createBuffer(
 }
 
 VkCommandBuffer VulkEngDevice::beginSingleTimeCommands() {
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = commandPool;
-  allocInfo.commandBufferCount = 1;
+  return beginPooledCommands(commandPool);
+}
 
-  VkCommandBuffer commandBuffer;
-  vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer);
+void VulkEngDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+  waitForUpload(submitUpload(VK_NULL_HANDLE, commandBuffer));
+}
 
+void VulkEngDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+  VulkEngUploadBatch batch{*this};
+  batch.copyBuffer(srcBuffer, dstBuffer, size);
+  waitForUpload(batch.submit());
+}
+
+void VulkEngDevice::copyBufferToImage(
+    VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
+  VulkEngUploadBatch batch{*this};
+  batch.copyBufferToImage(buffer, image, width, height, layerCount);
+  waitForUpload(batch.submit());
+}
+
+VkCommandBuffer VulkEngDevice::beginPooledCommands(VkCommandPool pool) {
+  VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+  auto recycled = std::find_if(
+      freeCommandBuffers.begin(),
+      freeCommandBuffers.end(),
+      [pool](const auto &entry) { return entry.first == pool; });
+  if (recycled != freeCommandBuffers.end()) {
+    commandBuffer = recycled->second;
+    freeCommandBuffers.erase(recycled);
+  } else {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = pool;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate command buffers!");
+    }
+  }
+
+  // the pools are created with RESET_COMMAND_BUFFER_BIT, so begin resets recycled buffers
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
   beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
@@ -452,57 +670,127 @@ VkCommandBuffer VulkEngDevice::beginSingleTimeCommands() {
   return commandBuffer;
 }
 
-void VulkEngDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-  vkEndCommandBuffer(commandBuffer);
+UploadTicket VulkEngDevice::submitUpload(
+    VkCommandBuffer transferCommands,
+    VkCommandBuffer graphicsCommands,
+    std::vector<std::function<void()>> onComplete) {
+  PendingUpload upload{};
+  upload.ticket = ++lastUploadTicket;
+  upload.transferCommands = transferCommands;
+  upload.graphicsCommands = graphicsCommands;
+  upload.onComplete = std::move(onComplete);
+  upload.semaphore = VK_NULL_HANDLE;
+
+  if (freeFences.empty()) {
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device_, &fenceInfo, nullptr, &upload.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create upload fence!");
+    }
+  } else {
+    upload.fence = freeFences.back();
+    freeFences.pop_back();
+  }
 
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffer;
+  if (transferCommands != VK_NULL_HANDLE && graphicsCommands != VK_NULL_HANDLE) {
+    if (freeSemaphores.empty()) {
+      VkSemaphoreCreateInfo semaphoreInfo{};
+      semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &upload.semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload semaphore!");
+      }
+    } else {
+      upload.semaphore = freeSemaphores.back();
+      freeSemaphores.pop_back();
+    }
+  }
 
-  vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue_);
+  if (transferCommands != VK_NULL_HANDLE) {
+    vkEndCommandBuffer(transferCommands);
 
-  vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
-}
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &transferCommands;
+    if (upload.semaphore != VK_NULL_HANDLE) {
+      submitInfo.signalSemaphoreCount = 1;
+      submitInfo.pSignalSemaphores = &upload.semaphore;
+    }
 
-void VulkEngDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    VkFence fence = graphicsCommands == VK_NULL_HANDLE ? upload.fence : VK_NULL_HANDLE;
+    if (vkQueueSubmit(transferQueue_, 1, &submitInfo, fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit transfer command buffer!");
+    }
+  }
+
+  if (graphicsCommands != VK_NULL_HANDLE) {
+    vkEndCommandBuffer(graphicsCommands);
+
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &graphicsCommands;
+    if (upload.semaphore != VK_NULL_HANDLE) {
+      submitInfo.waitSemaphoreCount = 1;
+      submitInfo.pWaitSemaphores = &upload.semaphore;
+      submitInfo.pWaitDstStageMask = &waitStage;
+    }
 
-  VkBufferCopy copyRegion{};
-  copyRegion.srcOffset = 0;  // Optional
-  copyRegion.dstOffset = 0;  // Optional
-  copyRegion.size = size;
-  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+    if (vkQueueSubmit(graphicsQueue_, 1, &submitInfo, upload.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit graphics command buffer!");
+    }
+  }
 
-  endSingleTimeCommands(commandBuffer);
+  pendingUploads.push_back(std::move(upload));
+  return {lastUploadTicket};
 }
 
-void VulkEngDevice::copyBufferToImage(
-    VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-  VkBufferImageCopy region{};
-  region.bufferOffset = 0;
-  region.bufferRowLength = 0;
-  region.bufferImageHeight = 0;
+bool VulkEngDevice::isUploadComplete(UploadTicket ticket) {
+  retireCompletedUploads(false);
+  return std::none_of(pendingUploads.begin(), pendingUploads.end(), [ticket](const auto &upload) {
+    return upload.ticket == ticket.value;
+  });
+}
 
-  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  region.imageSubresource.mipLevel = 0;
-  region.imageSubresource.baseArrayLayer = 0;
-  region.imageSubresource.layerCount = layerCount;
+void VulkEngDevice::waitForUpload(UploadTicket ticket) {
+  auto upload = std::find_if(pendingUploads.begin(), pendingUploads.end(), [ticket](const auto &u) {
+    return u.ticket == ticket.value;
+  });
+  if (upload != pendingUploads.end()) {
+    vkWaitForFences(device_, 1, &upload->fence, VK_TRUE, UINT64_MAX);
+  }
+  retireCompletedUploads(false);
+}
 
-  region.imageOffset = {0, 0, 0};
-  region.imageExtent = {width, height, 1};
+void VulkEngDevice::retireCompletedUploads(bool wait) {
+  // submissions can finish out of order when they use different queues
+  for (size_t i = 0; i < pendingUploads.size();) {
+    PendingUpload &upload = pendingUploads[i];
+    if (wait) {
+      vkWaitForFences(device_, 1, &upload.fence, VK_TRUE, UINT64_MAX);
+    } else if (vkGetFenceStatus(device_, upload.fence) != VK_SUCCESS) {
+      i++;
+      continue;
+    }
 
-  vkCmdCopyBufferToImage(
-      commandBuffer,
-      buffer,
-      image,
-      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      1,
-      &region);
-  endSingleTimeCommands(commandBuffer);
+    vkResetFences(device_, 1, &upload.fence);
+    freeFences.push_back(upload.fence);
+    if (upload.semaphore != VK_NULL_HANDLE) {
+      freeSemaphores.push_back(upload.semaphore);
+    }
+    if (upload.transferCommands != VK_NULL_HANDLE) {
+      freeCommandBuffers.emplace_back(transferCommandPool, upload.transferCommands);
+    }
+    if (upload.graphicsCommands != VK_NULL_HANDLE) {
+      freeCommandBuffers.emplace_back(commandPool, upload.graphicsCommands);
+    }
+    auto onComplete = std::move(upload.onComplete);
+    pendingUploads.erase(pendingUploads.begin() + i);
+    for (auto &callback : onComplete) {
+      callback();
+    }
+  }
 }
 
 void VulkEngDevice::createImageWithInfo(
@@ -531,4 +819,27 @@ void VulkEngDevice::createImageWithInfo(
   }
 }
 
+void VulkEngDevice::deferDestruction(std::function<void()> deleter) {
+  deletionQueue.push_back({submittedFrameCount, std::move(deleter)});
+}
+
+void VulkEngDevice::destroyBufferDeferred(VkBuffer buffer, VkDeviceMemory bufferMemory) {
+  deferDestruction([this, buffer, bufferMemory]() {
+    vkDestroyBuffer(device_, buffer, nullptr);
+    vkFreeMemory(device_, bufferMemory, nullptr);
+  });
+}
+
+void VulkEngDevice::releaseCompletedFrames(uint64_t completedFrameCount) {
+  VulkEngCpuScope scope{"releaseCompletedFrames"};
+  retireCompletedUploads(false);
+
+  // entries are queued in frame order, so only the front can be ready
+  while (!deletionQueue.empty() && deletionQueue.front().frame < completedFrameCount) {
+    auto deleter = std::move(deletionQueue.front().deleter);
+    deletionQueue.pop_front();
+    deleter();
+  }
+}
+
 }  // namespace VulkanEngine
\ No newline at end of file
@@ -3,11 +3,18 @@
 #include "vulkEngWindow.hpp"
 
 // std lib headers
+#include <deque>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace VulkanEngine {
 
+class VulkEngShaderCache;
+class VulkEngLayoutCache;
+class VulkEngSamplerCache;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -17,11 +24,29 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  // families without graphics support; equal to graphicsFamily when the device has none
+  uint32_t transferFamily;
+  uint32_t computeFamily;
+  // 0 when the graphics queue does not support timestamp queries
+  uint32_t graphicsTimestampValidBits = 0;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
+// Device local memory, summed over the heaps that have it.
+struct MemoryBudget {
+  // what this process can allocate without the driver starting to page memory out
+  VkDeviceSize budget = 0;
+  // what this process has allocated, 0 when unknown
+  VkDeviceSize usage = 0;
+};
+
+// Identifies an asynchronous submission made with VulkEngDevice::submitUpload.
+struct UploadTicket {
+  uint64_t value = 0;
+};
+
 class VulkEngDevice {
  public:
 #ifdef NDEBUG
@@ -40,16 +65,46 @@ class VulkEngDevice {
   VulkEngDevice &operator=(VulkEngDevice &&) = delete;
 
   VkCommandPool getCommandPool() { return commandPool; }
+  VkCommandPool getTransferCommandPool() { return transferCommandPool; }
+  VkCommandPool getComputeCommandPool() { return computeCommandPool; }
   VkDevice device() { return device_; }
+  // shared by every pipeline created on this device, see VulkEngShaderCache
+  VulkEngShaderCache &shaderCache() { return *shaderCache_; }
+  // descriptor set and pipeline layouts shared by every pipeline, see VulkEngLayoutCache
+  VulkEngLayoutCache &layoutCache() { return *layoutCache_; }
+  // samplers shared by every texture, see VulkEngSamplerCache
+  VulkEngSamplerCache &samplerCache() { return *samplerCache_; }
   VkSurfaceKHR surface() { return surface_; }
+  // headless devices have no surface and no swap chain support; see VulkEngWindow::isHeadless
+  bool isHeadless() const { return headless; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  VkQueue transferQueue() { return transferQueue_; }
+  VkQueue computeQueue() { return computeQueue_; }
+  bool hasDedicatedTransferQueue() const {
+    return queueFamilies.transferFamily != queueFamilies.graphicsFamily;
+  }
+  bool hasAsyncComputeQueue() const {
+    return queueFamilies.computeFamily != queueFamilies.graphicsFamily;
+  }
+  // Vulkan 1.3 dynamic rendering: render passes and framebuffers are not needed
+  bool supportsDynamicRendering() const { return dynamicRenderingEnabled; }
+  // VK_EXT_memory_budget: getDeviceLocalBudget reports what the driver measures
+  bool supportsMemoryBudget() const { return memoryBudgetEnabled; }
+  // Without VK_EXT_memory_budget the budget is the heap size and the usage unknown.
+  MemoryBudget getDeviceLocalBudget();
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+  // false instead of throwing, for optional properties such as LAZILY_ALLOCATED
+  bool tryFindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t &typeIndex);
   QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
+  const QueueFamilyIndices &queueFamilyIndices() const { return queueFamilies; }
   VkFormat findSupportedFormat(
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+  VkFormatFeatureFlags getOptimalTilingFeatures(VkFormat format);
+  // the highest sample count, up to requested, that both color and depth attachments support
+  VkSampleCountFlagBits getUsableSampleCount(uint32_t requested) const;
 
   // Buffer Helper Functions
   void createBuffer(
@@ -64,13 +119,35 @@ class VulkEngDevice {
   void copyBufferToImage(
       VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
+  // Asynchronous submissions (see VulkEngUploadBatch). Command buffers are begun from a per-pool
+  // free list; submitUpload ends and submits them with a pooled fence, and everything is
+  // recycled, and onComplete run, once that fence has signaled. graphicsCommands, when present,
+  // runs on the graphics queue after transferCommands has finished on the transfer queue.
+  VkCommandBuffer beginPooledCommands(VkCommandPool pool);
+  UploadTicket submitUpload(
+      VkCommandBuffer transferCommands,
+      VkCommandBuffer graphicsCommands,
+      std::vector<std::function<void()>> onComplete = {});
+  bool isUploadComplete(UploadTicket ticket);
+  void waitForUpload(UploadTicket ticket);
+
   void createImageWithInfo(
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
       VkDeviceMemory &imageMemory);
 
+  // Deferred destruction. A deleter queued now runs once every frame submitted so far, and the
+  // frame currently being recorded, has finished executing on the GPU.
+  void deferDestruction(std::function<void()> deleter);
+  void destroyBufferDeferred(VkBuffer buffer, VkDeviceMemory bufferMemory);
+  void markFrameSubmitted() { submittedFrameCount++; }
+  void releaseCompletedFrames(uint64_t completedFrameCount);
+  uint64_t getSubmittedFrameCount() const { return submittedFrameCount; }
+
   VkPhysicalDeviceProperties properties;
+  // features enabled on the logical device, a subset of what the physical device supports
+  VkPhysicalDeviceFeatures enabledFeatures{};
 
  private:
   void createInstance();
@@ -79,6 +156,7 @@ class VulkEngDevice {
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  VkCommandPool createCommandPool(uint32_t queueFamily);
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
@@ -89,20 +167,54 @@ class VulkEngDevice {
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
+  void retireCompletedUploads(bool wait);
 
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   VulkEngWindow &window;
   VkCommandPool commandPool;
+  VkCommandPool transferCommandPool;
+  VkCommandPool computeCommandPool;
+  QueueFamilyIndices queueFamilies;
 
   VkDevice device_;
-  VkSurfaceKHR surface_;
+  std::unique_ptr<VulkEngShaderCache> shaderCache_;
+  std::unique_ptr<VulkEngLayoutCache> layoutCache_;
+  std::unique_ptr<VulkEngSamplerCache> samplerCache_;
+  VkSurfaceKHR surface_ = VK_NULL_HANDLE;
+  bool headless;
+  uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+  bool dynamicRenderingEnabled = false;
+  bool memoryBudgetEnabled = false;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
+  VkQueue computeQueue_;
+
+  struct PendingDestruction {
+    uint64_t frame;
+    std::function<void()> deleter;
+  };
+  std::deque<PendingDestruction> deletionQueue;
+  uint64_t submittedFrameCount = 0;
+
+  struct PendingUpload {
+    uint64_t ticket;
+    VkFence fence;
+    VkSemaphore semaphore;
+    VkCommandBuffer transferCommands;
+    VkCommandBuffer graphicsCommands;
+    std::vector<std::function<void()>> onComplete;
+  };
+  std::vector<PendingUpload> pendingUploads;
+  std::vector<std::pair<VkCommandPool, VkCommandBuffer>> freeCommandBuffers;
+  std::vector<VkFence> freeFences;
+  std::vector<VkSemaphore> freeSemaphores;
+  uint64_t lastUploadTicket = 0;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-  const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 };
 
 }  // namespace VulkanEngine
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "vulkEngDynamicResolution.hpp"
+
+//std
+#include <algorithm>
+#include <cmath>
+
+namespace VulkanEngine {
+
+	namespace {
+		// weight of a new frame time in the average; single frames are noisy, and a scale change
+		// only shows up in the frame times after the frames in flight
+		constexpr double SMOOTHING = 0.1;
+		// aims a little below the target, so a spike does not miss it straight away
+		constexpr double HEADROOM = 0.9;
+		// smaller changes are noise, larger ones are spread over several frames
+		constexpr float DEAD_BAND = 0.02f;
+		constexpr float MAX_STEP = 0.05f;
+	}
+
+	VulkEngDynamicResolution::VulkEngDynamicResolution(const DynamicResolutionConfig& config)
+		: config{ config }, scale{ config.maxScale } {}
+
+	void VulkEngDynamicResolution::addUpscalePass(VulkEngRenderGraph& graph, RenderGraphImage source, RenderGraphImage target) {
+		graph.addPass("upscale")
+			.transferSource(source)
+			.transferDestination(target)
+			.setExecute([&graph, source, target](VkCommandBuffer commandBuffer) {
+				VkExtent2D from = graph.getRenderExtent(source);
+				VkExtent2D to = graph.getRenderExtent(target);
+
+				VkImageBlit blit{};
+				blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				blit.srcOffsets[1] = { static_cast<int32_t>(from.width), static_cast<int32_t>(from.height), 1 };
+				blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				blit.dstOffsets[1] = { static_cast<int32_t>(to.width), static_cast<int32_t>(to.height), 1 };
+				// the 8 bit color formats swap chains use must all support linear filtered blits
+				vkCmdBlitImage(
+					commandBuffer,
+					graph.getImage(source), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					graph.getImage(target), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					1, &blit,
+					VK_FILTER_LINEAR);
+			});
+	}
+
+	void VulkEngDynamicResolution::update(VulkEngRenderGraph& graph, const VulkEngGpuProfiler& profiler) {
+		// the renderer's outermost scope spans the whole frame
+		for (const auto& result : profiler.getResults()) {
+			if (result.depth == 0 && result.name == "frame") {
+				addFrameTime(result.milliseconds);
+				break;
+			}
+		}
+		graph.setRenderScale(scale);
+	}
+
+	float VulkEngDynamicResolution::addFrameTime(double gpuMilliseconds) {
+		if (gpuMilliseconds <= 0.0) {
+			return scale;
+		}
+		smoothedMilliseconds = smoothedMilliseconds == 0.0
+			? gpuMilliseconds
+			: smoothedMilliseconds + SMOOTHING * (gpuMilliseconds - smoothedMilliseconds);
+
+		// GPU time mostly follows the pixels shaded, which grow with the square of the scale
+		float ideal = scale * static_cast<float>(std::sqrt(config.targetMilliseconds * HEADROOM / smoothedMilliseconds));
+		ideal = std::clamp(ideal, config.minScale, config.maxScale);
+		float change = ideal - scale;
+		if (std::abs(change) > DEAD_BAND) {
+			scale += std::clamp(change, -MAX_STEP, MAX_STEP);
+		}
+		return scale;
+	}
+
+} // namespace VulkanEngine
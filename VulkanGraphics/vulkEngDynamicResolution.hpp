@@ -0,0 +1,45 @@
+#pragma once
+
+#include "vulkEngRenderGraph.hpp"
+#include "vulkEngGpuProfiler.hpp"
+
+namespace VulkanEngine {
+
+	struct DynamicResolutionConfig {
+		// GPU time per frame to stay within
+		double targetMilliseconds = 16.0;
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+	};
+
+	// Renders the scene at a fraction of the frame extent that follows the measured GPU frame time,
+	// so heavy scenes hold their frame rate, and blits the result up to the swap chain image. The
+	// scene's graph images must have dynamicResolution set.
+	class VulkEngDynamicResolution {
+
+	public:
+		VulkEngDynamicResolution(const DynamicResolutionConfig& config = {});
+
+		VulkEngDynamicResolution(const VulkEngDynamicResolution&) = delete;
+		VulkEngDynamicResolution& operator=(const VulkEngDynamicResolution&) = delete;
+
+		// Adds a pass that scales the rendered region of source over all of target, with linear
+		// filtering. graph must outlive this object.
+		void addUpscalePass(VulkEngRenderGraph& graph, RenderGraphImage source, RenderGraphImage target);
+
+		// Per frame, after VulkEngRenderer::beginFrame has read back the GPU times of an earlier
+		// frame and before the graph executes: sets the graph's render scale.
+		void update(VulkEngRenderGraph& graph, const VulkEngGpuProfiler& profiler);
+
+		// Takes the GPU time of a finished frame, returns the scale to render the next one at.
+		float addFrameTime(double gpuMilliseconds);
+		float getScale() const { return scale; }
+
+	private:
+		DynamicResolutionConfig config;
+		float scale;
+		// exponential moving average, 0 before the first frame
+		double smoothedMilliseconds = 0.0;
+	};
+
+} // namespace VulkanEngine
@@ -0,0 +1,142 @@
+#include "vulkEngFrameCapture.hpp"
+
+//std
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace VulkanEngine
+{
+	namespace {
+		constexpr char MAGIC[4] = { 'V', 'E', 'F', 'C' };
+		constexpr uint32_t VERSION = 1;
+		constexpr uint32_t NO_MODEL = ~0u;
+
+		template <typename T>
+		void append(std::vector<char>& buffer, const T& value) {
+			const char* bytes = reinterpret_cast<const char*>(&value);
+			buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+		}
+
+		void appendVec3(std::vector<char>& buffer, const glm::vec3& value) {
+			append(buffer, value.x);
+			append(buffer, value.y);
+			append(buffer, value.z);
+		}
+
+		template <typename T>
+		bool read(std::ifstream& file, T& value) {
+			return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+		}
+
+		bool readVec3(std::ifstream& file, glm::vec3& value) {
+			return read(file, value.x) && read(file, value.y) && read(file, value.z);
+		}
+	}
+
+	VulkEngFrameRecorder::VulkEngFrameRecorder(const std::string& path, uint32_t width, uint32_t height, uint32_t modelCount)
+		: file{ path, std::ios::binary | std::ios::trunc }
+	{
+		if (!file) {
+			throw std::runtime_error("failed to open frame capture file: " + path);
+		}
+		file.write(MAGIC, sizeof(MAGIC));
+		for (uint32_t value : { VERSION, width, height, modelCount }) {
+			file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+	}
+
+	void VulkEngFrameRecorder::recordFrame(
+		const std::vector<FrameEvent>& events,
+		const std::vector<VulkEngGameObj>& gameObjects,
+		const std::vector<std::shared_ptr<VulkEngModel>>& models) {
+		// one write per frame; the buffer keeps its capacity between frames
+		frameBuffer.clear();
+
+		append(frameBuffer, static_cast<uint32_t>(events.size()));
+		for (const auto& event : events) {
+			append(frameBuffer, static_cast<uint32_t>(event.type));
+			append(frameBuffer, event.a);
+			append(frameBuffer, event.b);
+		}
+
+		append(frameBuffer, static_cast<uint32_t>(gameObjects.size()));
+		for (const auto& obj : gameObjects) {
+			auto model = std::find(models.begin(), models.end(), obj.model);
+			append(frameBuffer, model == models.end() ? NO_MODEL : static_cast<uint32_t>(model - models.begin()));
+			appendVec3(frameBuffer, obj.color);
+			appendVec3(frameBuffer, obj.transform.translation);
+			appendVec3(frameBuffer, obj.transform.scale);
+			appendVec3(frameBuffer, obj.transform.rotationRadians);
+		}
+
+		file.write(frameBuffer.data(), static_cast<std::streamsize>(frameBuffer.size()));
+		if (!file) {
+			throw std::runtime_error("failed to write frame capture!");
+		}
+		frameCount++;
+	}
+
+	VulkEngFrameReplay::VulkEngFrameReplay(const std::string& path) : file{ path, std::ios::binary } {
+		if (!file) {
+			throw std::runtime_error("failed to open frame capture file: " + path);
+		}
+
+		char magic[4];
+		uint32_t version = 0;
+		if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+			!read(file, version) || version != VERSION) {
+			throw std::runtime_error("not a supported frame capture: " + path);
+		}
+		if (!read(file, width) || !read(file, height) || !read(file, modelCount)) {
+			throw std::runtime_error("truncated frame capture header: " + path);
+		}
+	}
+
+	bool VulkEngFrameReplay::readFrame(
+		std::vector<FrameEvent>& events,
+		std::vector<VulkEngGameObj>& gameObjects,
+		const std::vector<std::shared_ptr<VulkEngModel>>& models) {
+		uint32_t eventCount = 0;
+		if (!read(file, eventCount)) {
+			return false;
+		}
+
+		events.resize(eventCount);
+		for (auto& event : events) {
+			uint32_t type = 0;
+			if (!read(file, type) || !read(file, event.a) || !read(file, event.b)) {
+				throw std::runtime_error("truncated frame capture!");
+			}
+			event.type = static_cast<FrameEvent::Type>(type);
+		}
+
+		uint32_t objectCount = 0;
+		if (!read(file, objectCount)) {
+			throw std::runtime_error("truncated frame capture!");
+		}
+		while (gameObjects.size() < objectCount) {
+			gameObjects.push_back(VulkEngGameObj::createGameObject());
+		}
+		while (gameObjects.size() > objectCount) {
+			gameObjects.pop_back();
+		}
+
+		for (auto& obj : gameObjects) {
+			uint32_t modelIndex = 0;
+			if (!read(file, modelIndex) ||
+				!readVec3(file, obj.color) ||
+				!readVec3(file, obj.transform.translation) ||
+				!readVec3(file, obj.transform.scale) ||
+				!readVec3(file, obj.transform.rotationRadians)) {
+				throw std::runtime_error("truncated frame capture!");
+			}
+			if (modelIndex != NO_MODEL && modelIndex >= models.size()) {
+				throw std::runtime_error("frame capture references an unknown model!");
+			}
+			obj.model = modelIndex == NO_MODEL ? nullptr : models[modelIndex];
+		}
+		return true;
+	}
+
+} // namespace VulkanEngine
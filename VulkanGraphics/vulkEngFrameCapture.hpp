@@ -0,0 +1,77 @@
+#pragma once
+
+#include "vulkEngGameObj.hpp"
+
+//std
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace VulkanEngine {
+
+	struct FrameEvent {
+		enum class Type : uint32_t {
+			Resize = 1	// a, b: new framebuffer width and height
+		};
+
+		Type type;
+		int32_t a;
+		int32_t b;
+	};
+
+	// Capture file layout, all values in native byte order:
+	//   header: "VEFC", version, width, height, model count (uint32 each)
+	//   frame:  event count, events (type, a, b), object count,
+	//           objects (model index, color, translation, scale, rotation as 12 floats)
+	// Models are referenced by their index in the application's model list, which a replay
+	// must rebuild identically.
+	class VulkEngFrameRecorder {
+
+	public:
+		VulkEngFrameRecorder(const std::string& path, uint32_t width, uint32_t height, uint32_t modelCount);
+
+		VulkEngFrameRecorder(const VulkEngFrameRecorder&) = delete;
+		VulkEngFrameRecorder& operator=(const VulkEngFrameRecorder&) = delete;
+
+		void recordFrame(
+			const std::vector<FrameEvent>& events,
+			const std::vector<VulkEngGameObj>& gameObjects,
+			const std::vector<std::shared_ptr<VulkEngModel>>& models);
+
+		uint32_t getFrameCount() const { return frameCount; }
+
+	private:
+		std::ofstream file;
+		std::vector<char> frameBuffer;
+		uint32_t frameCount = 0;
+	};
+
+	class VulkEngFrameReplay {
+
+	public:
+		VulkEngFrameReplay(const std::string& path);
+
+		VulkEngFrameReplay(const VulkEngFrameReplay&) = delete;
+		VulkEngFrameReplay& operator=(const VulkEngFrameReplay&) = delete;
+
+		uint32_t getWidth() const { return width; }
+		uint32_t getHeight() const { return height; }
+		uint32_t getModelCount() const { return modelCount; }
+
+		// Restores the next frame into gameObjects, creating or dropping objects to match the
+		// capture. Returns false once every frame has been played.
+		bool readFrame(
+			std::vector<FrameEvent>& events,
+			std::vector<VulkEngGameObj>& gameObjects,
+			const std::vector<std::shared_ptr<VulkEngModel>>& models);
+
+	private:
+		std::ifstream file;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t modelCount = 0;
+	};
+
+} // namespace VulkanEngine
@@ -0,0 +1,422 @@
+#include "vulkEngFrameReadback.hpp"
+#include "vulkEngCpuProfiler.hpp"
+
+//std
+#include <algorithm>
+#include <array>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace VulkanEngine {
+
+	namespace {
+		constexpr uint32_t BYTES_PER_PIXEL = 4;
+		// the largest stored deflate block
+		constexpr size_t MAX_STORED_BLOCK = 65535;
+
+		FILE* openPipe(const std::string& command) {
+#ifdef _WIN32
+			return _popen(command.c_str(), "wb");
+#else
+			return popen(command.c_str(), "w");
+#endif
+		}
+
+		void closePipe(FILE* pipe) {
+#ifdef _WIN32
+			_pclose(pipe);
+#else
+			pclose(pipe);
+#endif
+		}
+
+		bool isBgra(VkFormat format) {
+			return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+		}
+
+		bool isRgba(VkFormat format) {
+			return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM;
+		}
+
+		uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+			static const std::array<uint32_t, 256> table = [] {
+				std::array<uint32_t, 256> entries{};
+				for (uint32_t i = 0; i < 256; i++) {
+					uint32_t c = i;
+					for (int k = 0; k < 8; k++) {
+						c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					}
+					entries[i] = c;
+				}
+				return entries;
+			}();
+			crc = ~crc;
+			for (size_t i = 0; i < size; i++) {
+				crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+			}
+			return ~crc;
+		}
+
+		void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+			out.push_back(static_cast<uint8_t>(value >> 24));
+			out.push_back(static_cast<uint8_t>(value >> 16));
+			out.push_back(static_cast<uint8_t>(value >> 8));
+			out.push_back(static_cast<uint8_t>(value));
+		}
+
+		// appends length, type, data and CRC; the data must already be at the end of out, after the
+		// 8 bytes reserved for length and type at chunkStart
+		void finishChunk(std::vector<uint8_t>& out, size_t chunkStart, const char* type) {
+			uint32_t length = static_cast<uint32_t>(out.size() - chunkStart - 8);
+			for (int i = 0; i < 4; i++) {
+				out[chunkStart + i] = static_cast<uint8_t>(length >> (24 - 8 * i));
+				out[chunkStart + 4 + i] = static_cast<uint8_t>(type[i]);
+			}
+			appendBigEndian(out, crc32(out.data() + chunkStart + 4, length + 4));
+		}
+
+		size_t beginChunk(std::vector<uint8_t>& out) {
+			size_t chunkStart = out.size();
+			out.resize(out.size() + 8);
+			return chunkStart;
+		}
+	}
+
+	VulkEngFrameReadback::VulkEngFrameReadback(VulkEngDevice& device, const FrameReadbackConfig& config, uint32_t frameCount)
+		: vulkanDevice{ device }, config{ config }, slots(frameCount)
+	{
+		if (this->config.interval == 0) {
+			this->config.interval = 1;
+		}
+		if (this->config.maxQueuedFrames == 0) {
+			this->config.maxQueuedFrames = 1;
+		}
+
+		switch (config.output) {
+		case ReadbackOutput::RawSequence:
+		case ReadbackOutput::PngSequence: {
+			std::error_code error;
+			std::filesystem::create_directories(config.target, error);
+			if (error) {
+				throw std::runtime_error("failed to create readback directory " + config.target + "!");
+			}
+			break;
+		}
+		case ReadbackOutput::Pipe:
+#ifndef _WIN32
+			// a command that exits early must not take the renderer down with it; writes then fail instead
+			std::signal(SIGPIPE, SIG_IGN);
+#endif
+			pipe = openPipe(config.target);
+			if (pipe == nullptr) {
+				throw std::runtime_error("failed to start readback command " + config.target + "!");
+			}
+			break;
+		case ReadbackOutput::None:
+			break;
+		}
+
+		// the CPU reads every byte of the copies; uncached memory makes reading many times slower
+		uint32_t typeIndex;
+		hostCached = vulkanDevice.tryFindMemoryType(
+			~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, typeIndex);
+
+		worker = std::thread{ &VulkEngFrameReadback::run, this };
+	}
+
+	VulkEngFrameReadback::~VulkEngFrameReadback() {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+		queueChanged.notify_all();
+		worker.join();
+		if (pipe != nullptr) {
+			closePipe(pipe);
+		}
+
+		VkDevice device = vulkanDevice.device();
+		for (auto& slot : slots) {
+			if (slot.buffer != VK_NULL_HANDLE) {
+				vkUnmapMemory(device, slot.memory);
+				vulkanDevice.destroyBufferDeferred(slot.buffer, slot.memory);
+			}
+		}
+	}
+
+	void VulkEngFrameReadback::addReadbackPass(VulkEngRenderGraph& graph, RenderGraphImage image, VkFormat format) {
+		if (!isBgra(format) && !isRgba(format)) {
+			throw std::runtime_error("frame readback only supports 8 bit RGBA and BGRA images!");
+		}
+		swapRedBlue = isBgra(format);
+
+		graph.addPass("readback")
+			.transferSource(image)
+			// it writes nothing the graph knows about, which would get it culled
+			.setSideEffects()
+			.setExecute([this, &graph, image](VkCommandBuffer commandBuffer) {
+				if (copyThisFrame) {
+					recordCopy(commandBuffer, graph.getImage(image), graph.getRenderExtent(image));
+				}
+			});
+	}
+
+	void VulkEngFrameReadback::setFrameCallback(std::function<void(const ReadbackFrame&)> callback) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		frameCallback = std::move(callback);
+	}
+
+	void VulkEngFrameReadback::beginFrame(uint32_t frameIndex) {
+		VulkEngCpuScope scope{ "readback" };
+		currentFrame = frameIndex;
+		collect(slots[frameIndex]);
+		copyThisFrame = frameNumber % config.interval == 0;
+		frameNumber++;
+	}
+
+	void VulkEngFrameReadback::flush() {
+		VulkEngCpuScope scope{ "readbackFlush" };
+		// oldest first, so frames reach the output in order
+		uint32_t slotCount = static_cast<uint32_t>(slots.size());
+		for (uint32_t i = 1; i <= slotCount; i++) {
+			collect(slots[(currentFrame + i) % slotCount]);
+		}
+
+		std::unique_lock<std::mutex> lock{ mutex };
+		queueChanged.wait(lock, [this] { return queue.empty() && !writing; });
+	}
+
+	uint64_t VulkEngFrameReadback::getWrittenFrameCount() const {
+		std::lock_guard<std::mutex> lock{ mutex };
+		return writtenFrames;
+	}
+
+	void VulkEngFrameReadback::recordCopy(VkCommandBuffer commandBuffer, VkImage image, VkExtent2D extent) {
+		Slot& slot = slots[currentFrame];
+		reserve(slot, static_cast<VkDeviceSize>(extent.width) * extent.height * BYTES_PER_PIXEL);
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = 0;
+		// tightly packed
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { extent.width, extent.height, 1 };
+		vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+		// the fence wait before the slot is collected does not make the copy visible to the host by itself
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		slot.pending = true;
+		slot.frameNumber = frameNumber - 1;
+		slot.extent = extent;
+	}
+
+	void VulkEngFrameReadback::reserve(Slot& slot, VkDeviceSize size) {
+		if (slot.size >= size) {
+			return;
+		}
+		if (slot.buffer != VK_NULL_HANDLE) {
+			vkUnmapMemory(vulkanDevice.device(), slot.memory);
+			vulkanDevice.destroyBufferDeferred(slot.buffer, slot.memory);
+		}
+		vulkanDevice.createBuffer(
+			size,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | (hostCached ? VK_MEMORY_PROPERTY_HOST_CACHED_BIT : VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+			slot.buffer,
+			slot.memory);
+		vkMapMemory(vulkanDevice.device(), slot.memory, 0, VK_WHOLE_SIZE, 0, &slot.mapped);
+		slot.size = size;
+	}
+
+	void VulkEngFrameReadback::collect(Slot& slot) {
+		if (!slot.pending) {
+			return;
+		}
+		slot.pending = false;
+
+		// cached memory need not be coherent
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = slot.memory;
+		range.offset = 0;
+		range.size = VK_WHOLE_SIZE;
+		vkInvalidateMappedMemoryRanges(vulkanDevice.device(), 1, &range);
+
+		size_t size = static_cast<size_t>(slot.extent.width) * slot.extent.height * BYTES_PER_PIXEL;
+		ReadbackFrame frame{ slot.frameNumber, slot.extent.width, slot.extent.height, {} };
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			if (queue.size() >= config.maxQueuedFrames) {
+				VulkEngCpuScope scope{ "waitForReadbackWriter" };
+				queueChanged.wait(lock, [this] { return queue.size() < config.maxQueuedFrames; });
+			}
+			if (!freePixels.empty()) {
+				frame.pixels = std::move(freePixels.back());
+				freePixels.pop_back();
+			}
+		}
+		// only a copy here; converting and encoding are left to the writer thread
+		frame.pixels.resize(size);
+		std::memcpy(frame.pixels.data(), slot.mapped, size);
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			queue.push_back(std::move(frame));
+		}
+		queueChanged.notify_all();
+	}
+
+	void VulkEngFrameReadback::run() {
+		VulkEngCpuProfiler::setThreadName("readback writer");
+		for (;;) {
+			ReadbackFrame frame;
+			std::function<void(const ReadbackFrame&)> callback;
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				queueChanged.wait(lock, [this] { return !queue.empty() || stopping; });
+				if (queue.empty()) {
+					return;
+				}
+				frame = std::move(queue.front());
+				queue.pop_front();
+				writing = true;
+				callback = frameCallback;
+			}
+			queueChanged.notify_all();
+
+			{
+				VulkEngCpuScope scope{ "writeFrame" };
+				if (swapRedBlue) {
+					for (size_t i = 0; i < frame.pixels.size(); i += BYTES_PER_PIXEL) {
+						std::swap(frame.pixels[i], frame.pixels[i + 2]);
+					}
+				}
+				if (callback) {
+					callback(frame);
+				}
+				write(frame);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock{ mutex };
+				freePixels.push_back(std::move(frame.pixels));
+				writing = false;
+				writtenFrames++;
+			}
+			queueChanged.notify_all();
+		}
+	}
+
+	void VulkEngFrameReadback::write(ReadbackFrame& frame) {
+		if (outputFailed) {
+			return;
+		}
+
+		std::ostringstream name;
+		name << config.target << "/frame_" << std::setw(6) << std::setfill('0') << frame.frameNumber;
+		switch (config.output) {
+		case ReadbackOutput::RawSequence: {
+			name << "_" << frame.width << "x" << frame.height << ".rgba";
+			std::ofstream file{ name.str(), std::ios::binary };
+			file.write(reinterpret_cast<const char*>(frame.pixels.data()), static_cast<std::streamsize>(frame.pixels.size()));
+			outputFailed = !file;
+			break;
+		}
+		case ReadbackOutput::PngSequence:
+			name << ".png";
+			writePng(name.str(), frame);
+			break;
+		case ReadbackOutput::Pipe:
+			outputFailed = std::fwrite(frame.pixels.data(), 1, frame.pixels.size(), pipe) != frame.pixels.size();
+			break;
+		case ReadbackOutput::None:
+			break;
+		}
+		// the frame callback keeps getting frames
+		if (outputFailed) {
+			std::cerr << "frame readback: failed to write frame " << frame.frameNumber
+				<< " to " << config.target << ", no further frames are written" << std::endl;
+		}
+	}
+
+	// Stored (uncompressed) deflate blocks: nothing to link against, and encoding costs no more than
+	// the copy, so the writer keeps up with the frame rate at the price of larger files.
+	void VulkEngFrameReadback::writePng(const std::string& path, const ReadbackFrame& frame) {
+		size_t rowSize = static_cast<size_t>(frame.width) * BYTES_PER_PIXEL;
+		size_t dataSize = (rowSize + 1) * frame.height;
+		size_t blockCount = (dataSize + MAX_STORED_BLOCK - 1) / MAX_STORED_BLOCK;
+
+		encoded.clear();
+		encoded.reserve(dataSize + blockCount * 5 + 128);
+		const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		encoded.insert(encoded.end(), std::begin(signature), std::end(signature));
+
+		size_t chunk = beginChunk(encoded);
+		appendBigEndian(encoded, frame.width);
+		appendBigEndian(encoded, frame.height);
+		// 8 bits per channel, RGBA, deflate, adaptive filtering, no interlacing
+		encoded.insert(encoded.end(), { 8, 6, 0, 0, 0 });
+		finishChunk(encoded, chunk, "IHDR");
+
+		chunk = beginChunk(encoded);
+		// zlib header: deflate with a 32K window, no preset dictionary, fastest
+		encoded.insert(encoded.end(), { 0x78, 0x01 });
+		uint32_t adlerA = 1;
+		uint32_t adlerB = 0;
+		size_t row = 0;
+		size_t column = 0;
+		size_t remaining = dataSize;
+		while (remaining > 0) {
+			uint16_t blockSize = static_cast<uint16_t>(std::min(remaining, MAX_STORED_BLOCK));
+			uint16_t inverseSize = static_cast<uint16_t>(~blockSize);
+			remaining -= blockSize;
+			// the last block is marked final
+			encoded.push_back(remaining == 0 ? 1 : 0);
+			encoded.push_back(static_cast<uint8_t>(blockSize));
+			encoded.push_back(static_cast<uint8_t>(blockSize >> 8));
+			encoded.push_back(static_cast<uint8_t>(inverseSize));
+			encoded.push_back(static_cast<uint8_t>(inverseSize >> 8));
+			for (uint16_t i = 0; i < blockSize; i++) {
+				// every row starts with its filter type, 0 for none
+				uint8_t value = column == 0 ? 0 : frame.pixels[row * rowSize + column - 1];
+				if (++column > rowSize) {
+					column = 0;
+					row++;
+				}
+				encoded.push_back(value);
+				adlerA = (adlerA + value) % 65521;
+				adlerB = (adlerB + adlerA) % 65521;
+			}
+		}
+		appendBigEndian(encoded, (adlerB << 16) | adlerA);
+		finishChunk(encoded, chunk, "IDAT");
+
+		chunk = beginChunk(encoded);
+		finishChunk(encoded, chunk, "IEND");
+
+		std::ofstream file{ path, std::ios::binary };
+		file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+		outputFailed = !file;
+	}
+
+} // namespace VulkanEngine
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "vulkEngDevice.hpp"
+#include "vulkEngRenderGraph.hpp"
+
+//std
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace VulkanEngine {
+
+	enum class ReadbackOutput {
+		// frames only go to the frame callback
+		None,
+		// target/frame_<number>_<width>x<height>.rgba, tightly packed 8 bit RGBA rows
+		RawSequence,
+		// target/frame_<number>.png
+		PngSequence,
+		// the same bytes as RawSequence, one frame after another, into the standard input of the
+		// command target, e.g. ffmpeg -f rawvideo -pix_fmt rgba -s 800x600 -i - out.mp4
+		Pipe
+	};
+
+	struct FrameReadbackConfig {
+		ReadbackOutput output = ReadbackOutput::None;
+		std::string target;
+		// frames between readbacks, 1 reads back every frame
+		uint32_t interval = 1;
+		// frames waiting for the writer thread; once it falls this far behind, rendering waits for it
+		uint32_t maxQueuedFrames = 8;
+	};
+
+	// A frame as the writer thread hands it out, in tightly packed 8 bit RGBA rows.
+	struct ReadbackFrame {
+		uint64_t frameNumber;
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> pixels;
+	};
+
+	// Copies a rendered image into host visible buffers, one per frame slot, and maps each copy
+	// when its slot comes around again, after VulkEngRenderer::beginFrame has waited on the slot's
+	// fence, so reading frames back never stalls the GPU. The pixels are written out by a
+	// background thread.
+	class VulkEngFrameReadback {
+
+	public:
+		VulkEngFrameReadback(VulkEngDevice& device, const FrameReadbackConfig& config, uint32_t frameCount);
+		~VulkEngFrameReadback();
+
+		VulkEngFrameReadback(const VulkEngFrameReadback&) = delete;
+		VulkEngFrameReadback& operator=(const VulkEngFrameReadback&) = delete;
+
+		// Adds a pass copying image, which must have an 8 bit RGBA or BGRA format and transfer source
+		// usage, after every pass declared before it. graph must outlive this object.
+		void addReadbackPass(VulkEngRenderGraph& graph, RenderGraphImage image, VkFormat format);
+
+		// Called on the writer thread with every frame read back, before it is written out.
+		void setFrameCallback(std::function<void(const ReadbackFrame&)> callback);
+
+		// Per frame, after VulkEngRenderer::beginFrame and before the graph executes: hands the copy
+		// this slot made last time to the writer thread.
+		void beginFrame(uint32_t frameIndex);
+		// Once the device is idle: hands over the copies still in the ring and waits until the
+		// writer thread has written every frame.
+		void flush();
+
+		uint64_t getWrittenFrameCount() const;
+
+	private:
+		struct Slot {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			void* mapped = nullptr;
+			VkDeviceSize size = 0;
+			bool pending = false;
+			uint64_t frameNumber = 0;
+			VkExtent2D extent{ 0, 0 };
+		};
+
+		void recordCopy(VkCommandBuffer commandBuffer, VkImage image, VkExtent2D extent);
+		void reserve(Slot& slot, VkDeviceSize size);
+		void collect(Slot& slot);
+
+		void run();
+		void write(ReadbackFrame& frame);
+		void writePng(const std::string& path, const ReadbackFrame& frame);
+
+		VulkEngDevice& vulkanDevice;
+		FrameReadbackConfig config;
+		std::vector<Slot> slots;
+		uint32_t currentFrame = 0;
+		uint64_t frameNumber = 0;
+		bool copyThisFrame = false;
+		// the image is BGRA; swapped to RGBA on the writer thread
+		bool swapRedBlue = false;
+		bool hostCached = false;
+
+		mutable std::mutex mutex;
+		std::condition_variable queueChanged;
+		std::deque<ReadbackFrame> queue;
+		// pixel vectors of written frames, reused so steady state readback does not allocate
+		std::vector<std::vector<uint8_t>> freePixels;
+		std::function<void(const ReadbackFrame&)> frameCallback;
+		bool writing = false;
+		bool stopping = false;
+		uint64_t writtenFrames = 0;
+		std::thread worker;
+
+		FILE* pipe = nullptr;
+		bool outputFailed = false;
+		// writer thread only
+		std::vector<uint8_t> encoded;
+	};
+
+} // namespace VulkanEngine
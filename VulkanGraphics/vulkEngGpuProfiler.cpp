@@ -0,0 +1,252 @@
+#include "vulkEngGpuProfiler.hpp"
+
+//std
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace VulkanEngine
+{
+	namespace {
+		constexpr VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+		// results are written in bit order, matching the GpuPipelineStatistics members
+		constexpr uint32_t STATISTIC_COUNT = 6;
+	}
+
+	VulkEngGpuProfiler::VulkEngGpuProfiler(VulkEngDevice& device, uint32_t frameCount) : vulkanDevice{ device } {
+		uint32_t validBits = device.queueFamilyIndices().graphicsTimestampValidBits;
+		timestampsSupported = validBits > 0 && device.properties.limits.timestampPeriod > 0.0f;
+		if (!timestampsSupported) {
+			return;
+		}
+		statisticsSupported = device.enabledFeatures.pipelineStatisticsQuery == VK_TRUE;
+		nanosecondsPerTick = static_cast<double>(device.properties.limits.timestampPeriod);
+		timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+		frames.resize(frameCount);
+		for (auto& frame : frames) {
+			VkQueryPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			poolInfo.queryCount = MAX_SCOPES * 2;
+			if (vkCreateQueryPool(device.device(), &poolInfo, nullptr, &frame.timestamps) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create timestamp query pool!");
+			}
+
+			if (statisticsSupported) {
+				poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+				poolInfo.queryCount = MAX_SCOPES;
+				poolInfo.pipelineStatistics = STATISTIC_FLAGS;
+				if (vkCreateQueryPool(device.device(), &poolInfo, nullptr, &frame.statistics) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create pipeline statistics query pool!");
+				}
+			}
+			frame.scopes.reserve(MAX_SCOPES);
+		}
+	}
+
+	VulkEngGpuProfiler::~VulkEngGpuProfiler() {
+		for (auto& frame : frames) {
+			vkDestroyQueryPool(vulkanDevice.device(), frame.timestamps, nullptr);
+			if (frame.statistics != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(vulkanDevice.device(), frame.statistics, nullptr);
+			}
+		}
+	}
+
+	void VulkEngGpuProfiler::setLogInterval(uint32_t frameCount) {
+		logInterval = frameCount;
+		framesSinceLog = 0;
+		averages.clear();
+	}
+
+	void VulkEngGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+		if (!timestampsSupported) {
+			return;
+		}
+		assert(frameIndex < frames.size() && "Frame index out of range");
+		assert(openDepth == 0 && "Previous frame left a GPU scope open");
+
+		currentFrame = frameIndex;
+		FrameQueries& frame = frames[currentFrame];
+		if (frame.recorded) {
+			readBack(frame);
+			accumulate();
+		}
+
+		vkCmdResetQueryPool(commandBuffer, frame.timestamps, 0, MAX_SCOPES * 2);
+		if (frame.statistics != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, frame.statistics, 0, MAX_SCOPES);
+		}
+		frame.scopes.clear();
+		frame.statisticsCount = 0;
+		frame.recorded = true;
+	}
+
+	uint32_t VulkEngGpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name, bool withStatistics, uint64_t pixelCount) {
+		if (!timestampsSupported) {
+			return INVALID_SCOPE;
+		}
+		FrameQueries& frame = frames[currentFrame];
+		if (frame.scopes.size() >= MAX_SCOPES) {
+			return INVALID_SCOPE;
+		}
+
+		uint32_t scope = static_cast<uint32_t>(frame.scopes.size());
+		Scope entry{ name, openDepth, INVALID_SCOPE, true, pixelCount };
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestamps, scope * 2);
+
+		if (withStatistics && frame.statistics != VK_NULL_HANDLE) {
+			assert(!statisticsOpen && "Pipeline statistics scopes cannot nest");
+			entry.statisticsQuery = frame.statisticsCount++;
+			vkCmdBeginQuery(commandBuffer, frame.statistics, entry.statisticsQuery, 0);
+			statisticsOpen = true;
+		}
+
+		frame.scopes.push_back(entry);
+		openDepth++;
+		return scope;
+	}
+
+	void VulkEngGpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+		if (scope == INVALID_SCOPE) {
+			return;
+		}
+		FrameQueries& frame = frames[currentFrame];
+		assert(scope < frame.scopes.size() && frame.scopes[scope].open && "GPU scope is not open");
+
+		Scope& entry = frame.scopes[scope];
+		if (entry.statisticsQuery != INVALID_SCOPE) {
+			vkCmdEndQuery(commandBuffer, frame.statistics, entry.statisticsQuery);
+			statisticsOpen = false;
+		}
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestamps, scope * 2 + 1);
+		entry.open = false;
+		openDepth--;
+	}
+
+	void VulkEngGpuProfiler::readBack(FrameQueries& frame) {
+		results.clear();
+		if (frame.scopes.empty()) {
+			return;
+		}
+
+		// the frame's fence has signaled, so the results are available without VK_QUERY_RESULT_WAIT_BIT
+		uint32_t timestampCount = static_cast<uint32_t>(frame.scopes.size()) * 2;
+		std::vector<uint64_t> timestamps(timestampCount);
+		if (vkGetQueryPoolResults(
+			vulkanDevice.device(),
+			frame.timestamps,
+			0,
+			timestampCount,
+			timestamps.size() * sizeof(uint64_t),
+			timestamps.data(),
+			sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+			return;
+		}
+
+		std::vector<uint64_t> statistics(frame.statisticsCount * STATISTIC_COUNT);
+		bool hasStatistics = frame.statisticsCount > 0 && vkGetQueryPoolResults(
+			vulkanDevice.device(),
+			frame.statistics,
+			0,
+			frame.statisticsCount,
+			statistics.size() * sizeof(uint64_t),
+			statistics.data(),
+			STATISTIC_COUNT * sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+
+		for (size_t i = 0; i < frame.scopes.size(); i++) {
+			const Scope& scope = frame.scopes[i];
+			GpuScopeResult result{};
+			result.name = scope.name;
+			result.depth = scope.depth;
+			result.pixelCount = scope.pixelCount;
+			uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask;
+			result.milliseconds = static_cast<double>(ticks) * nanosecondsPerTick / 1e6;
+
+			if (hasStatistics && scope.statisticsQuery != INVALID_SCOPE) {
+				const uint64_t* values = &statistics[scope.statisticsQuery * STATISTIC_COUNT];
+				result.hasStatistics = true;
+				result.statistics.inputAssemblyVertices = values[0];
+				result.statistics.inputAssemblyPrimitives = values[1];
+				result.statistics.vertexShaderInvocations = values[2];
+				result.statistics.clippingInvocations = values[3];
+				result.statistics.clippingPrimitives = values[4];
+				result.statistics.fragmentShaderInvocations = values[5];
+			}
+			results.push_back(std::move(result));
+		}
+	}
+
+	void VulkEngGpuProfiler::accumulate() {
+		if (logInterval == 0) {
+			return;
+		}
+
+		for (const auto& result : results) {
+			auto average = std::find_if(averages.begin(), averages.end(), [&result](const ScopeAverage& a) {
+				return a.name == result.name && a.depth == result.depth;
+			});
+			if (average == averages.end()) {
+				averages.push_back({ result.name, result.depth, 0.0, 0, false, {}, 0 });
+				average = averages.end() - 1;
+			}
+			average->totalMilliseconds += result.milliseconds;
+			average->samples++;
+			if (result.hasStatistics) {
+				average->hasStatistics = true;
+				average->totalStatistics.inputAssemblyVertices += result.statistics.inputAssemblyVertices;
+				average->totalStatistics.inputAssemblyPrimitives += result.statistics.inputAssemblyPrimitives;
+				average->totalStatistics.vertexShaderInvocations += result.statistics.vertexShaderInvocations;
+				average->totalStatistics.clippingInvocations += result.statistics.clippingInvocations;
+				average->totalStatistics.clippingPrimitives += result.statistics.clippingPrimitives;
+				average->totalStatistics.fragmentShaderInvocations += result.statistics.fragmentShaderInvocations;
+				average->totalPixelCount += result.pixelCount;
+			}
+		}
+
+		if (++framesSinceLog >= logInterval) {
+			logAverages();
+			framesSinceLog = 0;
+			averages.clear();
+		}
+	}
+
+	void VulkEngGpuProfiler::logAverages() {
+		std::cout << "gpu profile, average of " << framesSinceLog << " frames:" << std::endl;
+		for (const auto& average : averages) {
+			std::cout << std::string(2 + average.depth * 2, ' ') << average.name << ": "
+				<< std::fixed << std::setprecision(3) << average.totalMilliseconds / average.samples << " ms";
+			if (average.hasStatistics) {
+				const GpuPipelineStatistics& stats = average.totalStatistics;
+				std::cout << ", vertices " << stats.inputAssemblyVertices / average.samples
+					<< ", primitives " << stats.inputAssemblyPrimitives / average.samples
+					<< ", vs " << stats.vertexShaderInvocations / average.samples
+					<< ", clipped " << stats.clippingInvocations / average.samples
+					<< " -> " << stats.clippingPrimitives / average.samples
+					<< ", fs " << stats.fragmentShaderInvocations / average.samples;
+				if (average.totalPixelCount > 0) {
+					std::cout << ", overdraw " << std::setprecision(2)
+						<< static_cast<double>(stats.fragmentShaderInvocations) / average.totalPixelCount;
+				}
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	VulkEngGpuScope::VulkEngGpuScope(VulkEngGpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name, bool withStatistics)
+		: profiler{ profiler }, commandBuffer{ commandBuffer }, scope{ profiler.beginScope(commandBuffer, name, withStatistics) } {}
+
+	VulkEngGpuScope::~VulkEngGpuScope() { profiler.endScope(commandBuffer, scope); }
+
+} // namespace VulkanEngine
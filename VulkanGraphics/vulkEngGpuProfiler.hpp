@@ -0,0 +1,134 @@
+#pragma once
+
+#include "vulkEngDevice.hpp"
+
+//std
+#include <string>
+#include <vector>
+
+namespace VulkanEngine {
+
+	struct GpuPipelineStatistics {
+		uint64_t inputAssemblyVertices = 0;
+		uint64_t inputAssemblyPrimitives = 0;
+		uint64_t vertexShaderInvocations = 0;
+		uint64_t clippingInvocations = 0;
+		uint64_t clippingPrimitives = 0;
+		uint64_t fragmentShaderInvocations = 0;
+	};
+
+	struct GpuScopeResult {
+		std::string name;
+		uint32_t depth;
+		double milliseconds;
+		bool hasStatistics;
+		GpuPipelineStatistics statistics;
+		// pixels the scope rendered to, 0 when not given to beginScope
+		uint64_t pixelCount;
+
+		// fragment shader invocations per pixel rendered, 0 without statistics or a pixel count
+		double overdraw() const {
+			return hasStatistics && pixelCount > 0 ? static_cast<double>(statistics.fragmentShaderInvocations) / pixelCount : 0.0;
+		}
+	};
+
+	// Query pool based GPU profiler. Every frame slot owns its own pools; they are read back when
+	// the slot is reused, after its fence has been waited on, so reading results never stalls.
+	class VulkEngGpuProfiler {
+
+	public:
+		static constexpr uint32_t MAX_SCOPES = 64;
+		static constexpr uint32_t INVALID_SCOPE = ~0u;
+
+		VulkEngGpuProfiler(VulkEngDevice& device, uint32_t frameCount);
+		~VulkEngGpuProfiler();
+
+		VulkEngGpuProfiler(const VulkEngGpuProfiler&) = delete;
+		VulkEngGpuProfiler& operator=(const VulkEngGpuProfiler&) = delete;
+
+		bool isEnabled() const { return timestampsSupported; }
+		bool supportsPipelineStatistics() const { return statisticsSupported; }
+
+		// Reads back what frameIndex recorded last time and resets its pools. Must be recorded
+		// outside a render pass, before any scope of the frame.
+		void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+		// Scopes may nest. A scope with statistics must not contain another one with statistics,
+		// and it must begin and end on the same side of a render pass boundary. name must outlive
+		// the frame; string literals are expected. pixelCount, the size of the attachments a rendering
+		// scope draws to, lets its overdraw be reported.
+		uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name, bool withStatistics = false, uint64_t pixelCount = 0);
+		void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+		// Scopes of the most recently read back frame, in the order they were opened.
+		const std::vector<GpuScopeResult>& getResults() const { return results; }
+
+		// Logs per-scope averages every interval frames; 0 disables logging.
+		void setLogInterval(uint32_t frames);
+
+	private:
+		struct Scope {
+			const char* name;
+			uint32_t depth;
+			uint32_t statisticsQuery;
+			bool open;
+			uint64_t pixelCount;
+		};
+
+		struct FrameQueries {
+			VkQueryPool timestamps = VK_NULL_HANDLE;
+			VkQueryPool statistics = VK_NULL_HANDLE;
+			std::vector<Scope> scopes;
+			uint32_t statisticsCount = 0;
+			bool recorded = false;
+		};
+
+		struct ScopeAverage {
+			std::string name;
+			uint32_t depth;
+			double totalMilliseconds;
+			uint32_t samples;
+			bool hasStatistics;
+			GpuPipelineStatistics totalStatistics;
+			uint64_t totalPixelCount;
+		};
+
+		void readBack(FrameQueries& frame);
+		void accumulate();
+		void logAverages();
+
+		VulkEngDevice& vulkanDevice;
+		std::vector<FrameQueries> frames;
+		uint32_t currentFrame = 0;
+		uint32_t openDepth = 0;
+		bool statisticsOpen = false;
+
+		bool timestampsSupported = false;
+		bool statisticsSupported = false;
+		double nanosecondsPerTick = 1.0;
+		uint64_t timestampMask = ~0ull;
+
+		std::vector<GpuScopeResult> results;
+
+		uint32_t logInterval = 0;
+		uint32_t framesSinceLog = 0;
+		std::vector<ScopeAverage> averages;
+	};
+
+	// Opens a scope for its own lifetime.
+	class VulkEngGpuScope {
+
+	public:
+		VulkEngGpuScope(VulkEngGpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name, bool withStatistics = false);
+		~VulkEngGpuScope();
+
+		VulkEngGpuScope(const VulkEngGpuScope&) = delete;
+		VulkEngGpuScope& operator=(const VulkEngGpuScope&) = delete;
+
+	private:
+		VulkEngGpuProfiler& profiler;
+		VkCommandBuffer commandBuffer;
+		uint32_t scope;
+	};
+
+} // namespace VulkanEngine
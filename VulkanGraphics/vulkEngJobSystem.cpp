@@ -0,0 +1,311 @@
+#include "vulkEngJobSystem.hpp"
+#include "vulkEngCpuProfiler.hpp"
+
+//std
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace VulkanEngine {
+
+	namespace {
+		// ranges per thread parallelFor aims for, so threads that finish early can steal the rest
+		constexpr uint32_t RANGES_PER_THREAD = 4;
+
+		// the job system the calling thread works for, and its index there
+		thread_local const VulkEngJobSystem* currentJobSystem = nullptr;
+		thread_local uint32_t currentThreadIndex = 0;
+	}
+
+	VulkEngJobSystem::VulkEngJobSystem(uint32_t workerCount) : mainThreadId{ std::this_thread::get_id() } {
+		if (workerCount == 0) {
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+		for (uint32_t i = 0; i <= workerCount; i++) {
+			queues.push_back(std::make_unique<Queue>());
+		}
+		currentJobSystem = this;
+		currentThreadIndex = 0;
+		for (uint32_t i = 1; i <= workerCount; i++) {
+			workers.emplace_back(&VulkEngJobSystem::workerLoop, this, i);
+		}
+	}
+
+	VulkEngJobSystem::~VulkEngJobSystem() {
+		{
+			std::lock_guard<std::mutex> lock{ sleepMutex };
+			stopping = true;
+		}
+		workAvailable.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+		if (currentJobSystem == this) {
+			currentJobSystem = nullptr;
+		}
+	}
+
+	uint32_t VulkEngJobSystem::getThreadIndex() const {
+		return currentJobSystem == this ? currentThreadIndex : 0;
+	}
+
+	void VulkEngJobSystem::schedule(const char* name, std::function<void()> job, JobCounter* signal, JobAffinity affinity) {
+		if (signal != nullptr) {
+			signal->pending.fetch_add(1, std::memory_order_relaxed);
+		}
+		push({ name, std::move(job), signal }, affinity);
+	}
+
+	void VulkEngJobSystem::scheduleAfter(
+		JobCounter& dependency,
+		const char* name,
+		std::function<void()> job,
+		JobCounter* signal,
+		JobAffinity affinity
+	) {
+		if (signal != nullptr) {
+			signal->pending.fetch_add(1, std::memory_order_relaxed);
+		}
+		{
+			// finish takes the continuations under the same lock, so none is left behind
+			std::lock_guard<std::mutex> lock{ dependency.mutex };
+			if (dependency.pending.load(std::memory_order_acquire) != 0) {
+				dependency.continuations.push_back({ name, std::move(job), signal, affinity });
+				return;
+			}
+		}
+		push({ name, std::move(job), signal }, affinity);
+	}
+
+	void VulkEngJobSystem::wait(JobCounter& counter) {
+		VulkEngCpuScope scope{ "waitForJobs" };
+		uint32_t threadIndex = getThreadIndex();
+		bool mainThread = std::this_thread::get_id() == mainThreadId;
+		while (!counter.isDone()) {
+			if (tryRunJob(threadIndex)) {
+				continue;
+			}
+			// what is left is running on other threads; sleep until it finishes or it queues more
+			std::unique_lock<std::mutex> lock{ sleepMutex };
+			workAvailable.wait(lock, [this, &counter, mainThread]() {
+				return counter.isDone()
+					|| queuedJobs.load(std::memory_order_acquire) != 0
+					|| (mainThread && hasMainThreadJobs());
+			});
+		}
+
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock{ counter.mutex };
+			std::swap(error, counter.error);
+		}
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	void VulkEngJobSystem::parallelFor(
+		const char* name,
+		uint32_t count,
+		uint32_t grainSize,
+		const std::function<void(uint32_t begin, uint32_t end)>& body
+	) {
+		if (count == 0) return;
+		if (grainSize == 0) {
+			grainSize = std::max(1u, count / (getThreadCount() * RANGES_PER_THREAD));
+		}
+
+		JobCounter counter;
+		// the first range runs on the calling thread, which would otherwise only wait
+		for (uint32_t begin = grainSize; begin < count; begin += grainSize) {
+			uint32_t end = std::min(count, begin + grainSize);
+			schedule(name, [&body, begin, end]() { body(begin, end); }, &counter);
+		}
+		{
+			VulkEngCpuScope scope{ name };
+			try {
+				body(0, std::min(count, grainSize));
+			}
+			catch (...) {
+				// the other ranges still refer to body
+				wait(counter);
+				throw;
+			}
+		}
+		wait(counter);
+	}
+
+	void VulkEngJobSystem::runMainThreadJobs() {
+		Job job;
+		while (popMainThreadJob(job)) {
+			execute(job, 0);
+		}
+	}
+
+	void VulkEngJobSystem::push(Job job, JobAffinity affinity) {
+		if (affinity == JobAffinity::MainThread) {
+			{
+				std::lock_guard<std::mutex> lock{ mainThreadQueue.mutex };
+				mainThreadQueue.jobs.push_back(std::move(job));
+			}
+			// only the main thread can run it, and it may be asleep in wait behind any of the workers
+			wakeSleepers(true);
+			return;
+		}
+
+		// threads outside the job system spread their jobs over the workers' queues
+		uint32_t queueIndex = currentJobSystem == this
+			? currentThreadIndex
+			: nextExternalQueue.fetch_add(1, std::memory_order_relaxed) % getThreadCount();
+		{
+			std::lock_guard<std::mutex> lock{ queues[queueIndex]->mutex };
+			queues[queueIndex]->jobs.push_back(std::move(job));
+		}
+		queuedJobs.fetch_add(1, std::memory_order_release);
+		wakeSleepers(false);
+	}
+
+	void VulkEngJobSystem::wakeSleepers(bool all) {
+		{
+			// taken so a thread between checking for work and sleeping does not miss the notification
+			std::lock_guard<std::mutex> lock{ sleepMutex };
+		}
+		if (all) {
+			workAvailable.notify_all();
+		}
+		else {
+			workAvailable.notify_one();
+		}
+	}
+
+	bool VulkEngJobSystem::tryRunJob(uint32_t threadIndex) {
+		Job job;
+		bool found = (std::this_thread::get_id() == mainThreadId && popMainThreadJob(job)) || popOrSteal(threadIndex, job);
+		if (!found) {
+			return false;
+		}
+		execute(job, threadIndex);
+		return true;
+	}
+
+	bool VulkEngJobSystem::popOrSteal(uint32_t threadIndex, Job& job) {
+		if (queuedJobs.load(std::memory_order_acquire) == 0) {
+			return false;
+		}
+
+		// newest first from the own queue, while its data is likely still in cache
+		{
+			Queue& own = *queues[threadIndex];
+			std::lock_guard<std::mutex> lock{ own.mutex };
+			if (!own.jobs.empty()) {
+				job = std::move(own.jobs.back());
+				own.jobs.pop_back();
+				queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		// oldest first from the others, which tend to be the largest pieces of work left
+		uint32_t threadCount = getThreadCount();
+		for (uint32_t offset = 1; offset < threadCount; offset++) {
+			Queue& victim = *queues[(threadIndex + offset) % threadCount];
+			std::lock_guard<std::mutex> lock{ victim.mutex };
+			if (!victim.jobs.empty()) {
+				job = std::move(victim.jobs.front());
+				victim.jobs.pop_front();
+				queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool VulkEngJobSystem::popMainThreadJob(Job& job) {
+		std::lock_guard<std::mutex> lock{ mainThreadQueue.mutex };
+		if (mainThreadQueue.jobs.empty()) {
+			return false;
+		}
+		job = std::move(mainThreadQueue.jobs.front());
+		mainThreadQueue.jobs.pop_front();
+		return true;
+	}
+
+	bool VulkEngJobSystem::hasMainThreadJobs() {
+		std::lock_guard<std::mutex> lock{ mainThreadQueue.mutex };
+		return !mainThreadQueue.jobs.empty();
+	}
+
+	void VulkEngJobSystem::execute(Job& job, uint32_t threadIndex) {
+		bool profiling = jobHook || VulkEngCpuProfiler::isCapturing();
+		int64_t start = profiling ? VulkEngCpuProfiler::now() : 0;
+		std::exception_ptr error;
+		try {
+			job.function();
+		}
+		catch (const std::exception& e) {
+			// nothing waits for a job without a counter to rethrow it
+			if (job.signal == nullptr) {
+				std::cerr << "job " << job.name << " failed: " << e.what() << std::endl;
+			}
+			error = std::current_exception();
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		if (profiling) {
+			int64_t end = VulkEngCpuProfiler::now();
+			if (VulkEngCpuProfiler::isCapturing()) {
+				VulkEngCpuProfiler::record(job.name, start, end);
+			}
+			if (jobHook) {
+				jobHook(job.name, threadIndex, start, end);
+			}
+		}
+
+		if (job.signal != nullptr) {
+			if (error) {
+				std::lock_guard<std::mutex> lock{ job.signal->mutex };
+				if (!job.signal->error) {
+					job.signal->error = error;
+				}
+			}
+			finish(*job.signal);
+		}
+	}
+
+	void VulkEngJobSystem::finish(JobCounter& counter) {
+		std::vector<JobCounter::Continuation> continuations;
+		{
+			std::lock_guard<std::mutex> lock{ counter.mutex };
+			if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+				return;
+			}
+			continuations.swap(counter.continuations);
+		}
+		// the counter may be gone from here on, its waiter having returned
+		for (JobCounter::Continuation& continuation : continuations) {
+			push({ continuation.name, std::move(continuation.function), continuation.signal }, continuation.affinity);
+		}
+		// whichever threads wait for the counter; workers wake too, but go back to sleep
+		wakeSleepers(true);
+	}
+
+	void VulkEngJobSystem::workerLoop(uint32_t threadIndex) {
+		currentJobSystem = this;
+		currentThreadIndex = threadIndex;
+		std::string threadName = "job worker " + std::to_string(threadIndex);
+		VulkEngCpuProfiler::setThreadName(threadName.c_str());
+
+		while (true) {
+			if (tryRunJob(threadIndex)) {
+				continue;
+			}
+			std::unique_lock<std::mutex> lock{ sleepMutex };
+			workAvailable.wait(lock, [this]() {
+				return stopping || queuedJobs.load(std::memory_order_acquire) != 0;
+			});
+			if (stopping) return;
+		}
+	}
+
+} // namespace VulkanEngine
@@ -0,0 +1,155 @@
+#pragma once
+
+//std
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VulkanEngine {
+
+	enum class JobAffinity {
+		// any thread of the job system, including the main thread while it waits
+		Any,
+		// only the thread that created the job system, for APIs such as GLFW that must be called there
+		MainThread
+	};
+
+	// Counts the jobs signalling it that have not finished yet. Jobs can be scheduled to start once
+	// a counter reaches zero; no jobs may be added to a counter after that point while such jobs
+	// depend on it. Must outlive the jobs signalling it.
+	class JobCounter {
+
+	public:
+		JobCounter() = default;
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class VulkEngJobSystem;
+
+		struct Continuation {
+			const char* name;
+			std::function<void()> function;
+			JobCounter* signal;
+			JobAffinity affinity;
+		};
+
+		std::atomic<uint32_t> pending{ 0 };
+		std::mutex mutex;
+		std::vector<Continuation> continuations;
+		// the first exception a job signalling this counter threw, rethrown by wait
+		std::exception_ptr error;
+	};
+
+	// A work stealing scheduler: every thread owns a deque of jobs, pushing and popping at its back,
+	// and idle threads steal from the front of the others'. The thread that creates the job system is
+	// thread 0 and runs jobs only while it waits, so waiting never wastes it.
+	//
+	// Jobs are named for the CPU trace (see VulkEngCpuProfiler); names must be string literals.
+	class VulkEngJobSystem {
+
+	public:
+		// Called after every job with its name, the index of the thread that ran it and its start and
+		// end in VulkEngCpuProfiler::now time.
+		using JobHook = std::function<void(const char* name, uint32_t threadIndex, int64_t start, int64_t end)>;
+
+		// parallelFor grain for cheap per-object work, such as a transform each; smaller ranges would
+		// cost more in scheduling than they save
+		static constexpr uint32_t DEFAULT_GRAIN_SIZE = 64;
+
+		// workerCount threads besides the calling one; 0 uses one per remaining hardware thread
+		VulkEngJobSystem(uint32_t workerCount = 0);
+		~VulkEngJobSystem();
+
+		VulkEngJobSystem(const VulkEngJobSystem&) = delete;
+		VulkEngJobSystem& operator=(const VulkEngJobSystem&) = delete;
+
+		// the workers and the main thread
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(queues.size()); }
+		// of the calling thread, 0 on the main thread and on threads outside the job system
+		uint32_t getThreadIndex() const;
+
+		// May be called from any thread, including from jobs. signal, if given, counts the job until it
+		// has finished; exceptions from jobs without one are reported to std::cerr.
+		void schedule(
+			const char* name,
+			std::function<void()> job,
+			JobCounter* signal = nullptr,
+			JobAffinity affinity = JobAffinity::Any);
+		// Starts the job once every job signalling dependency has finished.
+		void scheduleAfter(
+			JobCounter& dependency,
+			const char* name,
+			std::function<void()> job,
+			JobCounter* signal = nullptr,
+			JobAffinity affinity = JobAffinity::Any);
+
+		// Runs other jobs until counter reaches zero, sleeping while none can be run here, then
+		// rethrows the first exception a job signalling it threw. On the main thread this includes
+		// MainThread jobs.
+		void wait(JobCounter& counter);
+
+		// Calls body over [0, count) split into ranges of about grainSize, on every thread, and
+		// returns once all of them have finished. grainSize 0 splits the range evenly over the
+		// threads, a few ranges each.
+		void parallelFor(
+			const char* name,
+			uint32_t count,
+			uint32_t grainSize,
+			const std::function<void(uint32_t begin, uint32_t end)>& body);
+
+		// Runs the MainThread jobs queued so far; call from the main loop.
+		void runMainThreadJobs();
+
+		// Set before scheduling any jobs.
+		void setJobHook(JobHook hook) { jobHook = std::move(hook); }
+
+	private:
+		struct Job {
+			const char* name;
+			std::function<void()> function;
+			JobCounter* signal;
+		};
+
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		void push(Job job, JobAffinity affinity);
+		bool tryRunJob(uint32_t threadIndex);
+		bool popOrSteal(uint32_t threadIndex, Job& job);
+		bool popMainThreadJob(Job& job);
+		bool hasMainThreadJobs();
+		void wakeSleepers(bool all);
+		void execute(Job& job, uint32_t threadIndex);
+		void finish(JobCounter& counter);
+		void workerLoop(uint32_t threadIndex);
+
+		// one per thread, index 0 being the main thread's
+		std::vector<std::unique_ptr<Queue>> queues;
+		Queue mainThreadQueue;
+		std::thread::id mainThreadId;
+		JobHook jobHook;
+
+		// jobs in queues, so idle workers know when to look for more
+		std::atomic<uint32_t> queuedJobs{ 0 };
+		// where threads outside the job system push their jobs, in turn
+		std::atomic<uint32_t> nextExternalQueue{ 0 };
+		std::mutex sleepMutex;
+		// notified when jobs are queued and when a counter reaches zero, for threads in wait
+		std::condition_variable workAvailable;
+		bool stopping = false;
+		std::vector<std::thread> workers;
+	};
+
+} // namespace VulkanEngine
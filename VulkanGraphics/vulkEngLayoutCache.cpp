@@ -0,0 +1,160 @@
+#include "vulkEngLayoutCache.hpp"
+
+//std
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace VulkanEngine {
+
+	VulkEngLayoutCache::VulkEngLayoutCache(VkDevice device) : device{ device } {}
+
+	VulkEngLayoutCache::~VulkEngLayoutCache() {
+		for (auto& [key, layout] : pipelineLayouts) {
+			vkDestroyPipelineLayout(device, layout, nullptr);
+		}
+		for (auto& [key, layout] : setLayouts) {
+			vkDestroyDescriptorSetLayout(device, layout, nullptr);
+		}
+	}
+
+	VkDescriptorSetLayout VulkEngLayoutCache::getDescriptorSetLayout(
+		const std::vector<VkDescriptorSetLayoutBinding>& bindings
+	) {
+		std::vector<VkDescriptorSetLayoutBinding> sorted = bindings;
+		std::sort(sorted.begin(), sorted.end(),
+			[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+		std::vector<uint32_t> key;
+		for (const auto& binding : sorted) {
+			if (binding.pImmutableSamplers != nullptr) {
+				throw std::runtime_error("failed to cache descriptor set layout: immutable samplers are not supported!");
+			}
+			key.insert(key.end(), {
+				binding.binding,
+				static_cast<uint32_t>(binding.descriptorType),
+				binding.descriptorCount,
+				static_cast<uint32_t>(binding.stageFlags) });
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto cached = setLayouts.find(key);
+		if (cached != setLayouts.end()) {
+			return cached->second;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(sorted.size());
+		layoutInfo.pBindings = sorted.data();
+
+		VkDescriptorSetLayout layout;
+		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+		setLayouts.emplace(std::move(key), layout);
+		return layout;
+	}
+
+	VkPipelineLayout VulkEngLayoutCache::getPipelineLayout(
+		const std::vector<VkDescriptorSetLayout>& setLayoutHandles,
+		const std::vector<VkPushConstantRange>& pushConstantRanges
+	) {
+		// handles from this cache are unique per description, so they can stand in for it
+		std::vector<uint32_t> key;
+		key.push_back(static_cast<uint32_t>(setLayoutHandles.size()));
+		for (VkDescriptorSetLayout layout : setLayoutHandles) {
+			uint64_t handle = reinterpret_cast<uint64_t>(layout);
+			key.insert(key.end(), { static_cast<uint32_t>(handle), static_cast<uint32_t>(handle >> 32) });
+		}
+		for (const auto& range : pushConstantRanges) {
+			key.insert(key.end(), { static_cast<uint32_t>(range.stageFlags), range.offset, range.size });
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto cached = pipelineLayouts.find(key);
+		if (cached != pipelineLayouts.end()) {
+			return cached->second;
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayoutHandles.size());
+		pipelineLayoutInfo.pSetLayouts = setLayoutHandles.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+		VkPipelineLayout layout;
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+		pipelineLayouts.emplace(std::move(key), layout);
+		return layout;
+	}
+
+	ReflectedLayout VulkEngLayoutCache::getReflectedLayout(
+		const std::vector<const ShaderReflection*>& stages,
+		uint32_t pushConstantSize
+	) {
+		ReflectedLayout result{};
+
+		std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+		uint32_t pushConstantEnd = 0;
+		for (const ShaderReflection* stage : stages) {
+			for (const auto& reflected : stage->descriptorBindings) {
+				if (sets.size() <= reflected.set) sets.resize(reflected.set + 1);
+				auto& bindings = sets[reflected.set];
+				auto existing = std::find_if(bindings.begin(), bindings.end(),
+					[&](const VkDescriptorSetLayoutBinding& b) { return b.binding == reflected.binding; });
+				if (existing == bindings.end()) {
+					VkDescriptorSetLayoutBinding binding{};
+					binding.binding = reflected.binding;
+					binding.descriptorType = reflected.type;
+					binding.descriptorCount = reflected.count;
+					binding.stageFlags = stage->stage;
+					bindings.push_back(binding);
+				}
+				else if (existing->descriptorType != reflected.type || existing->descriptorCount != reflected.count) {
+					throw std::runtime_error(
+						"shader stages disagree on descriptor set " + std::to_string(reflected.set) +
+						" binding " + std::to_string(reflected.binding) + "!");
+				}
+				else {
+					existing->stageFlags |= stage->stage;
+				}
+			}
+
+			if (stage->pushConstantSize > 0) {
+				result.pushConstantStages |= stage->stage;
+				pushConstantEnd = std::max(pushConstantEnd, stage->pushConstantOffset + stage->pushConstantSize);
+			}
+		}
+
+		if (pushConstantEnd > pushConstantSize) {
+			throw std::runtime_error(
+				"shader push constant block needs " + std::to_string(pushConstantEnd) +
+				" bytes but the C++ push constant data is " + std::to_string(pushConstantSize) + "!");
+		}
+		if (pushConstantSize > 0 && result.pushConstantStages == 0) {
+			throw std::runtime_error("push constant data provided but no shader stage declares a push constant block!");
+		}
+
+		for (const auto& bindings : sets) {
+			result.setLayouts.push_back(getDescriptorSetLayout(bindings));
+		}
+
+		// one range over the whole C++ struct, so it can be pushed with a single call
+		std::vector<VkPushConstantRange> ranges;
+		if (pushConstantSize > 0) {
+			VkPushConstantRange range{};
+			range.stageFlags = result.pushConstantStages;
+			range.offset = 0;
+			range.size = pushConstantSize;
+			ranges.push_back(range);
+		}
+		result.pushConstantSize = pushConstantSize;
+		result.pipelineLayout = getPipelineLayout(result.setLayouts, ranges);
+		return result;
+	}
+
+} // namespace VulkanEngine
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "vulkEngShaderReflection.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+//std
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace VulkanEngine {
+
+	// A pipeline layout derived from the shader stages of one pipeline, plus what the C++ side needs
+	// to use it: the set layouts for allocating descriptor sets and the stages to push constants to.
+	struct ReflectedLayout {
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSetLayout> setLayouts;
+		VkShaderStageFlags pushConstantStages = 0;
+		uint32_t pushConstantSize = 0;
+	};
+
+	// Device-level cache of descriptor set and pipeline layouts. Identical descriptions share one
+	// handle, so pipelines built from compatible shaders can bind each other's descriptor sets.
+	// Layouts live as long as the cache. Safe to use from any thread.
+	class VulkEngLayoutCache {
+
+	public:
+		explicit VulkEngLayoutCache(VkDevice device);
+		~VulkEngLayoutCache();
+
+		VulkEngLayoutCache(const VulkEngLayoutCache&) = delete;
+		VulkEngLayoutCache& operator=(const VulkEngLayoutCache&) = delete;
+
+		VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+		VkPipelineLayout getPipelineLayout(
+			const std::vector<VkDescriptorSetLayout>& setLayouts,
+			const std::vector<VkPushConstantRange>& pushConstantRanges);
+
+		// Merges the interfaces of the given stages into one layout. pushConstantSize is
+		// sizeof the C++ push constant struct (0 if none); it must cover every push constant block
+		// the shaders declare, and the stages must agree on the type of every shared binding.
+		ReflectedLayout getReflectedLayout(const std::vector<const ShaderReflection*>& stages, uint32_t pushConstantSize);
+
+	private:
+		VkDevice device;
+		std::mutex mutex;
+		std::map<std::vector<uint32_t>, VkDescriptorSetLayout> setLayouts;
+		std::map<std::vector<uint32_t>, VkPipelineLayout> pipelineLayouts;
+	};
+
+} // namespace VulkanEngine
@@ -0,0 +1,79 @@
+#include "vulkEngMappedFile.hpp"
+
+//std
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VulkanEngine {
+
+#ifdef _WIN32
+
+	VulkEngMappedFile::VulkEngMappedFile(const std::string& filepath) {
+		HANDLE file = CreateFileA(
+			filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			CloseHandle(file);
+			throw std::runtime_error("failed to map empty file: " + filepath);
+		}
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (view == nullptr) {
+			if (mapping) CloseHandle(mapping);
+			CloseHandle(file);
+			throw std::runtime_error("failed to map file: " + filepath);
+		}
+		fileHandle = file;
+		mappingHandle = mapping;
+		mappedData = view;
+		mappedSize = static_cast<size_t>(fileSize.QuadPart);
+	}
+
+	VulkEngMappedFile::~VulkEngMappedFile() {
+		UnmapViewOfFile(mappedData);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+	}
+
+#else
+
+	VulkEngMappedFile::VulkEngMappedFile(const std::string& filepath) {
+		int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+		struct stat fileStat{};
+		if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+			close(fd);
+			throw std::runtime_error("failed to map empty file: " + filepath);
+		}
+		void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		// the mapping keeps its own reference to the file
+		close(fd);
+		if (view == MAP_FAILED) {
+			throw std::runtime_error("failed to map file: " + filepath);
+		}
+		mappedData = view;
+		mappedSize = static_cast<size_t>(fileStat.st_size);
+	}
+
+	VulkEngMappedFile::~VulkEngMappedFile() {
+		munmap(const_cast<void*>(mappedData), mappedSize);
+	}
+
+#endif
+
+} // namespace VulkanEngine
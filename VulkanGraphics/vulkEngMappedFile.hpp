@@ -0,0 +1,32 @@
+#pragma once
+
+//std
+#include <cstddef>
+#include <string>
+
+namespace VulkanEngine {
+
+	// Read-only memory mapping of a whole file. The mapping is page aligned, so its contents can be
+	// handed to Vulkan as SPIR-V words without copying. Throws if the file cannot be opened or is empty.
+	class VulkEngMappedFile {
+
+	public:
+		explicit VulkEngMappedFile(const std::string& filepath);
+		~VulkEngMappedFile();
+
+		VulkEngMappedFile(const VulkEngMappedFile&) = delete;
+		VulkEngMappedFile& operator=(const VulkEngMappedFile&) = delete;
+
+		const void* data() const { return mappedData; }
+		size_t size() const { return mappedSize; }
+
+	private:
+		const void* mappedData = nullptr;
+		size_t mappedSize = 0;
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+	};
+
+} // namespace VulkanEngine
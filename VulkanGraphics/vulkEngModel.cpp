@@ -5,15 +5,24 @@
 
 namespace VulkanEngine
 {
-	VulkEngModel::VulkEngModel(VulkEngDevice &device, const std::vector<Vertex> &vertices)
+	VulkEngModel::VulkEngModel(VulkEngDevice &device, const std::vector<Vertex> &vertices, bool positionStream)
 		: vulkanDevice{ device }
 	{
-		createVertexBuffers(vertices);
+		VulkEngUploadBatch batch{ device };
+		createVertexBuffers(batch, vertices, positionStream);
+		device.waitForUpload(batch.submit());
+	}
+	VulkEngModel::VulkEngModel(VulkEngDevice &device, VulkEngUploadBatch &batch, const std::vector<Vertex> &vertices, bool positionStream)
+		: vulkanDevice{ device }
+	{
+		createVertexBuffers(batch, vertices, positionStream);
 	}
 	VulkEngModel::~VulkEngModel()
 	{
-		vkDestroyBuffer(vulkanDevice.device(), vertexBuffer, nullptr);
-		vkFreeMemory(vulkanDevice.device(), vertexBufferMemory, nullptr);
+		vulkanDevice.destroyBufferDeferred(vertexBuffer, vertexBufferMemory);
+		if (hasPositionStream()) {
+			vulkanDevice.destroyBufferDeferred(positionBuffer, positionBufferMemory);
+		}
 	}
 	void VulkEngModel::bind(VkCommandBuffer commandBuffer)
 	{
@@ -21,26 +30,53 @@ namespace VulkanEngine
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
 	}
+	void VulkEngModel::bindPositions(VkCommandBuffer commandBuffer)
+	{
+		assert(hasPositionStream() && "Cannot bind positions of a model created without a position stream");
+		VkBuffer buffers[] = { positionBuffer };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+	}
 	void VulkEngModel::draw(VkCommandBuffer commandBuffer)
 	{
 		vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
 	}
-	void VulkEngModel::createVertexBuffers(const std::vector<Vertex> &vertices)
+	void VulkEngModel::createVertexBuffers(VulkEngUploadBatch &batch, const std::vector<Vertex> &vertices, bool positionStream)
 	{
 		vertexCount = static_cast<uint32_t>(vertices.size());
 		assert(vertexCount >= 3 && "Vertex count must be at least 3");
 		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
 		vulkanDevice.createBuffer(
 			bufferSize,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			vertexBuffer,
 			vertexBufferMemory
 		);
-		void* data;
-		vkMapMemory(vulkanDevice.device(), vertexBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-		vkUnmapMemory(vulkanDevice.device(), vertexBufferMemory);
+		batch.uploadBuffer(vertices.data(), bufferSize, vertexBuffer);
+
+		boundsMin = boundsMax = vertices[0].position;
+		for (const Vertex& vertex : vertices) {
+			boundsMin = glm::min(boundsMin, vertex.position);
+			boundsMax = glm::max(boundsMax, vertex.position);
+		}
+		if (!positionStream) {
+			return;
+		}
+
+		std::vector<glm::vec3> positions(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			positions[i] = vertices[i].position;
+		}
+		VkDeviceSize positionsSize = sizeof(positions[0]) * vertexCount;
+		vulkanDevice.createBuffer(
+			positionsSize,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			positionBuffer,
+			positionBufferMemory
+		);
+		batch.uploadBuffer(positions.data(), positionsSize, positionBuffer);
 	}
 
 	std::vector<VkVertexInputBindingDescription> VulkEngModel::Vertex::getBindingDescriptions() {
@@ -64,4 +100,21 @@ namespace VulkanEngine
 		attributeDescriptions[1].offset = offsetof(Vertex, color);
 		return attributeDescriptions;
 	}
+
+	std::vector<VkVertexInputBindingDescription> VulkEngModel::Vertex::getPositionBindingDescriptions() {
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		bindingDescriptions[0].binding = 0;
+		bindingDescriptions[0].stride = sizeof(glm::vec3);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> VulkEngModel::Vertex::getPositionAttributeDescriptions() {
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(1);
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[0].offset = 0;
+		return attributeDescriptions;
+	}
 } // namespace VulkanEngine
\ No newline at end of file
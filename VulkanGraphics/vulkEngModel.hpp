@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vulkEngDevice.hpp"
+#include "vulkEngUploadBatch.hpp"
 
 // lib
 #define GLM_FORCE_RADIANS
@@ -22,26 +23,49 @@ namespace VulkanEngine
 
 			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
 			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+			// the position only stream bound by bindPositions, for depth only passes
+			static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions();
+			static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions();
 		};
 
-		VulkEngModel(VulkEngDevice &device, const std::vector<Vertex> &vertices);
+		// positionStream also builds the position only buffer bindPositions binds, needed only by
+		// depth only passes.
+		VulkEngModel(VulkEngDevice &device, const std::vector<Vertex> &vertices, bool positionStream = false);
+		// Records the vertex upload into batch; the model must not be drawn before the batch completes.
+		VulkEngModel(VulkEngDevice &device, VulkEngUploadBatch &batch, const std::vector<Vertex> &vertices, bool positionStream = false);
 		~VulkEngModel();
 
 		VulkEngModel(const VulkEngModel&) = delete;
 		VulkEngModel& operator=(const VulkEngModel&) = delete;
 
 		void bind(VkCommandBuffer commandBuffer);
+		// Binds tightly packed positions instead of whole vertices, fetching less per vertex. Only for
+		// models created with positionStream.
+		void bindPositions(VkCommandBuffer commandBuffer);
 		void draw(VkCommandBuffer commandBuffer);
+		uint32_t getVertexCount() const { return vertexCount; }
+		bool hasPositionStream() const { return positionBuffer != VK_NULL_HANDLE; }
+		// axis aligned bounds of the vertex positions
+		glm::vec3 getBoundsMin() const { return boundsMin; }
+		glm::vec3 getBoundsMax() const { return boundsMax; }
+		// bytes of the vertex and position buffers
+		VkDeviceSize getMemorySize() const {
+			return static_cast<VkDeviceSize>(vertexCount) * (sizeof(Vertex) + (hasPositionStream() ? sizeof(glm::vec3) : 0));
+		}
 
 
 	private:
 
-		void createVertexBuffers(const std::vector<Vertex> &vertices);
+		void createVertexBuffers(VulkEngUploadBatch &batch, const std::vector<Vertex> &vertices, bool positionStream);
 		
 		VulkEngDevice& vulkanDevice;
 		VkBuffer vertexBuffer;
 		VkDeviceMemory vertexBufferMemory;
+		VkBuffer positionBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory positionBufferMemory = VK_NULL_HANDLE;
 		uint32_t vertexCount;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
 	};
 
 } // namespace VulkanEngine
\ No newline at end of file
@@ -0,0 +1,512 @@
+#include "vulkEngOcclusionCulling.hpp"
+#include "vulkEngSwapChain.hpp"
+#include "vulkEngCpuProfiler.hpp"
+#include "vulkEngSamplerCache.hpp"
+
+//std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace VulkanEngine {
+
+	namespace {
+		constexpr const char* CULL_SHADER_PATH = "shaders/occlusionCull.comp.spv";
+		constexpr const char* PYRAMID_SHADER_PATH = "shaders/depthPyramid.comp.spv";
+		constexpr const char* VERT_SHADER_PATH = "shaders/culledShader.vert.spv";
+		constexpr const char* FRAG_SHADER_PATH = "shaders/simpleShader.frag.spv";
+
+		constexpr uint32_t CULL_GROUP_SIZE = 64;
+		constexpr uint32_t PYRAMID_GROUP_SIZE = 8;
+		constexpr VkFormat PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+
+		struct CullPushConstants {
+			uint32_t objectCount;
+			uint32_t phase;
+			uint32_t drawOffset;
+			uint32_t levelCount;
+		};
+
+		struct PyramidPushConstants {
+			int32_t sourceSize[2];
+			int32_t destinationSize[2];
+			int32_t sourceLevel;
+		};
+
+		void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+			VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = dstAccess;
+			vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+	}
+
+	VulkEngOcclusionCulling::VulkEngOcclusionCulling(VulkEngDevice& device) : vulkanDevice{ device } {
+		if (!isSupported(device)) {
+			throw std::runtime_error("occlusion culling needs the drawIndirectFirstInstance feature!");
+		}
+		cullPipeline = std::make_unique<VulkEngComputePipeline>(vulkanDevice, CULL_SHADER_PATH, sizeof(CullPushConstants));
+		pyramidPipeline = std::make_unique<VulkEngComputePipeline>(vulkanDevice, PYRAMID_SHADER_PATH, sizeof(PyramidPushConstants));
+
+		// simpleShader.frag declares, without using, the render system's push constant block
+		auto vertShader = vulkanDevice.shaderCache().loadModule(VERT_SHADER_PATH);
+		auto fragShader = vulkanDevice.shaderCache().loadModule(FRAG_SHADER_PATH);
+		const ShaderReflection& fragReflection = fragShader->getReflection();
+		drawLayout = vulkanDevice.layoutCache().getReflectedLayout(
+			{ &vertShader->getReflection(), &fragReflection },
+			fragReflection.pushConstantOffset + fragReflection.pushConstantSize);
+
+		createSampler();
+		createDescriptorSets();
+	}
+
+	VulkEngOcclusionCulling::~VulkEngOcclusionCulling() {
+		destroyPyramid();
+		VkDevice device = vulkanDevice.device();
+		for (auto& frame : frames) {
+			if (frame.objectBuffer != VK_NULL_HANDLE) {
+				vkUnmapMemory(device, frame.objectMemory);
+				vulkanDevice.destroyBufferDeferred(frame.objectBuffer, frame.objectMemory);
+			}
+		}
+		if (drawBuffer != VK_NULL_HANDLE) {
+			vulkanDevice.destroyBufferDeferred(drawBuffer, drawMemory);
+			vulkanDevice.destroyBufferDeferred(visibilityBuffer, visibilityMemory);
+		}
+		VkDescriptorPool pool = descriptorPool;
+		vulkanDevice.deferDestruction([device, pool]() {
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		});
+	}
+
+	void VulkEngOcclusionCulling::createSampler() {
+		// only read with texelFetch; the sampler is required by the descriptor type
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		sampler = vulkanDevice.samplerCache().getSampler(samplerInfo);
+	}
+
+	void VulkEngOcclusionCulling::createDescriptorSets() {
+		const uint32_t frameCount = VulkEngSwapChain::MAX_FRAMES_IN_FLIGHT;
+		// per frame: objects, draws and visibility for culling, objects for drawing, and a source and
+		// destination per pyramid level, plus the pyramid for culling
+		std::array<VkDescriptorPoolSize, 3> poolSizes{};
+		poolSizes[0] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * frameCount };
+		poolSizes[1] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, (MAX_PYRAMID_LEVELS + 1) * frameCount };
+		poolSizes[2] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_PYRAMID_LEVELS * frameCount };
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = (MAX_PYRAMID_LEVELS + 2) * frameCount;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		if (vkCreateDescriptorPool(vulkanDevice.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create occlusion culling descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> setLayouts{
+			cullPipeline->getDescriptorSetLayout(0),
+			drawLayout.setLayouts[0] };
+		setLayouts.insert(setLayouts.end(), MAX_PYRAMID_LEVELS, pyramidPipeline->getDescriptorSetLayout(0));
+
+		frames.resize(frameCount);
+		for (auto& frame : frames) {
+			std::vector<VkDescriptorSet> sets(setLayouts.size());
+			VkDescriptorSetAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			allocInfo.descriptorPool = descriptorPool;
+			allocInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
+			allocInfo.pSetLayouts = setLayouts.data();
+			if (vkAllocateDescriptorSets(vulkanDevice.device(), &allocInfo, sets.data()) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate occlusion culling descriptor sets!");
+			}
+			frame.cullSet = sets[0];
+			frame.drawSet = sets[1];
+			std::copy(sets.begin() + 2, sets.end(), frame.pyramidSets.begin());
+		}
+	}
+
+	void VulkEngOcclusionCulling::addPasses(
+		VulkEngRenderGraph& graph, RenderGraphImage color, RenderGraphImage depth, VkClearColorValue clearColor
+	) {
+		this->graph = &graph;
+		depthImage = depth;
+
+		// kept in GENERAL: written as a storage image, sampled with texelFetch everywhere else
+		RenderGraphImport import{};
+		import.format = PYRAMID_FORMAT;
+		import.initialLayout = VK_IMAGE_LAYOUT_GENERAL;
+		import.initialStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		import.finalLayout = VK_IMAGE_LAYOUT_GENERAL;
+		import.finalStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		import.finalAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		pyramidImage = graph.importImage("depth pyramid", import);
+
+		// the draw buffers are not tracked by the graph; cull records their barriers itself
+		graph.addPass("occlusion cull")
+			.readStorageImage(pyramidImage)
+			.setSideEffects()
+			.setExecute([this](VkCommandBuffer commandBuffer) { cull(commandBuffer, 0); });
+		earlyDrawPass = graph.addPass("occlusion early draw")
+			.writeColor(color, VK_ATTACHMENT_LOAD_OP_CLEAR, clearColor)
+			.writeDepth(depth, VK_ATTACHMENT_LOAD_OP_CLEAR)
+			.setExecute([this](VkCommandBuffer commandBuffer) { draw(commandBuffer, 0); })
+			.pass();
+		graph.addPass("depth pyramid")
+			.sampleImage(depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+			.writeStorageImage(pyramidImage)
+			.setExecute([this](VkCommandBuffer commandBuffer) { buildPyramid(commandBuffer); });
+		graph.addPass("occlusion recull")
+			.readStorageImage(pyramidImage)
+			.setSideEffects()
+			.setExecute([this](VkCommandBuffer commandBuffer) { cull(commandBuffer, 1); });
+		graph.addPass("occlusion late draw")
+			.writeColor(color, VK_ATTACHMENT_LOAD_OP_LOAD)
+			.writeDepth(depth, VK_ATTACHMENT_LOAD_OP_LOAD)
+			.setExecute([this](VkCommandBuffer commandBuffer) { draw(commandBuffer, 1); });
+	}
+
+	void VulkEngOcclusionCulling::createPipelines(VkCullModeFlags cullMode) {
+		assert(graph != nullptr && "Cannot create occlusion culling pipelines before addPasses");
+
+		// both draw passes use the same formats, so the pipelines suit the late draw as well
+		RenderTargetInfo renderTarget = graph->getRenderTarget(earlyDrawPass);
+		VkPipelineLayout layout = drawLayout.pipelineLayout;
+		pipelineVariants = std::make_unique<VulkEngPipelineVariants>(
+			vulkanDevice,
+			VERT_SHADER_PATH,
+			FRAG_SHADER_PATH,
+			[renderTarget, layout, cullMode](PipelineConfigInfo& pipelineConfig) {
+				VulkEngPipeline::defaultPipelineConfigInfo(pipelineConfig);
+				pipelineConfig.rasterizationInfo.cullMode = cullMode;
+				pipelineConfig.renderTarget = renderTarget;
+				pipelineConfig.pipelineLayout = layout;
+			}
+		);
+		drawPipeline = &pipelineVariants->get();
+	}
+
+	void VulkEngOcclusionCulling::prepareFrame(
+		VulkEngJobSystem& jobSystem,
+		uint32_t frameIndex,
+		VkExtent2D frameExtent,
+		const std::vector<VulkEngGameObj>& gameObjects
+	) {
+		VulkEngCpuScope scope{ "occlusion culling prepareFrame" };
+		assert(frameIndex < frames.size() && "Frame index out of range");
+		currentFrame = frameIndex;
+
+		reserveObjects(static_cast<uint32_t>(gameObjects.size()));
+		if (pyramid == VK_NULL_HANDLE || frameExtent.width != this->frameExtent.width || frameExtent.height != this->frameExtent.height) {
+			destroyPyramid();
+			createPyramid(frameExtent);
+		}
+		graph->setImportedImage(pyramidImage, pyramid, pyramidView);
+
+		FrameResources& frame = frames[currentFrame];
+		objectCount = static_cast<uint32_t>(gameObjects.size());
+		objectModels.resize(objectCount);
+		jobSystem.parallelFor("occlusion culling objects", objectCount, VulkEngJobSystem::DEFAULT_GRAIN_SIZE,
+			[this, &frame, &gameObjects](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++) {
+					const VulkEngGameObj& obj = gameObjects[i];
+					// mat4() is not const, it is computed from a copy
+					TransformComponent transform = obj.transform;
+					ObjectData& data = frame.objects[i];
+					data.transform = transform.mat4();
+					data.boundsMin = glm::vec4{ obj.model->getBoundsMin(), 0.0f };
+					data.boundsMax = glm::vec4{ obj.model->getBoundsMax(), 0.0f };
+					data.vertexCount = obj.model->getVertexCount();
+					objectModels[i] = obj.model.get();
+				}
+			});
+		writeDescriptorSets(frame);
+	}
+
+	void VulkEngOcclusionCulling::reserveObjects(uint32_t count) {
+		if (count <= capacity && drawBuffer != VK_NULL_HANDLE) {
+			return;
+		}
+		uint32_t newCapacity = std::max<uint32_t>(capacity, 64);
+		while (newCapacity < count) {
+			newCapacity *= 2;
+		}
+
+		// in-flight frames may still read the old buffers
+		VkDevice device = vulkanDevice.device();
+		for (auto& frame : frames) {
+			if (frame.objectBuffer != VK_NULL_HANDLE) {
+				vkUnmapMemory(device, frame.objectMemory);
+				vulkanDevice.destroyBufferDeferred(frame.objectBuffer, frame.objectMemory);
+			}
+			vulkanDevice.createBuffer(
+				sizeof(ObjectData) * newCapacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				frame.objectBuffer,
+				frame.objectMemory);
+			void* mapped;
+			vkMapMemory(device, frame.objectMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+			frame.objects = static_cast<ObjectData*>(mapped);
+		}
+		if (drawBuffer != VK_NULL_HANDLE) {
+			vulkanDevice.destroyBufferDeferred(drawBuffer, drawMemory);
+			vulkanDevice.destroyBufferDeferred(visibilityBuffer, visibilityMemory);
+		}
+		vulkanDevice.createBuffer(
+			sizeof(VkDrawIndirectCommand) * newCapacity * 2,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			drawBuffer,
+			drawMemory);
+		vulkanDevice.createBuffer(
+			sizeof(uint32_t) * newCapacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			visibilityBuffer,
+			visibilityMemory);
+		capacity = newCapacity;
+	}
+
+	void VulkEngOcclusionCulling::createPyramid(VkExtent2D frameExtent) {
+		this->frameExtent = frameExtent;
+
+		// the first level halves the depth buffer, rounding up, and so does every level after it
+		pyramidLevelExtents.clear();
+		VkExtent2D extent{ std::max(1u, (frameExtent.width + 1) / 2), std::max(1u, (frameExtent.height + 1) / 2) };
+		for (;;) {
+			pyramidLevelExtents.push_back(extent);
+			if ((extent.width == 1 && extent.height == 1) || pyramidLevelExtents.size() == MAX_PYRAMID_LEVELS) {
+				break;
+			}
+			extent = { std::max(1u, (extent.width + 1) / 2), std::max(1u, (extent.height + 1) / 2) };
+		}
+		uint32_t levelCount = static_cast<uint32_t>(pyramidLevelExtents.size());
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = PYRAMID_FORMAT;
+		imageInfo.extent = { pyramidLevelExtents[0].width, pyramidLevelExtents[0].height, 1 };
+		imageInfo.mipLevels = levelCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		vulkanDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pyramid, pyramidMemory);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = pyramid;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = PYRAMID_FORMAT;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+		if (vkCreateImageView(vulkanDevice.device(), &viewInfo, nullptr, &pyramidView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create depth pyramid view!");
+		}
+		// storage image views address a single level
+		pyramidLevelViews.resize(levelCount);
+		for (uint32_t level = 0; level < levelCount; level++) {
+			viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			if (vkCreateImageView(vulkanDevice.device(), &viewInfo, nullptr, &pyramidLevelViews[level]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create depth pyramid level view!");
+			}
+		}
+		pyramidNeedsClear = true;
+	}
+
+	void VulkEngOcclusionCulling::destroyPyramid() {
+		if (pyramid == VK_NULL_HANDLE) {
+			return;
+		}
+		VkDevice device = vulkanDevice.device();
+		VkImage image = pyramid;
+		VkDeviceMemory memory = pyramidMemory;
+		std::vector<VkImageView> views = pyramidLevelViews;
+		views.push_back(pyramidView);
+		vulkanDevice.deferDestruction([device, image, memory, views]() {
+			for (VkImageView view : views) {
+				vkDestroyImageView(device, view, nullptr);
+			}
+			vkDestroyImage(device, image, nullptr);
+			vkFreeMemory(device, memory, nullptr);
+		});
+		pyramid = VK_NULL_HANDLE;
+		pyramidMemory = VK_NULL_HANDLE;
+		pyramidView = VK_NULL_HANDLE;
+		pyramidLevelViews.clear();
+	}
+
+	void VulkEngOcclusionCulling::writeDescriptorSets(FrameResources& frame) {
+		// the frame's previous submission has completed, so its sets can be rewritten
+		VkDescriptorBufferInfo objectInfo{ frame.objectBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo drawInfo{ drawBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo visibilityInfo{ visibilityBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorImageInfo pyramidInfo{ sampler, pyramidView, VK_IMAGE_LAYOUT_GENERAL };
+
+		uint32_t levelCount = static_cast<uint32_t>(pyramidLevelViews.size());
+		std::vector<VkDescriptorImageInfo> levelInfos(levelCount * 2);
+		std::vector<VkWriteDescriptorSet> writes;
+		auto write = [&writes](VkDescriptorSet set, uint32_t binding, VkDescriptorType type) -> VkWriteDescriptorSet& {
+			VkWriteDescriptorSet descriptorWrite{};
+			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrite.dstSet = set;
+			descriptorWrite.dstBinding = binding;
+			descriptorWrite.descriptorCount = 1;
+			descriptorWrite.descriptorType = type;
+			writes.push_back(descriptorWrite);
+			return writes.back();
+		};
+		writes.reserve(5 + levelCount * 2);
+		write(frame.cullSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER).pBufferInfo = &objectInfo;
+		write(frame.cullSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER).pBufferInfo = &drawInfo;
+		write(frame.cullSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER).pBufferInfo = &visibilityInfo;
+		write(frame.cullSet, 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER).pImageInfo = &pyramidInfo;
+		write(frame.drawSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER).pBufferInfo = &objectInfo;
+		for (uint32_t level = 0; level < levelCount; level++) {
+			// level 0 reads the depth buffer, whose view is only known while the graph executes
+			if (level > 0) {
+				levelInfos[level * 2] = { sampler, pyramidView, VK_IMAGE_LAYOUT_GENERAL };
+				write(frame.pyramidSets[level], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER).pImageInfo = &levelInfos[level * 2];
+			}
+			levelInfos[level * 2 + 1] = { VK_NULL_HANDLE, pyramidLevelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+			write(frame.pyramidSets[level], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE).pImageInfo = &levelInfos[level * 2 + 1];
+		}
+		vkUpdateDescriptorSets(vulkanDevice.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	void VulkEngOcclusionCulling::cull(VkCommandBuffer commandBuffer, uint32_t phase) {
+		if (phase == 0) {
+			// the previous frame's draws and culling still use the buffers this one rewrites
+			computeBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+			if (pyramidNeedsClear) {
+				VkImageMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = pyramid;
+				barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+					0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+				VkClearColorValue farPlane{ {1.0f, 1.0f, 1.0f, 1.0f} };
+				vkCmdClearColorImage(commandBuffer, pyramid, VK_IMAGE_LAYOUT_GENERAL, &farPlane, 1, &barrier.subresourceRange);
+				computeBarrier(commandBuffer,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+				pyramidNeedsClear = false;
+			}
+		}
+		if (objectCount == 0) {
+			return;
+		}
+
+		FrameResources& frame = frames[currentFrame];
+		cullPipeline->bind(commandBuffer);
+		cullPipeline->bindDescriptorSet(commandBuffer, frame.cullSet);
+		CullPushConstants push{};
+		push.objectCount = objectCount;
+		push.phase = phase;
+		push.drawOffset = phase * capacity;
+		push.levelCount = static_cast<uint32_t>(pyramidLevelViews.size());
+		cullPipeline->pushConstants(commandBuffer, &push);
+		vkCmdDispatch(commandBuffer, (objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+		// the draws read the commands; the second phase reads what the first marked visible
+		computeBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+	}
+
+	void VulkEngOcclusionCulling::draw(VkCommandBuffer commandBuffer, uint32_t phase) {
+		assert(drawPipeline != nullptr && "Cannot draw before createPipelines");
+		if (objectCount == 0) {
+			return;
+		}
+
+		FrameResources& frame = frames[currentFrame];
+		drawPipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(
+			commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawLayout.pipelineLayout, 0, 1, &frame.drawSet, 0, nullptr);
+
+		// culled objects keep their command with an instance count of 0, so runs of objects sharing a
+		// model are one multi draw
+		constexpr VkDeviceSize stride = sizeof(VkDrawIndirectCommand);
+		bool multiDraw = vulkanDevice.enabledFeatures.multiDrawIndirect == VK_TRUE;
+		VkDeviceSize phaseOffset = static_cast<VkDeviceSize>(phase) * capacity * stride;
+		for (uint32_t first = 0; first < objectCount;) {
+			uint32_t end = first + 1;
+			while (end < objectCount && objectModels[end] == objectModels[first]) {
+				end++;
+			}
+			objectModels[first]->bind(commandBuffer);
+			if (multiDraw) {
+				vkCmdDrawIndirect(commandBuffer, drawBuffer, phaseOffset + first * stride, end - first, stride);
+			}
+			else {
+				for (uint32_t i = first; i < end; i++) {
+					vkCmdDrawIndirect(commandBuffer, drawBuffer, phaseOffset + i * stride, 1, stride);
+				}
+			}
+			first = end;
+		}
+	}
+
+	void VulkEngOcclusionCulling::buildPyramid(VkCommandBuffer commandBuffer) {
+		FrameResources& frame = frames[currentFrame];
+
+		VkDescriptorImageInfo depthInfo{ sampler, graph->getImageView(depthImage), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		VkWriteDescriptorSet depthWrite{};
+		depthWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		depthWrite.dstSet = frame.pyramidSets[0];
+		depthWrite.dstBinding = 0;
+		depthWrite.descriptorCount = 1;
+		depthWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		depthWrite.pImageInfo = &depthInfo;
+		vkUpdateDescriptorSets(vulkanDevice.device(), 1, &depthWrite, 0, nullptr);
+
+		pyramidPipeline->bind(commandBuffer);
+		VkExtent2D source = frameExtent;
+		for (uint32_t level = 0; level < pyramidLevelViews.size(); level++) {
+			VkExtent2D destination = pyramidLevelExtents[level];
+			PyramidPushConstants push{};
+			push.sourceSize[0] = static_cast<int32_t>(source.width);
+			push.sourceSize[1] = static_cast<int32_t>(source.height);
+			push.destinationSize[0] = static_cast<int32_t>(destination.width);
+			push.destinationSize[1] = static_cast<int32_t>(destination.height);
+			push.sourceLevel = level == 0 ? 0 : static_cast<int32_t>(level - 1);
+			pyramidPipeline->bindDescriptorSet(commandBuffer, frame.pyramidSets[level]);
+			pyramidPipeline->pushConstants(commandBuffer, &push);
+			vkCmdDispatch(commandBuffer,
+				(destination.width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+				(destination.height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+				1);
+			// the next level reads this one
+			computeBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+			source = destination;
+		}
+	}
+
+} // namespace VulkanEngine
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "vulkEngDevice.hpp"
+#include "vulkEngComputePipeline.hpp"
+#include "vulkEngPipelineVariants.hpp"
+#include "vulkEngRenderGraph.hpp"
+#include "vulkEngGameObj.hpp"
+#include "vulkEngJobSystem.hpp"
+
+//std
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace VulkanEngine {
+
+	// Two phase GPU occlusion culling against a hierarchical depth buffer. Each frame a compute pass
+	// tests the bounds of every object against a depth pyramid (the farthest depth per texel at every
+	// mip level) built from the previous frame, and writes one indirect draw per object. The
+	// survivors are drawn, a new pyramid is built from that depth, and the objects the first test
+	// rejected are tested again against it; the ones visible after all are drawn too, so objects
+	// coming into view are never missing for a frame. Objects outside the view volume are culled as
+	// well.
+	//
+	// Objects are drawn with their transform read from a storage buffer, indexed by the draw's
+	// firstInstance, which needs the drawIndirectFirstInstance feature.
+	class VulkEngOcclusionCulling {
+
+	public:
+		static constexpr uint32_t MAX_PYRAMID_LEVELS = 16;
+
+		static bool isSupported(const VulkEngDevice& device) { return device.enabledFeatures.drawIndirectFirstInstance == VK_TRUE; }
+
+		VulkEngOcclusionCulling(VulkEngDevice& device);
+		~VulkEngOcclusionCulling();
+
+		VulkEngOcclusionCulling(const VulkEngOcclusionCulling&) = delete;
+		VulkEngOcclusionCulling& operator=(const VulkEngOcclusionCulling&) = delete;
+
+		// Adds the cull, draw and pyramid passes, drawing into color and depth; the first draw clears
+		// both. graph must outlive this object.
+		void addPasses(VulkEngRenderGraph& graph, RenderGraphImage color, RenderGraphImage depth, VkClearColorValue clearColor);
+		// After the graph has been compiled, which decides the render target of the draws.
+		void createPipelines(VkCullModeFlags cullMode);
+
+		// Per frame, after VulkEngRenderer::beginFrame and before the graph executes. gameObjects
+		// must not change until the frame has been recorded.
+		// The per object data is filled across the job system's threads.
+		void prepareFrame(
+			VulkEngJobSystem& jobSystem,
+			uint32_t frameIndex,
+			VkExtent2D frameExtent,
+			const std::vector<VulkEngGameObj>& gameObjects);
+
+		VulkEngPipelineVariants& getPipelineVariants() { return *pipelineVariants; }
+
+	private:
+		// std430 layout of ObjectData in shaders/cullObjects.glsl
+		struct ObjectData {
+			glm::mat4 transform;
+			glm::vec4 boundsMin;
+			glm::vec4 boundsMax;
+			uint32_t vertexCount;
+			uint32_t padding[3];
+		};
+
+		struct FrameResources {
+			VkBuffer objectBuffer = VK_NULL_HANDLE;
+			VkDeviceMemory objectMemory = VK_NULL_HANDLE;
+			ObjectData* objects = nullptr;
+			VkDescriptorSet cullSet = VK_NULL_HANDLE;
+			VkDescriptorSet drawSet = VK_NULL_HANDLE;
+			std::array<VkDescriptorSet, MAX_PYRAMID_LEVELS> pyramidSets{};
+		};
+
+		void createSampler();
+		void createDescriptorSets();
+		void reserveObjects(uint32_t count);
+		void createPyramid(VkExtent2D frameExtent);
+		void destroyPyramid();
+		void writeDescriptorSets(FrameResources& frame);
+
+		void cull(VkCommandBuffer commandBuffer, uint32_t phase);
+		void draw(VkCommandBuffer commandBuffer, uint32_t phase);
+		void buildPyramid(VkCommandBuffer commandBuffer);
+
+		VulkEngDevice& vulkanDevice;
+		VulkEngRenderGraph* graph = nullptr;
+		RenderGraphImage depthImage;
+		RenderGraphImage pyramidImage;
+		RenderGraphPass earlyDrawPass;
+
+		std::unique_ptr<VulkEngComputePipeline> cullPipeline;
+		std::unique_ptr<VulkEngComputePipeline> pyramidPipeline;
+		std::unique_ptr<VulkEngPipelineVariants> pipelineVariants;
+		VulkEngPipeline* drawPipeline = nullptr;
+		ReflectedLayout drawLayout;
+
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		std::vector<FrameResources> frames;
+		uint32_t currentFrame = 0;
+
+		// early draws, then late draws, capacity commands each
+		VkBuffer drawBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory drawMemory = VK_NULL_HANDLE;
+		VkBuffer visibilityBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory visibilityMemory = VK_NULL_HANDLE;
+		uint32_t capacity = 0;
+		uint32_t objectCount = 0;
+		std::vector<VulkEngModel*> objectModels;
+
+		VkImage pyramid = VK_NULL_HANDLE;
+		VkDeviceMemory pyramidMemory = VK_NULL_HANDLE;
+		VkImageView pyramidView = VK_NULL_HANDLE;
+		std::vector<VkImageView> pyramidLevelViews;
+		std::vector<VkExtent2D> pyramidLevelExtents;
+		VkExtent2D frameExtent{ 0, 0 };
+		// a new pyramid holds no depth yet; it is cleared to the far plane, so nothing is culled
+		bool pyramidNeedsClear = false;
+	};
+
+} // namespace VulkanEngine
@@ -2,12 +2,64 @@
 #include "vulkEngModel.hpp"
 
 // std
-#include <fstream>
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
+#include <string>
 #include <cassert>
+#include <utility>
 
 namespace VulkanEngine {
 
+	SpecializationConstants& SpecializationConstants::set(uint32_t constantId, bool value) {
+		setBits(constantId, value ? VK_TRUE : VK_FALSE);
+		return *this;
+	}
+
+	SpecializationConstants& SpecializationConstants::set(uint32_t constantId, int32_t value) {
+		setBits(constantId, static_cast<uint32_t>(value));
+		return *this;
+	}
+
+	SpecializationConstants& SpecializationConstants::set(uint32_t constantId, uint32_t value) {
+		setBits(constantId, value);
+		return *this;
+	}
+
+	SpecializationConstants& SpecializationConstants::set(uint32_t constantId, float value) {
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		setBits(constantId, bits);
+		return *this;
+	}
+
+	void SpecializationConstants::setBits(uint32_t constantId, uint32_t bits) {
+		for (const auto& entry : entries) {
+			if (entry.constantID == constantId) {
+				data[entry.offset / sizeof(uint32_t)] = bits;
+				return;
+			}
+		}
+		VkSpecializationMapEntry entry{};
+		entry.constantID = constantId;
+		entry.offset = static_cast<uint32_t>(data.size() * sizeof(uint32_t));
+		entry.size = sizeof(uint32_t);
+		entries.push_back(entry);
+		data.push_back(bits);
+	}
+
+	std::vector<uint32_t> SpecializationConstants::key() const {
+		std::vector<VkSpecializationMapEntry> sorted = entries;
+		std::sort(sorted.begin(), sorted.end(),
+			[](const VkSpecializationMapEntry& a, const VkSpecializationMapEntry& b) { return a.constantID < b.constantID; });
+		std::vector<uint32_t> result;
+		for (const auto& entry : sorted) {
+			result.push_back(entry.constantID);
+			result.push_back(data[entry.offset / sizeof(uint32_t)]);
+		}
+		return result;
+	}
+
 	VulkEngPipeline::VulkEngPipeline(
 		VulkEngDevice& device,
 		const std::string& vertFilepath,
@@ -22,33 +74,9 @@ namespace VulkanEngine {
 			if (graphicsPipeline != VK_NULL_HANDLE) {
 				vkDestroyPipeline(vulkanDevice.device(), graphicsPipeline, nullptr);
 			}
-			if (vertShaderModule != VK_NULL_HANDLE) {
-				vkDestroyShaderModule(vulkanDevice.device(), vertShaderModule, nullptr);
-			}
-			if (fragShaderModule != VK_NULL_HANDLE) {
-				vkDestroyShaderModule(vulkanDevice.device(), fragShaderModule, nullptr);
-			}
 		}
 	}
 
-	std::vector<char> VulkEngPipeline::readFile(const std::string& filepath) {
-
-		std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
-
-		if (!file.is_open()) {
-			throw std::runtime_error("failed to open file: " + filepath);
-		}
-
-		size_t fileSize = static_cast<size_t>(file.tellg());
-		std::vector<char> buffer(fileSize);
-
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-
-		file.close();
-		return buffer;
-	}
-
 	void VulkEngPipeline::createGraphicsPipeline(
 		const std::string& vertFilepath,
 		const std::string& fragFilepath,
@@ -56,33 +84,51 @@ namespace VulkanEngine {
 	) {
 		assert(
 			configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
+		const RenderTargetInfo& renderTarget = configInfo.renderTarget;
 		assert(
-			configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline: no renderPass provided in configInfo");
-
-		auto vertCode = readFile(vertFilepath);
-		auto fragCode = readFile(fragFilepath);
-
-		createShaderModule(vertCode, &vertShaderModule);
-		createShaderModule(fragCode, &fragShaderModule);
+			(renderTarget.renderPass != VK_NULL_HANDLE || !renderTarget.colorFormats.empty() || renderTarget.depthFormat != VK_FORMAT_UNDEFINED) &&
+			"Cannot create graphics pipeline: no renderPass or attachment formats provided in configInfo");
+
+		vertShaderModule = vulkanDevice.shaderCache().loadModule(vertFilepath);
+		fragShaderModule = fragFilepath.empty() ? nullptr : vulkanDevice.shaderCache().loadModule(fragFilepath);
+
+		const SpecializationConstants& constants = configInfo.specializationConstants;
+		for (const auto& entry : constants.getEntries()) {
+			auto declares = [&](const VulkEngShaderModule& module) {
+				const auto& ids = module.getReflection().specializationConstantIds;
+				return std::binary_search(ids.begin(), ids.end(), entry.constantID);
+			};
+			if (!declares(*vertShaderModule) && (fragShaderModule == nullptr || !declares(*fragShaderModule))) {
+				throw std::runtime_error(
+					"specialization constant " + std::to_string(entry.constantID) + " is not declared by any shader stage!");
+			}
+		}
+		VkSpecializationInfo specializationInfo{};
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(constants.getEntries().size());
+		specializationInfo.pMapEntries = constants.getEntries().data();
+		specializationInfo.dataSize = constants.getData().size() * sizeof(uint32_t);
+		specializationInfo.pData = constants.getData().data();
+		const VkSpecializationInfo* stageSpecialization = constants.empty() ? nullptr : &specializationInfo;
 
 		VkPipelineShaderStageCreateInfo shaderStages[2];
 		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shaderStages[0].module = vertShaderModule;
+		shaderStages[0].module = vertShaderModule->getHandle();
 		shaderStages[0].pName = "main";
 		shaderStages[0].flags = 0;
 		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
+		shaderStages[0].pSpecializationInfo = stageSpecialization;
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		shaderStages[1].module = fragShaderModule;
+		shaderStages[1].module = fragShaderModule ? fragShaderModule->getHandle() : VK_NULL_HANDLE;
 		shaderStages[1].pName = "main";
 		shaderStages[1].flags = 0;
 		shaderStages[1].pNext = nullptr;
-		shaderStages[1].pSpecializationInfo = nullptr;
+		shaderStages[1].pSpecializationInfo = stageSpecialization;
 
-		auto bindingDescriptions = VulkEngModel::Vertex::getBindingDescriptions();
-		auto attributeDescriptions = VulkEngModel::Vertex::getAttributeDescriptions();
+		const auto& bindingDescriptions = configInfo.bindingDescriptions;
+		const auto& attributeDescriptions = configInfo.attributeDescriptions;
+		validateVertexInputs(vertShaderModule->getReflection(), attributeDescriptions);
 
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -91,22 +137,37 @@ namespace VulkanEngine {
 		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
+		// the sample count belongs to the render target, whatever the config's defaults say
+		VkPipelineMultisampleStateCreateInfo multisampleInfo = configInfo.multisampleInfo;
+		multisampleInfo.rasterizationSamples = renderTarget.samples;
+
 		VkGraphicsPipelineCreateInfo pipelineInfo{};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
+		pipelineInfo.stageCount = fragShaderModule ? 2 : 1;
 		pipelineInfo.pStages = shaderStages;
 		pipelineInfo.pVertexInputState = &vertexInputInfo;
 		pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
 		pipelineInfo.pViewportState = &configInfo.viewportInfo;
 		pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
-		pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
+		pipelineInfo.pMultisampleState = &multisampleInfo;
 		pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
 		pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
 		pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
 
 		pipelineInfo.layout = configInfo.pipelineLayout;
-		pipelineInfo.renderPass = configInfo.renderPass;
-		pipelineInfo.subpass = configInfo.subpass;
+		pipelineInfo.renderPass = renderTarget.renderPass;
+		pipelineInfo.subpass = renderTarget.subpass;
+
+		// a stencil aspect is never attached, so no stencil format even for combined depth formats
+		VkPipelineRenderingCreateInfo renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+		renderingInfo.colorAttachmentCount = static_cast<uint32_t>(renderTarget.colorFormats.size());
+		renderingInfo.pColorAttachmentFormats = renderTarget.colorFormats.data();
+		renderingInfo.depthAttachmentFormat = renderTarget.depthFormat;
+		renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+		if (renderTarget.renderPass == VK_NULL_HANDLE) {
+			pipelineInfo.pNext = &renderingInfo;
+		}
 
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 		pipelineInfo.basePipelineIndex = -1;
@@ -124,22 +185,26 @@ namespace VulkanEngine {
 
 	}
 
-	void VulkEngPipeline::createShaderModule(
-		const std::vector<char>& code,
-		VkShaderModule* shaderModule
+	void VulkEngPipeline::validateVertexInputs(
+		const ShaderReflection& vertexShader,
+		const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions
 	) {
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-		if (vkCreateShaderModule(
-			vulkanDevice.device(),
-			&createInfo,
-			nullptr,
-			shaderModule
-		) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create shader module!");
+		if (vertexShader.stage != VK_SHADER_STAGE_VERTEX_BIT) {
+			throw std::runtime_error("vertex shader module is not a vertex shader!");
+		}
+		for (const auto& input : vertexShader.vertexInputs) {
+			auto attribute = std::find_if(attributeDescriptions.begin(), attributeDescriptions.end(),
+				[&](const VkVertexInputAttributeDescription& a) { return a.location == input.location; });
+			if (attribute == attributeDescriptions.end()) {
+				throw std::runtime_error(
+					"vertex shader input '" + input.name + "' at location " + std::to_string(input.location) +
+					" has no matching vertex attribute!");
+			}
+			if (!ShaderReflection::isCompatibleVertexFormat(input.format, attribute->format)) {
+				throw std::runtime_error(
+					"vertex attribute at location " + std::to_string(input.location) +
+					" does not match the numeric type of shader input '" + input.name + "'!");
+			}
 		}
 	}
 
@@ -147,6 +212,13 @@ namespace VulkanEngine {
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 	}
 
+	void VulkEngPipeline::swap(VulkEngPipeline& other) {
+		assert(&vulkanDevice == &other.vulkanDevice && "Cannot swap pipelines created on different devices");
+		std::swap(graphicsPipeline, other.graphicsPipeline);
+		std::swap(vertShaderModule, other.vertShaderModule);
+		std::swap(fragShaderModule, other.fragShaderModule);
+	}
+
 	void VulkEngPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
 
 		configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -164,7 +236,8 @@ namespace VulkanEngine {
 		configInfo.rasterizationInfo.rasterizerDiscardEnable = VK_FALSE;
 		configInfo.rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
 		configInfo.rasterizationInfo.lineWidth = 1.0f;
-		configInfo.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+		// front faces wind clockwise in framebuffer coordinates (y down)
+		configInfo.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
 		configInfo.rasterizationInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
 		configInfo.rasterizationInfo.depthBiasEnable = VK_FALSE;
 		configInfo.rasterizationInfo.depthBiasConstantFactor = 0.0f;  // Optional
@@ -211,6 +284,9 @@ namespace VulkanEngine {
 		configInfo.depthStencilInfo.front = {};  // Optional
 		configInfo.depthStencilInfo.back = {};   // Optional
 
+		configInfo.bindingDescriptions = VulkEngModel::Vertex::getBindingDescriptions();
+		configInfo.attributeDescriptions = VulkEngModel::Vertex::getAttributeDescriptions();
+
 		configInfo.dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 		configInfo.dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
 		configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
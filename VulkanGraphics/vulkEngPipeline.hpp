@@ -1,13 +1,49 @@
 #pragma once
 
 #include "vulkEngDevice.hpp"
+#include "vulkEngShaderCache.hpp"
 
 // std
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace VulkanEngine {
 
+	// Values for the shaders' specialization constants, keyed by constant_id. Every value is 32 bits
+	// (bools become VkBool32), and one set is applied to all stages of a pipeline.
+	class SpecializationConstants {
+	public:
+		SpecializationConstants& set(uint32_t constantId, bool value);
+		SpecializationConstants& set(uint32_t constantId, int32_t value);
+		SpecializationConstants& set(uint32_t constantId, uint32_t value);
+		SpecializationConstants& set(uint32_t constantId, float value);
+
+		bool empty() const { return entries.empty(); }
+		const std::vector<VkSpecializationMapEntry>& getEntries() const { return entries; }
+		const std::vector<uint32_t>& getData() const { return data; }
+
+		// (constant_id, value) pairs ordered by id, equal for sets that specialize identically
+		std::vector<uint32_t> key() const;
+
+	private:
+		void setBits(uint32_t constantId, uint32_t bits);
+
+		std::vector<VkSpecializationMapEntry> entries;
+		std::vector<uint32_t> data;
+	};
+
+	// What a pipeline renders into: a subpass of renderPass or, when renderPass is null, attachments
+	// of these formats bound with dynamic rendering (vkCmdBeginRendering). samples is the sample
+	// count of the attachments, which the pipeline rasterizes with.
+	struct RenderTargetInfo {
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		uint32_t subpass = 0;
+		std::vector<VkFormat> colorFormats;
+		VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	};
+
 	struct PipelineConfigInfo {
 		PipelineConfigInfo() = default;
 		PipelineConfigInfo(const PipelineConfigInfo&) = delete;
@@ -22,11 +58,16 @@ namespace VulkanEngine {
 		VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
 		std::vector<VkDynamicState> dynamicStateEnables;
 		VkPipelineDynamicStateCreateInfo dynamicStateInfo;
+		// VulkEngModel::Vertex by default
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 		VkPipelineLayout pipelineLayout = nullptr;
-		VkRenderPass renderPass = nullptr;
-		uint32_t subpass = 0;
+		RenderTargetInfo renderTarget;
+		// must only name constants declared by one of the pipeline's shaders
+		SpecializationConstants specializationConstants;
 	};
 
+	// An empty fragFilepath creates a pipeline without a fragment stage, which only writes depth.
 	class VulkEngPipeline {
 	public:
 		VulkEngPipeline(
@@ -42,10 +83,22 @@ namespace VulkanEngine {
 
 		void bind(VkCommandBuffer commandBuffer);
 
+		// Exchanges the pipelines and shader modules of two objects, so a rebuilt pipeline can take
+		// over while everything pointing at this object stays valid. Only between frames, on the
+		// thread that records command buffers.
+		void swap(VulkEngPipeline& other);
+
+		const VulkEngShaderModule& getVertexShader() const { return *vertShaderModule; }
+		bool hasFragmentShader() const { return fragShaderModule != nullptr; }
+		const VulkEngShaderModule& getFragmentShader() const { return *fragShaderModule; }
+
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
 	private:
-		static std::vector<char> readFile(const std::string& filepath);
+		// throws if the vertex shader reads a location the attributes do not feed with a compatible format
+		static void validateVertexInputs(
+			const ShaderReflection& vertexShader,
+			const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions);
 
 		void createGraphicsPipeline(
 			const std::string& vertFilepath, 
@@ -53,11 +106,10 @@ namespace VulkanEngine {
 			const PipelineConfigInfo& configInfo
 		);
 
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
-
 		VulkEngDevice& vulkanDevice;
 		VkPipeline graphicsPipeline;
-		VkShaderModule vertShaderModule;
-		VkShaderModule fragShaderModule;
+		// held so pipeline variants built from the same shaders reuse the cached modules
+		std::shared_ptr<VulkEngShaderModule> vertShaderModule;
+		std::shared_ptr<VulkEngShaderModule> fragShaderModule;
 	};
 } // namespace VulkanEngine
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "vulkEngPipelineVariants.hpp"
+
+//std
+#include <stdexcept>
+
+namespace VulkanEngine {
+
+	VulkEngPipelineVariants::VulkEngPipelineVariants(
+		VulkEngDevice& device,
+		const std::string& vertFilepath,
+		const std::string& fragFilepath,
+		std::function<void(PipelineConfigInfo&)> configure
+	) : vulkanDevice{ device },
+		vertFilepath{ vertFilepath },
+		fragFilepath{ fragFilepath },
+		configure{ std::move(configure) }
+	{}
+
+	VulkEngPipeline& VulkEngPipelineVariants::get(const SpecializationConstants& constants) {
+		std::vector<uint32_t> key = constants.key();
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto existing = variants.find(key);
+		if (existing != variants.end()) {
+			return *existing->second.pipeline;
+		}
+
+		PipelineConfigInfo configInfo{};
+		configure(configInfo);
+		configInfo.specializationConstants = constants;
+		auto pipeline = std::make_unique<VulkEngPipeline>(vulkanDevice, vertFilepath, fragFilepath, configInfo);
+		auto& variant = variants[std::move(key)];
+		variant.constants = constants;
+		variant.pipeline = std::move(pipeline);
+		return *variant.pipeline;
+	}
+
+	size_t VulkEngPipelineVariants::getVariantCount() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		return variants.size();
+	}
+
+	std::vector<VulkEngPipelineVariants::Replacement> VulkEngPipelineVariants::buildReplacements() {
+		struct Snapshot {
+			VulkEngPipeline* target;
+			SpecializationConstants constants;
+			ShaderReflection vertexShader;
+			ShaderReflection fragmentShader;
+		};
+		std::vector<Snapshot> snapshots;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			for (auto& [key, variant] : variants) {
+				snapshots.push_back({
+					variant.pipeline.get(),
+					variant.constants,
+					variant.pipeline->getVertexShader().getReflection(),
+					variant.pipeline->hasFragmentShader() ? variant.pipeline->getFragmentShader().getReflection() : ShaderReflection{} });
+			}
+		}
+
+		// building takes the bulk of the time and runs without the lock
+		std::vector<Replacement> replacements;
+		for (const auto& snapshot : snapshots) {
+			PipelineConfigInfo configInfo{};
+			configure(configInfo);
+			configInfo.specializationConstants = snapshot.constants;
+			auto pipeline = std::make_unique<VulkEngPipeline>(vulkanDevice, vertFilepath, fragFilepath, configInfo);
+			if (!pipeline->getVertexShader().getReflection().hasSameResourceInterface(snapshot.vertexShader) ||
+				(pipeline->hasFragmentShader() &&
+					!pipeline->getFragmentShader().getReflection().hasSameResourceInterface(snapshot.fragmentShader))) {
+				throw std::runtime_error("shader resource interface changed, the pipeline layout must be rebuilt!");
+			}
+			replacements.push_back({ snapshot.target, std::move(pipeline) });
+		}
+		return replacements;
+	}
+
+	void VulkEngPipelineVariants::replace(Replacement& replacement) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		replacement.target->swap(*replacement.pipeline);
+	}
+
+} // namespace VulkanEngine
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "vulkEngPipeline.hpp"
+
+//std
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace VulkanEngine {
+
+	// Builds and caches one pipeline per set of specialization constants for a pair of shaders, so
+	// feature toggles (lighting paths, debug views) are compiled out of the hot shaders instead of
+	// being branched on at runtime. configure fills in everything except the constants; it is run
+	// again for every new variant, because PipelineConfigInfo cannot be copied. An empty
+	// fragFilepath builds depth only pipelines.
+	class VulkEngPipelineVariants {
+
+	public:
+		// A freshly built pipeline for an existing variant, see buildReplacements.
+		struct Replacement {
+			VulkEngPipeline* target;
+			std::unique_ptr<VulkEngPipeline> pipeline;
+		};
+
+		VulkEngPipelineVariants(
+			VulkEngDevice& device,
+			const std::string& vertFilepath,
+			const std::string& fragFilepath,
+			std::function<void(PipelineConfigInfo&)> configure);
+
+		VulkEngPipelineVariants(const VulkEngPipelineVariants&) = delete;
+		VulkEngPipelineVariants& operator=(const VulkEngPipelineVariants&) = delete;
+
+		// Creates the variant on first use; later calls with an equal set return the same pipeline.
+		// The reference stays valid, and is updated in place by replace, for the lifetime of this object.
+		VulkEngPipeline& get(const SpecializationConstants& constants = {});
+
+		size_t getVariantCount();
+		bool usesShader(const std::string& filepath) const {
+			return filepath == vertFilepath || filepath == fragFilepath;
+		}
+
+		// Rebuilds every variant from the shaders as they are now. Safe to call from another thread
+		// while get is in use; throws, building nothing, if a shader no longer fits the existing layout.
+		std::vector<Replacement> buildReplacements();
+		// Swaps a replacement into its target; the pipeline it displaced is left in replacement.
+		void replace(Replacement& replacement);
+
+	private:
+		struct Variant {
+			SpecializationConstants constants;
+			std::unique_ptr<VulkEngPipeline> pipeline;
+		};
+
+		VulkEngDevice& vulkanDevice;
+		std::string vertFilepath;
+		std::string fragFilepath;
+		std::function<void(PipelineConfigInfo&)> configure;
+		std::mutex mutex;
+		std::map<std::vector<uint32_t>, Variant> variants;
+	};
+
+} // namespace VulkanEngine
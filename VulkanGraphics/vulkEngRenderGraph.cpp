@@ -0,0 +1,940 @@
+#include "vulkEngRenderGraph.hpp"
+
+//std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace VulkanEngine {
+
+	namespace {
+		constexpr VkAccessFlags WRITE_ACCESS =
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		// imported handle pairs remembered per image, more than a swap chain has images
+		constexpr size_t MAX_RECENT_IMPORTS = 8;
+
+		// non-dispatchable handles are 64 bit on every platform
+		template <typename Handle>
+		uint64_t handleKey(Handle handle) {
+			return (uint64_t)(handle);
+		}
+	}
+
+	VulkEngRenderGraph::PassBuilder& VulkEngRenderGraph::PassBuilder::writeColor(
+		RenderGraphImage image, VkAttachmentLoadOp loadOp, VkClearColorValue clearValue
+	) {
+		VkClearValue clear{};
+		clear.color = clearValue;
+		return graph.addUse(*this, image, Usage::ColorAttachment, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, loadOp, clear);
+	}
+
+	VulkEngRenderGraph::PassBuilder& VulkEngRenderGraph::PassBuilder::writeDepth(
+		RenderGraphImage image, VkAttachmentLoadOp loadOp, float clearDepth
+	) {
+		VkClearValue clear{};
+		clear.depthStencil = { clearDepth, 0 };
+		return graph.addUse(*this, image, Usage::DepthAttachment,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, loadOp, clear);
+	}
+
+	VulkEngRenderGraph::PassBuilder& VulkEngRenderGraph::PassBuilder::readDepth(RenderGraphImage image) {
+		return graph.addUse(*this, image, Usage::DepthRead,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ATTACHMENT_LOAD_OP_LOAD, {});
+	}
+
+	VulkEngRenderGraph::PassBuilder& VulkEngRenderGraph::PassBuilder::resolveColor(RenderGraphImage image) {
+		return graph.addUse(*this, image, Usage::ColorResolve, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ATTACHMENT_LOAD_OP_DONT_CARE, {});
+	}
+
+	VulkEngRenderGraph::PassBuilder& VulkEngRenderGraph::PassBuilder::sampleImage(RenderGraphImage image, VkPipelineStageFlags stages) {
+		return graph.addUse(*this, image, Usage::Sampled, stages, VK_ATTACHMENT_LOAD_OP_LOAD, {});
+	}
+
+	VulkEngRenderGraph::PassBuilder& VulkEngRenderGraph::PassBuilder::readStorageImage(RenderGraphImage image, VkPipelineStageFlags stages) {
+		return graph.addUse(*this, image, Usage::StorageRead, stages, VK_ATTACHMENT_LOAD_OP_LOAD, {});
+	}
+
+	VulkEngRenderGraph::PassBuilder& VulkEngRenderGraph::PassBuilder::writeStorageImage(RenderGraphImage image, VkPipelineStageFlags stages) {
+		return graph.addUse(*this, image, Usage::StorageWrite, stages, VK_ATTACHMENT_LOAD_OP_LOAD, {});
+	}
+
+	VulkEngRenderGraph::PassBuilder& VulkEngRenderGraph::PassBuilder::transferSource(RenderGraphImage image) {
+		return graph.addUse(*this, image, Usage::TransferSource, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ATTACHMENT_LOAD_OP_LOAD, {});
+	}
+
+	VulkEngRenderGraph::PassBuilder& VulkEngRenderGraph::PassBuilder::transferDestination(RenderGraphImage image) {
+		return graph.addUse(*this, image, Usage::TransferDestination, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ATTACHMENT_LOAD_OP_DONT_CARE, {});
+	}
+
+	VulkEngRenderGraph::PassBuilder& VulkEngRenderGraph::PassBuilder::setSideEffects() {
+		graph.passes[index].sideEffects = true;
+		graph.compiled = false;
+		return *this;
+	}
+
+	VulkEngRenderGraph::PassBuilder& VulkEngRenderGraph::PassBuilder::setExecute(std::function<void(VkCommandBuffer)> execute) {
+		graph.passes[index].execute = std::move(execute);
+		return *this;
+	}
+
+	VulkEngRenderGraph::VulkEngRenderGraph(VulkEngDevice& device) : vulkanDevice{ device } {}
+
+	VulkEngRenderGraph::~VulkEngRenderGraph() {
+		releaseImages();
+		for (auto& pass : passes) {
+			if (pass.renderPass != VK_NULL_HANDLE) {
+				VkRenderPass renderPass = pass.renderPass;
+				VkDevice device = vulkanDevice.device();
+				vulkanDevice.deferDestruction([device, renderPass]() { vkDestroyRenderPass(device, renderPass, nullptr); });
+			}
+		}
+	}
+
+	RenderGraphImage VulkEngRenderGraph::createImage(const std::string& name, const RenderGraphImageDesc& desc) {
+		Image image{};
+		image.name = name;
+		image.imported = false;
+		image.format = desc.format;
+		image.samples = desc.samples;
+		image.desc = desc;
+		images.push_back(std::move(image));
+		compiled = false;
+		return { static_cast<uint32_t>(images.size() - 1) };
+	}
+
+	RenderGraphImage VulkEngRenderGraph::importImage(const std::string& name, const RenderGraphImport& import) {
+		Image image{};
+		image.name = name;
+		image.imported = true;
+		image.format = import.format;
+		image.import = import;
+		images.push_back(std::move(image));
+		compiled = false;
+		return { static_cast<uint32_t>(images.size() - 1) };
+	}
+
+	VulkEngRenderGraph::PassBuilder VulkEngRenderGraph::addPass(const std::string& name) {
+		Pass pass{};
+		pass.name = name;
+		passes.push_back(std::move(pass));
+		compiled = false;
+		return PassBuilder{ *this, static_cast<uint32_t>(passes.size() - 1) };
+	}
+
+	VulkEngRenderGraph::PassBuilder& VulkEngRenderGraph::addUse(
+		PassBuilder& builder,
+		RenderGraphImage image,
+		Usage usage,
+		VkPipelineStageFlags stages,
+		VkAttachmentLoadOp loadOp,
+		VkClearValue clearValue
+	) {
+		Pass& pass = passes[builder.index];
+		if (image.index >= images.size()) {
+			throw std::runtime_error("render graph: pass '" + pass.name + "' uses an unknown image!");
+		}
+		for (const auto& use : pass.uses) {
+			if (use.image == image.index) {
+				throw std::runtime_error(
+					"render graph: pass '" + pass.name + "' uses image '" + images[image.index].name + "' twice!");
+			}
+		}
+
+		ImageUse use{};
+		use.image = image.index;
+		use.usage = usage;
+		use.stages = stages;
+		use.loadOp = loadOp;
+		use.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		use.clearValue = clearValue;
+		VkImageUsageFlags imageUsage = 0;
+		switch (usage) {
+		case Usage::ColorAttachment:
+			use.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			use.access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+				(loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0);
+			imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			break;
+		case Usage::ColorResolve:
+			use.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			use.access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			break;
+		case Usage::DepthAttachment:
+			use.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			use.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			imageUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			break;
+		case Usage::DepthRead:
+			use.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			use.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+			// a store is not a write to a read-only attachment, a DONT_CARE store would be
+			use.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			imageUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			break;
+		case Usage::Sampled:
+			use.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			use.access = VK_ACCESS_SHADER_READ_BIT;
+			imageUsage = VK_IMAGE_USAGE_SAMPLED_BIT;
+			break;
+		case Usage::StorageRead:
+			use.layout = VK_IMAGE_LAYOUT_GENERAL;
+			use.access = VK_ACCESS_SHADER_READ_BIT;
+			imageUsage = VK_IMAGE_USAGE_STORAGE_BIT;
+			break;
+		case Usage::StorageWrite:
+			use.layout = VK_IMAGE_LAYOUT_GENERAL;
+			use.access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			imageUsage = VK_IMAGE_USAGE_STORAGE_BIT;
+			break;
+		case Usage::TransferSource:
+			use.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			use.access = VK_ACCESS_TRANSFER_READ_BIT;
+			imageUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			break;
+		case Usage::TransferDestination:
+			use.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			use.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			break;
+		}
+		images[image.index].usage |= imageUsage;
+		pass.uses.push_back(use);
+		compiled = false;
+		return builder;
+	}
+
+	void VulkEngRenderGraph::compile() {
+		releaseImages();
+		frameExtent = { 0, 0 };
+		finalBarriers = {};
+		for (auto& pass : passes) {
+			pass.barriers = {};
+		}
+		for (auto& image : images) {
+			image.firstPass = ~0u;
+			image.lastPass = 0;
+			image.slot = ~0u;
+			image.lazy = false;
+		}
+
+		validateSampleCounts();
+		cullPasses();
+
+		for (uint32_t i = 0; i < passes.size(); i++) {
+			if (passes[i].culled) {
+				continue;
+			}
+			for (const auto& use : passes[i].uses) {
+				Image& image = images[use.image];
+				if (image.firstPass == ~0u) {
+					if (!image.imported && readsContents(use)) {
+						throw std::runtime_error(
+							"render graph: pass '" + passes[i].name + "' reads image '" + image.name + "' before any pass writes it!");
+					}
+					image.firstPass = i;
+				}
+				image.lastPass = i;
+			}
+		}
+		for (uint32_t i = 0; i < passes.size(); i++) {
+			for (auto& use : passes[i].uses) {
+				const Image& image = images[use.image];
+				if (use.usage != Usage::DepthRead) {
+					// nothing later needs the contents, so the tile memory is never written back
+					bool usedLater = image.imported || (!passes[i].culled && image.lastPass > i);
+					use.storeOp = usedLater ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				}
+			}
+		}
+
+		// Attachments whose contents never leave a pass need no backing memory on tile based GPUs,
+		// see VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT.
+		constexpr VkImageUsageFlags ATTACHMENT_USAGE =
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		for (uint32_t i = 0; i < images.size(); i++) {
+			Image& image = images[i];
+			if (image.imported || image.firstPass == ~0u || (image.usage & ~ATTACHMENT_USAGE) != 0) {
+				continue;
+			}
+			image.lazy = std::none_of(passes.begin(), passes.end(), [&](const Pass& pass) {
+				return !pass.culled && std::any_of(pass.uses.begin(), pass.uses.end(), [&](const ImageUse& use) {
+					return use.image == i &&
+						(use.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD || use.storeOp == VK_ATTACHMENT_STORE_OP_STORE);
+				});
+			});
+		}
+
+		assignSlots();
+		compileBarriers();
+		createRenderPasses();
+		compiled = true;
+	}
+
+	void VulkEngRenderGraph::validateSampleCounts() const {
+		for (const auto& pass : passes) {
+			std::vector<uint32_t> colors;
+			std::vector<uint32_t> resolves;
+			VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+			bool hasAttachment = false;
+			for (const auto& use : pass.uses) {
+				const Image& image = images[use.image];
+				if (use.usage == Usage::ColorResolve) {
+					resolves.push_back(use.image);
+					continue;
+				}
+				if (!isAttachment(use.usage)) {
+					if (image.samples != VK_SAMPLE_COUNT_1_BIT) {
+						throw std::runtime_error(
+							"render graph: pass '" + pass.name + "' reads multisampled image '" + image.name + "' in a shader!");
+					}
+					continue;
+				}
+				if (hasAttachment && image.samples != samples) {
+					throw std::runtime_error("render graph: the attachments of pass '" + pass.name + "' differ in sample count!");
+				}
+				samples = image.samples;
+				hasAttachment = true;
+				if (use.usage == Usage::ColorAttachment) {
+					colors.push_back(use.image);
+				}
+			}
+			if (resolves.empty()) {
+				continue;
+			}
+			if (resolves.size() > colors.size() || samples == VK_SAMPLE_COUNT_1_BIT) {
+				throw std::runtime_error("render graph: pass '" + pass.name + "' resolves more multisampled color attachments than it has!");
+			}
+			for (size_t i = 0; i < resolves.size(); i++) {
+				const Image& target = images[resolves[i]];
+				if (target.samples != VK_SAMPLE_COUNT_1_BIT || target.format != images[colors[i]].format) {
+					throw std::runtime_error(
+						"render graph: pass '" + pass.name + "' cannot resolve into image '" + target.name + "'!");
+				}
+			}
+		}
+	}
+
+	// Walks the passes backwards, keeping a pass only when something later still needs an image it
+	// writes. Overwriting an image ends the interest in what earlier passes wrote to it.
+	void VulkEngRenderGraph::cullPasses() {
+		std::vector<bool> needed(images.size());
+		for (size_t i = 0; i < images.size(); i++) {
+			needed[i] = images[i].imported;
+		}
+
+		for (size_t i = passes.size(); i-- > 0;) {
+			Pass& pass = passes[i];
+			bool writesNeeded = std::any_of(pass.uses.begin(), pass.uses.end(), [&](const ImageUse& use) {
+				return (use.access & WRITE_ACCESS) != 0 && needed[use.image];
+			});
+			pass.culled = !pass.sideEffects && !writesNeeded;
+			if (pass.culled) {
+				continue;
+			}
+			for (const auto& use : pass.uses) {
+				bool overwrites = use.usage == Usage::ColorResolve ||
+					((use.usage == Usage::ColorAttachment || use.usage == Usage::DepthAttachment) && use.loadOp != VK_ATTACHMENT_LOAD_OP_LOAD);
+				if (overwrites) {
+					needed[use.image] = false;
+				}
+			}
+			for (const auto& use : pass.uses) {
+				if (readsContents(use)) {
+					needed[use.image] = true;
+				}
+			}
+		}
+	}
+
+	// Interval partitioning: a graph owned image joins the first slot whose images are all done
+	// before it is first used, every slot becomes one allocation. Lazily allocated images only
+	// share with each other, so the others keep ordinary device memory.
+	void VulkEngRenderGraph::assignSlots() {
+		std::vector<uint32_t> order;
+		for (uint32_t i = 0; i < images.size(); i++) {
+			if (!images[i].imported && images[i].firstPass != ~0u) {
+				order.push_back(i);
+			}
+		}
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return images[a].firstPass < images[b].firstPass;
+		});
+
+		std::vector<uint32_t> slotEnds;
+		lazySlots.clear();
+		for (uint32_t index : order) {
+			Image& image = images[index];
+			uint32_t slot = 0;
+			while (slot < slotEnds.size() && (slotEnds[slot] >= image.firstPass || lazySlots[slot] != image.lazy)) {
+				slot++;
+			}
+			if (slot == slotEnds.size()) {
+				slotEnds.push_back(image.lastPass);
+				lazySlots.push_back(image.lazy);
+			}
+			else {
+				slotEnds[slot] = image.lastPass;
+			}
+			image.slot = slot;
+		}
+		slotCount = static_cast<uint32_t>(slotEnds.size());
+	}
+
+	void VulkEngRenderGraph::compileBarriers() {
+		std::vector<ImageState> states(images.size());
+		for (size_t i = 0; i < images.size(); i++) {
+			states[i] = images[i].imported
+				? ImageState{ images[i].import.initialLayout, images[i].import.initialStages, 0 }
+				: ImageState{ VK_IMAGE_LAYOUT_UNDEFINED, 0, 0 };
+		}
+
+		// where each graph owned image's first barrier was placed: pass index and barrier index
+		std::vector<std::pair<uint32_t, size_t>> firstBarriers(images.size(), { ~0u, 0 });
+
+		for (uint32_t i = 0; i < passes.size(); i++) {
+			Pass& pass = passes[i];
+			if (pass.culled) {
+				continue;
+			}
+			for (const auto& use : pass.uses) {
+				ImageState& state = states[use.image];
+				bool hazard = ((state.access | use.access) & WRITE_ACCESS) != 0;
+				if (state.layout == use.layout && !hazard) {
+					// reads in the same layout need no barrier between them
+					state.stages |= use.stages;
+					state.access |= use.access;
+					continue;
+				}
+				if (!images[use.image].imported && firstBarriers[use.image].first == ~0u) {
+					firstBarriers[use.image] = { i, pass.barriers.barriers.size() };
+				}
+				pass.barriers.barriers.push_back({ use.image, state.layout, use.layout, state.access, use.access });
+				pass.barriers.srcStages |= state.stages;
+				pass.barriers.dstStages |= use.stages;
+				state = { use.layout, use.stages, use.access };
+			}
+		}
+
+		for (uint32_t i = 0; i < images.size(); i++) {
+			const Image& image = images[i];
+			if (!image.imported || image.import.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
+				continue;
+			}
+			const ImageState& state = states[i];
+			finalBarriers.barriers.push_back({ i, state.layout, image.import.finalLayout, state.access, image.import.finalAccess });
+			finalBarriers.srcStages |= state.stages;
+			finalBarriers.dstStages |= image.import.finalStages;
+		}
+
+		// An image's first use must wait for the previous user of its memory: the image before it in
+		// the slot, or for the first one, the slot's last image in the previous frame.
+		for (uint32_t slot = 0; slot < slotCount; slot++) {
+			std::vector<uint32_t> members;
+			for (uint32_t i = 0; i < images.size(); i++) {
+				if (images[i].slot == slot) {
+					members.push_back(i);
+				}
+			}
+			std::sort(members.begin(), members.end(), [&](uint32_t a, uint32_t b) {
+				return images[a].firstPass < images[b].firstPass;
+			});
+			for (size_t m = 0; m < members.size(); m++) {
+				uint32_t previous = members[m == 0 ? members.size() - 1 : m - 1];
+				auto [passIndex, barrierIndex] = firstBarriers[members[m]];
+				assert(passIndex != ~0u && "Render graph image in a memory slot was never used");
+				BarrierBatch& batch = passes[passIndex].barriers;
+				batch.barriers[barrierIndex].srcAccess = states[previous].access;
+				batch.srcStages |= states[previous].stages;
+			}
+		}
+	}
+
+	void VulkEngRenderGraph::createRenderPasses() {
+		for (auto& pass : passes) {
+			if (pass.renderPass != VK_NULL_HANDLE) {
+				VkRenderPass renderPass = pass.renderPass;
+				VkDevice device = vulkanDevice.device();
+				vulkanDevice.deferDestruction([device, renderPass]() { vkDestroyRenderPass(device, renderPass, nullptr); });
+				pass.renderPass = VK_NULL_HANDLE;
+			}
+		}
+		if (vulkanDevice.supportsDynamicRendering()) {
+			return;
+		}
+
+		for (auto& pass : passes) {
+			std::vector<VkAttachmentDescription> attachments;
+			std::vector<VkAttachmentReference> colorReferences;
+			std::vector<VkAttachmentReference> resolveReferences;
+			VkAttachmentReference depthReference{};
+			bool hasDepth = false;
+			for (const auto& use : pass.uses) {
+				if (!isAttachment(use.usage)) {
+					continue;
+				}
+				// the graph's barriers do every layout transition, the render pass none
+				VkAttachmentDescription attachment{};
+				attachment.format = images[use.image].format;
+				attachment.samples = images[use.image].samples;
+				attachment.loadOp = use.loadOp;
+				attachment.storeOp = use.storeOp;
+				attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachment.initialLayout = use.layout;
+				attachment.finalLayout = use.layout;
+
+				VkAttachmentReference reference{ static_cast<uint32_t>(attachments.size()), use.layout };
+				if (use.usage == Usage::ColorAttachment) {
+					colorReferences.push_back(reference);
+				}
+				else if (use.usage == Usage::ColorResolve) {
+					resolveReferences.push_back(reference);
+				}
+				else {
+					depthReference = reference;
+					hasDepth = true;
+				}
+				attachments.push_back(attachment);
+			}
+			if (attachments.empty()) {
+				continue;
+			}
+
+			VkSubpassDescription subpass{};
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+			subpass.pColorAttachments = colorReferences.data();
+			if (!resolveReferences.empty()) {
+				// one entry per color attachment, the ones without a resolve unused
+				resolveReferences.resize(colorReferences.size(), { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+				subpass.pResolveAttachments = resolveReferences.data();
+			}
+			subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+			VkRenderPassCreateInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			renderPassInfo.pAttachments = attachments.data();
+			renderPassInfo.subpassCount = 1;
+			renderPassInfo.pSubpasses = &subpass;
+
+			if (vkCreateRenderPass(vulkanDevice.device(), &renderPassInfo, nullptr, &pass.renderPass) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create render pass for render graph pass '" + pass.name + "'!");
+			}
+		}
+	}
+
+	RenderTargetInfo VulkEngRenderGraph::getRenderTarget(RenderGraphPass pass) const {
+		assert(compiled && "Cannot get a render target before the render graph is compiled");
+		RenderTargetInfo renderTarget{};
+		renderTarget.renderPass = passes[pass.index].renderPass;
+		for (const auto& use : passes[pass.index].uses) {
+			if (use.usage == Usage::ColorAttachment) {
+				renderTarget.colorFormats.push_back(images[use.image].format);
+				renderTarget.samples = images[use.image].samples;
+			}
+			else if (use.usage == Usage::DepthAttachment || use.usage == Usage::DepthRead) {
+				renderTarget.depthFormat = images[use.image].format;
+				renderTarget.samples = images[use.image].samples;
+			}
+		}
+		return renderTarget;
+	}
+
+	bool VulkEngRenderGraph::setFrameExtent(VkExtent2D extent) {
+		assert(compiled && "Cannot set the frame extent before the render graph is compiled");
+		if (extent.width == frameExtent.width && extent.height == frameExtent.height) {
+			return false;
+		}
+		frameExtent = extent;
+		for (auto& image : images) {
+			if (image.imported) {
+				image.extent = extent;
+			}
+		}
+		allocateImages();
+		updateRenderExtents();
+		return true;
+	}
+
+	void VulkEngRenderGraph::setRenderScale(float scale) {
+		renderScale = std::clamp(scale, 0.0f, 1.0f);
+		updateRenderExtents();
+	}
+
+	void VulkEngRenderGraph::updateRenderExtents() {
+		for (auto& image : images) {
+			image.renderExtent = image.extent;
+			if (!image.imported && image.desc.dynamicResolution) {
+				image.renderExtent.width = std::max(1u, static_cast<uint32_t>(image.extent.width * renderScale + 0.5f));
+				image.renderExtent.height = std::max(1u, static_cast<uint32_t>(image.extent.height * renderScale + 0.5f));
+			}
+		}
+	}
+
+	void VulkEngRenderGraph::setImportedImage(RenderGraphImage image, VkImage handle, VkImageView view) {
+		assert(images[image.index].imported && "Cannot set the handle of an image owned by the render graph");
+		Image& imported = images[image.index];
+		imported.image = handle;
+		imported.view = view;
+
+		// Swap chain images take turns, so each pair comes back every few frames. A pair not seen
+		// since the framebuffers were built means the images were replaced, and the views the
+		// cached framebuffers hold may be destroyed, or even reused by the new ones.
+		std::pair<VkImage, VkImageView> pair{ handle, view };
+		auto& recent = imported.recentImports;
+		if (std::find(recent.begin(), recent.end(), pair) == recent.end()) {
+			releaseFramebuffers();
+			recent.push_back(pair);
+			if (recent.size() > MAX_RECENT_IMPORTS) {
+				recent.erase(recent.begin());
+			}
+		}
+	}
+
+	void VulkEngRenderGraph::allocateImages() {
+		releaseImages();
+		transientMemorySize = 0;
+		unaliasedMemorySize = 0;
+
+		std::vector<std::vector<uint32_t>> slots(slotCount);
+		for (uint32_t i = 0; i < images.size(); i++) {
+			Image& image = images[i];
+			if (image.imported || image.slot == ~0u) {
+				continue;
+			}
+			image.extent = image.desc.extent;
+			if (image.extent.width == 0 || image.extent.height == 0) {
+				image.extent.width = std::max(1u, static_cast<uint32_t>(frameExtent.width * image.desc.scale));
+				image.extent.height = std::max(1u, static_cast<uint32_t>(frameExtent.height * image.desc.scale));
+			}
+
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent.width = image.extent.width;
+			imageInfo.extent.height = image.extent.height;
+			imageInfo.extent.depth = 1;
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = image.format;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.usage = image.usage | (image.lazy ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+			imageInfo.samples = image.samples;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			if (vkCreateImage(vulkanDevice.device(), &imageInfo, nullptr, &image.image) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create render graph image '" + image.name + "'!");
+			}
+			slots[image.slot].push_back(i);
+		}
+
+		auto allocate = [&](VkDeviceSize size, uint32_t memoryTypeBits, bool lazy) {
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = size;
+			if (!lazy || !vulkanDevice.tryFindMemoryType(
+				memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, allocInfo.memoryTypeIndex)) {
+				allocInfo.memoryTypeIndex = vulkanDevice.findMemoryType(memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			}
+			VkDeviceMemory memory;
+			if (vkAllocateMemory(vulkanDevice.device(), &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate render graph image memory!");
+			}
+			memories.push_back(memory);
+			transientMemorySize += size;
+			return memory;
+		};
+
+		for (uint32_t slot = 0; slot < slotCount; slot++) {
+			const auto& members = slots[slot];
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeBits = ~0u;
+			std::vector<VkMemoryRequirements> requirements(members.size());
+			for (size_t m = 0; m < members.size(); m++) {
+				vkGetImageMemoryRequirements(vulkanDevice.device(), images[members[m]].image, &requirements[m]);
+				size = std::max(size, requirements[m].size);
+				memoryTypeBits &= requirements[m].memoryTypeBits;
+				unaliasedMemorySize += requirements[m].size;
+			}
+
+			// every image is bound at offset 0, which satisfies any alignment
+			if (memoryTypeBits != 0) {
+				VkDeviceMemory memory = allocate(size, memoryTypeBits, lazySlots[slot]);
+				for (uint32_t index : members) {
+					vkBindImageMemory(vulkanDevice.device(), images[index].image, memory, 0);
+				}
+			}
+			else {
+				// no memory type suits all of them; the barriers are still correct without aliasing
+				for (size_t m = 0; m < members.size(); m++) {
+					VkDeviceMemory memory = allocate(requirements[m].size, requirements[m].memoryTypeBits, lazySlots[slot]);
+					vkBindImageMemory(vulkanDevice.device(), images[members[m]].image, memory, 0);
+				}
+			}
+		}
+
+		for (auto& image : images) {
+			if (image.imported || image.image == VK_NULL_HANDLE) {
+				continue;
+			}
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = image.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = image.format;
+			// views of combined depth/stencil formats are used for depth only
+			viewInfo.subresourceRange.aspectMask = aspectMask(image.format) & ~VK_IMAGE_ASPECT_STENCIL_BIT;
+			viewInfo.subresourceRange.baseMipLevel = 0;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = 1;
+			if (vkCreateImageView(vulkanDevice.device(), &viewInfo, nullptr, &image.view) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create render graph image view '" + image.name + "'!");
+			}
+		}
+	}
+
+	void VulkEngRenderGraph::releaseImages() {
+		VkDevice device = vulkanDevice.device();
+		for (auto& image : images) {
+			if (image.imported) {
+				continue;
+			}
+			if (image.image != VK_NULL_HANDLE || image.view != VK_NULL_HANDLE) {
+				// frames in flight may still be using them
+				VkImage handle = image.image;
+				VkImageView view = image.view;
+				vulkanDevice.deferDestruction([device, handle, view]() {
+					if (view != VK_NULL_HANDLE) {
+						vkDestroyImageView(device, view, nullptr);
+					}
+					if (handle != VK_NULL_HANDLE) {
+						vkDestroyImage(device, handle, nullptr);
+					}
+				});
+			}
+			image.image = VK_NULL_HANDLE;
+			image.view = VK_NULL_HANDLE;
+		}
+		for (VkDeviceMemory memory : memories) {
+			vulkanDevice.deferDestruction([device, memory]() { vkFreeMemory(device, memory, nullptr); });
+		}
+		memories.clear();
+		releaseFramebuffers();
+	}
+
+	void VulkEngRenderGraph::releaseFramebuffers() {
+		VkDevice device = vulkanDevice.device();
+		for (const auto& [key, framebuffer] : framebuffers) {
+			vulkanDevice.deferDestruction([device, framebuffer]() { vkDestroyFramebuffer(device, framebuffer, nullptr); });
+		}
+		framebuffers.clear();
+	}
+
+	void VulkEngRenderGraph::execute(VkCommandBuffer commandBuffer, VulkEngGpuProfiler* profiler) {
+		assert(compiled && "Cannot execute a render graph that has not been compiled");
+		assert(frameExtent.width != 0 && "Cannot execute a render graph before its frame extent is set");
+
+		for (const auto& pass : passes) {
+			if (pass.culled) {
+				continue;
+			}
+			recordBarriers(commandBuffer, pass.barriers);
+
+			auto firstAttachment = std::find_if(pass.uses.begin(), pass.uses.end(),
+				[](const ImageUse& use) { return isAttachment(use.usage); });
+			bool rendering = firstAttachment != pass.uses.end();
+			VkExtent2D extent = rendering ? images[firstAttachment->image].renderExtent : VkExtent2D{ 0, 0 };
+			uint32_t scope = profiler
+				? profiler->beginScope(commandBuffer, pass.name.c_str(), rendering, static_cast<uint64_t>(extent.width) * extent.height)
+				: VulkEngGpuProfiler::INVALID_SCOPE;
+			if (rendering) {
+				beginRendering(commandBuffer, pass, extent);
+			}
+			if (pass.execute) {
+				pass.execute(commandBuffer);
+			}
+			if (rendering) {
+				endRendering(commandBuffer, pass);
+			}
+			if (profiler) {
+				profiler->endScope(commandBuffer, scope);
+			}
+		}
+		recordBarriers(commandBuffer, finalBarriers);
+	}
+
+	void VulkEngRenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch) {
+		if (batch.barriers.empty()) {
+			return;
+		}
+		std::vector<VkImageMemoryBarrier> barriers(batch.barriers.size());
+		for (size_t i = 0; i < batch.barriers.size(); i++) {
+			const Barrier& barrier = batch.barriers[i];
+			const Image& image = images[barrier.image];
+			assert(image.image != VK_NULL_HANDLE && "Render graph image has no handle, see setImportedImage");
+			barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barriers[i].srcAccessMask = barrier.srcAccess;
+			barriers[i].dstAccessMask = barrier.dstAccess;
+			barriers[i].oldLayout = barrier.oldLayout;
+			barriers[i].newLayout = barrier.newLayout;
+			barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barriers[i].image = image.image;
+			// imported images may have mip levels, e.g. a depth pyramid
+			barriers[i].subresourceRange = { aspectMask(image.format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+		}
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			batch.srcStages != 0 ? batch.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			batch.dstStages,
+			0,
+			0, nullptr,
+			0, nullptr,
+			static_cast<uint32_t>(barriers.size()), barriers.data());
+	}
+
+	void VulkEngRenderGraph::beginRendering(VkCommandBuffer commandBuffer, const Pass& pass, VkExtent2D extent) {
+		VkRect2D renderArea{ { 0, 0 }, extent };
+
+		if (pass.renderPass == VK_NULL_HANDLE) {
+			std::vector<VkRenderingAttachmentInfo> colorAttachments;
+			std::vector<VkImageView> resolveViews;
+			VkRenderingAttachmentInfo depthAttachment{};
+			bool hasDepth = false;
+			for (const auto& use : pass.uses) {
+				if (!isAttachment(use.usage)) {
+					continue;
+				}
+				if (use.usage == Usage::ColorResolve) {
+					resolveViews.push_back(images[use.image].view);
+					continue;
+				}
+				VkRenderingAttachmentInfo attachment{};
+				attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+				attachment.imageView = images[use.image].view;
+				attachment.imageLayout = use.layout;
+				attachment.loadOp = use.loadOp;
+				attachment.storeOp = use.storeOp;
+				attachment.clearValue = use.clearValue;
+				if (use.usage == Usage::ColorAttachment) {
+					colorAttachments.push_back(attachment);
+				}
+				else {
+					depthAttachment = attachment;
+					hasDepth = true;
+				}
+			}
+			for (size_t i = 0; i < resolveViews.size(); i++) {
+				colorAttachments[i].resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+				colorAttachments[i].resolveImageView = resolveViews[i];
+				colorAttachments[i].resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			}
+
+			VkRenderingInfo renderingInfo{};
+			renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+			renderingInfo.renderArea = renderArea;
+			renderingInfo.layerCount = 1;
+			renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+			renderingInfo.pColorAttachments = colorAttachments.data();
+			renderingInfo.pDepthAttachment = hasDepth ? &depthAttachment : nullptr;
+			vkCmdBeginRendering(commandBuffer, &renderingInfo);
+		}
+		else {
+			std::vector<VkImageView> views;
+			std::vector<VkClearValue> clearValues;
+			// the whole attachment rather than the render extent, which changes with the render scale
+			VkExtent2D framebufferExtent{ 0, 0 };
+			for (const auto& use : pass.uses) {
+				if (isAttachment(use.usage)) {
+					views.push_back(images[use.image].view);
+					clearValues.push_back(use.clearValue);
+					framebufferExtent = images[use.image].extent;
+				}
+			}
+
+			// Imported views take turns from frame to frame, so the fallback keeps a framebuffer per
+			// combination; dynamic rendering avoids them altogether.
+			std::vector<uint64_t> key{ handleKey(pass.renderPass), framebufferExtent.width, framebufferExtent.height };
+			for (VkImageView view : views) {
+				key.push_back(handleKey(view));
+			}
+			VkFramebuffer& framebuffer = framebuffers[key];
+			if (framebuffer == VK_NULL_HANDLE) {
+				VkFramebufferCreateInfo framebufferInfo{};
+				framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+				framebufferInfo.renderPass = pass.renderPass;
+				framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+				framebufferInfo.pAttachments = views.data();
+				framebufferInfo.width = framebufferExtent.width;
+				framebufferInfo.height = framebufferExtent.height;
+				framebufferInfo.layers = 1;
+				if (vkCreateFramebuffer(vulkanDevice.device(), &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+					framebuffers.erase(key);
+					throw std::runtime_error("failed to create framebuffer for render graph pass '" + pass.name + "'!");
+				}
+			}
+
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = pass.renderPass;
+			renderPassInfo.framebuffer = framebuffer;
+			renderPassInfo.renderArea = renderArea;
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+			renderPassInfo.pClearValues = clearValues.data();
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		}
+
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = static_cast<float>(extent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &renderArea);
+	}
+
+	void VulkEngRenderGraph::endRendering(VkCommandBuffer commandBuffer, const Pass& pass) {
+		if (pass.renderPass == VK_NULL_HANDLE) {
+			vkCmdEndRendering(commandBuffer);
+		}
+		else {
+			vkCmdEndRenderPass(commandBuffer);
+		}
+	}
+
+	bool VulkEngRenderGraph::readsContents(const ImageUse& use) {
+		switch (use.usage) {
+		case Usage::ColorAttachment:
+		case Usage::DepthAttachment:
+			return use.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+		case Usage::ColorResolve:
+		case Usage::StorageWrite:
+		case Usage::TransferDestination:
+			return false;
+		default:
+			return true;
+		}
+	}
+
+	VkImageAspectFlags VulkEngRenderGraph::aspectMask(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+	}
+
+} // namespace VulkanEngine
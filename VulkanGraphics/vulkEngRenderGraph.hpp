@@ -0,0 +1,240 @@
+#pragma once
+
+#include "vulkEngDevice.hpp"
+#include "vulkEngPipeline.hpp"
+#include "vulkEngGpuProfiler.hpp"
+
+//std
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace VulkanEngine {
+
+	// Identify images and passes of one VulkEngRenderGraph.
+	struct RenderGraphImage {
+		uint32_t index = ~0u;
+	};
+
+	struct RenderGraphPass {
+		uint32_t index = ~0u;
+	};
+
+	// An image owned by the graph, only valid during the frame. extent 0 means the frame extent
+	// times scale. Multisampled images can only be attachments, see resolveColor. Images with
+	// dynamicResolution keep their size, but passes only render to their top left corner, scaled
+	// down by the graph's render scale (see setRenderScale), so it can change every frame without
+	// reallocating anything.
+	struct RenderGraphImageDesc {
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent{ 0, 0 };
+		float scale = 1.0f;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+		bool dynamicResolution = false;
+	};
+
+	// An image owned elsewhere, e.g. the swap chain image, with the state it is in before the frame
+	// and the one it is left in afterwards. Imported images have the frame extent.
+	struct RenderGraphImport {
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags initialStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags finalStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		VkAccessFlags finalAccess = 0;
+	};
+
+	// Frame graph of passes and the images they read and write. compile() drops passes whose
+	// results are never used, works out every layout transition and barrier, and lets graph owned
+	// images whose lifetimes do not overlap share memory. Passes run in the order they were added.
+	// Graph owned attachments that are never loaded or stored are lazily allocated where possible.
+	//
+	// Passes with attachments are begun by the graph, with dynamic rendering where the device
+	// supports it and a render pass per graph pass otherwise; pipelines drawn in a pass are created
+	// with getRenderTarget. Graph owned images are not preserved between frames: the first pass
+	// using one in a frame must write it without loading.
+	class VulkEngRenderGraph {
+
+	public:
+		class PassBuilder {
+		public:
+			PassBuilder& writeColor(RenderGraphImage image, VkAttachmentLoadOp loadOp, VkClearColorValue clearValue = {});
+			PassBuilder& writeDepth(RenderGraphImage image, VkAttachmentLoadOp loadOp, float clearDepth = 1.0f);
+			// depth tested against, but not written
+			PassBuilder& readDepth(RenderGraphImage image);
+			// Resolves the pass's multisampled color attachments, in the order they were added, into
+			// single sampled images at the end of the pass; image is overwritten.
+			PassBuilder& resolveColor(RenderGraphImage image);
+			PassBuilder& sampleImage(RenderGraphImage image, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+			PassBuilder& readStorageImage(RenderGraphImage image, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			PassBuilder& writeStorageImage(RenderGraphImage image, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			// read or written by transfer commands (copies, blits) the pass records
+			PassBuilder& transferSource(RenderGraphImage image);
+			PassBuilder& transferDestination(RenderGraphImage image);
+			// keeps the pass even if nothing uses what it writes
+			PassBuilder& setSideEffects();
+			// recorded between the pass's barriers and, for passes with attachments, inside its rendering
+			PassBuilder& setExecute(std::function<void(VkCommandBuffer)> execute);
+
+			RenderGraphPass pass() const { return { index }; }
+
+		private:
+			friend class VulkEngRenderGraph;
+			PassBuilder(VulkEngRenderGraph& graph, uint32_t index) : graph{ graph }, index{ index } {}
+
+			VulkEngRenderGraph& graph;
+			uint32_t index;
+		};
+
+		VulkEngRenderGraph(VulkEngDevice& device);
+		~VulkEngRenderGraph();
+
+		VulkEngRenderGraph(const VulkEngRenderGraph&) = delete;
+		VulkEngRenderGraph& operator=(const VulkEngRenderGraph&) = delete;
+
+		RenderGraphImage createImage(const std::string& name, const RenderGraphImageDesc& desc);
+		RenderGraphImage importImage(const std::string& name, const RenderGraphImport& import);
+		PassBuilder addPass(const std::string& name);
+
+		// Call after the last pass has been added and before getRenderTarget or execute.
+		void compile();
+		RenderTargetInfo getRenderTarget(RenderGraphPass pass) const;
+
+		// Per frame: the frame extent, which reallocates graph owned images when it changes (returns
+		// true then), the handles of every imported image, then execute outside of any rendering.
+		bool setFrameExtent(VkExtent2D extent);
+		void setImportedImage(RenderGraphImage image, VkImage handle, VkImageView view);
+		// Between 0 and 1, for images with dynamicResolution; takes effect immediately.
+		void setRenderScale(float scale);
+		float getRenderScale() const { return renderScale; }
+		void execute(VkCommandBuffer commandBuffer, VulkEngGpuProfiler* profiler = nullptr);
+
+		// valid until the next reallocation, see setFrameExtent
+		VkImageView getImageView(RenderGraphImage image) const { return images[image.index].view; }
+		VkImage getImage(RenderGraphImage image) const { return images[image.index].image; }
+		// the region passes render to this frame, the whole image unless it has dynamicResolution
+		VkExtent2D getRenderExtent(RenderGraphImage image) const { return images[image.index].renderExtent; }
+		bool isCulled(RenderGraphPass pass) const { return passes[pass.index].culled; }
+		// device memory of the graph owned images, and what it would be without aliasing
+		VkDeviceSize getTransientMemorySize() const { return transientMemorySize; }
+		VkDeviceSize getUnaliasedMemorySize() const { return unaliasedMemorySize; }
+
+	private:
+		enum class Usage {
+			ColorAttachment,
+			ColorResolve,
+			DepthAttachment,
+			DepthRead,
+			Sampled,
+			StorageRead,
+			StorageWrite,
+			TransferSource,
+			TransferDestination
+		};
+
+		struct ImageUse {
+			uint32_t image;
+			Usage usage;
+			VkPipelineStageFlags stages;
+			VkImageLayout layout;
+			VkAccessFlags access;
+			VkAttachmentLoadOp loadOp;
+			VkAttachmentStoreOp storeOp;
+			VkClearValue clearValue;
+		};
+
+		struct ImageState {
+			VkImageLayout layout;
+			VkPipelineStageFlags stages;
+			VkAccessFlags access;
+		};
+
+		struct Barrier {
+			uint32_t image;
+			VkImageLayout oldLayout;
+			VkImageLayout newLayout;
+			VkAccessFlags srcAccess;
+			VkAccessFlags dstAccess;
+		};
+
+		struct BarrierBatch {
+			std::vector<Barrier> barriers;
+			VkPipelineStageFlags srcStages = 0;
+			VkPipelineStageFlags dstStages = 0;
+		};
+
+		struct Pass {
+			std::string name;
+			std::vector<ImageUse> uses;
+			std::function<void(VkCommandBuffer)> execute;
+			bool sideEffects = false;
+			bool culled = false;
+			BarrierBatch barriers;
+			// render pass fallback only
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+		};
+
+		struct Image {
+			std::string name;
+			bool imported;
+			VkFormat format;
+			VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+			RenderGraphImageDesc desc;
+			RenderGraphImport import;
+			VkImageUsageFlags usage = 0;
+			// kept passes using the image, ~0u when none does
+			uint32_t firstPass = ~0u;
+			uint32_t lastPass = 0;
+			// graph owned images in one slot share memory
+			uint32_t slot = ~0u;
+			// contents never leave the passes using it, so it can live in lazily allocated memory
+			bool lazy = false;
+			VkExtent2D extent{};
+			VkExtent2D renderExtent{};
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			// imported handle pairs set since the framebuffers were last released, oldest first
+			std::vector<std::pair<VkImage, VkImageView>> recentImports;
+		};
+
+		PassBuilder& addUse(PassBuilder& builder, RenderGraphImage image, Usage usage, VkPipelineStageFlags stages,
+			VkAttachmentLoadOp loadOp, VkClearValue clearValue);
+		void validateSampleCounts() const;
+		void cullPasses();
+		void assignSlots();
+		void compileBarriers();
+		void createRenderPasses();
+		void allocateImages();
+		void releaseImages();
+		void releaseFramebuffers();
+		void updateRenderExtents();
+		void recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch);
+		void beginRendering(VkCommandBuffer commandBuffer, const Pass& pass, VkExtent2D extent);
+		void endRendering(VkCommandBuffer commandBuffer, const Pass& pass);
+
+		static bool isAttachment(Usage usage) {
+			return usage == Usage::ColorAttachment || usage == Usage::ColorResolve || usage == Usage::DepthAttachment || usage == Usage::DepthRead;
+		}
+		static bool readsContents(const ImageUse& use);
+		static VkImageAspectFlags aspectMask(VkFormat format);
+
+		VulkEngDevice& vulkanDevice;
+		std::vector<Image> images;
+		std::vector<Pass> passes;
+		BarrierBatch finalBarriers;
+		bool compiled = false;
+
+		uint32_t slotCount = 0;
+		std::vector<bool> lazySlots;
+		std::vector<VkDeviceMemory> memories;
+		// render pass fallback only, by render pass, extent and attachment views
+		std::map<std::vector<uint64_t>, VkFramebuffer> framebuffers;
+		VkExtent2D frameExtent{ 0, 0 };
+		float renderScale = 1.0f;
+		VkDeviceSize transientMemorySize = 0;
+		VkDeviceSize unaliasedMemorySize = 0;
+	};
+
+} // namespace VulkanEngine
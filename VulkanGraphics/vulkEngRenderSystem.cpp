@@ -1,12 +1,14 @@
 #include "vulkEngRenderSystem.hpp"
+#include "vulkEngCpuProfiler.hpp"
+#include "vulkEngLayoutCache.hpp"
 
 //libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
-#include <glm/gtc/constants.hpp>
 
 //std
+#include <cassert>
 #include <stdexcept>
 #include <array>
 #include <vector>
@@ -19,82 +21,141 @@ namespace VulkanEngine
 		alignas(16) glm::vec3 color;
 	};
 
-	VulkEngRenderSystem::VulkEngRenderSystem(VulkEngDevice& device, VkRenderPass renderPass) : vulkanDevice{ device }
+	constexpr const char* VERT_SHADER_PATH = "shaders/simpleShader.vert.spv";
+	constexpr const char* FRAG_SHADER_PATH = "shaders/simpleShader.frag.spv";
+	// declares the same push constant block, so it shares the pipeline layout
+	constexpr const char* DEPTH_ONLY_VERT_SHADER_PATH = "shaders/depthOnly.vert.spv";
+
+	VulkEngRenderSystem::VulkEngRenderSystem(
+		VulkEngDevice& device,
+		const RenderTargetInfo& renderTarget,
+		VulkEngGpuProfiler& profiler,
+		const RenderSystemConfig& config
+	) : vulkanDevice{ device }, gpuProfiler{ profiler }, config{ config }
 	{
 		createPipelineLayout();
-		createPipeline(renderPass);
+		createPipeline(renderTarget);
+		if (config.depthPrepass) {
+			createDepthPrepassPipeline();
+		}
 	}
 
-	VulkEngRenderSystem::~VulkEngRenderSystem()
-	{
-		vkDestroyPipelineLayout(vulkanDevice.device(), pipelineLayout, nullptr);
-	}
+	VulkEngRenderSystem::~VulkEngRenderSystem() {}
 
 	void VulkEngRenderSystem::createPipelineLayout() {
-
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(SimplePushConstantData);
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 0;
-		pipelineLayoutInfo.pSetLayouts = nullptr;
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-		if (vkCreatePipelineLayout(
-			vulkanDevice.device(),
-			&pipelineLayoutInfo,
-			nullptr,
-			&pipelineLayout
-		) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create pipeline layout!");
-		}
+		// the layout is derived from the shaders and checked against SimplePushConstantData
+		auto vertShader = vulkanDevice.shaderCache().loadModule(VERT_SHADER_PATH);
+		auto fragShader = vulkanDevice.shaderCache().loadModule(FRAG_SHADER_PATH);
+		ReflectedLayout layout = vulkanDevice.layoutCache().getReflectedLayout(
+			{ &vertShader->getReflection(), &fragShader->getReflection() },
+			sizeof(SimplePushConstantData));
+		pipelineLayout = layout.pipelineLayout;
+		pushConstantStages = layout.pushConstantStages;
 	}
 
-	void VulkEngRenderSystem::createPipeline(VkRenderPass renderPass) {
+	void VulkEngRenderSystem::createPipeline(const RenderTargetInfo& renderTarget) {
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
-		PipelineConfigInfo pipelineConfig{};
-		VulkEngPipeline::defaultPipelineConfigInfo(
-			pipelineConfig
+		VkPipelineLayout layout = pipelineLayout;
+		VkCullModeFlags cullMode = config.cullMode;
+		bool depthPrepass = config.depthPrepass;
+		pipelineVariants = std::make_unique<VulkEngPipelineVariants>(
+			vulkanDevice,
+			VERT_SHADER_PATH,
+			FRAG_SHADER_PATH,
+			[renderTarget, layout, cullMode, depthPrepass](PipelineConfigInfo& pipelineConfig) {
+				VulkEngPipeline::defaultPipelineConfigInfo(pipelineConfig);
+				pipelineConfig.rasterizationInfo.cullMode = cullMode;
+				if (depthPrepass) {
+					// only the nearest surface, laid down by the prepass, passes
+					pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+					pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+				}
+				pipelineConfig.renderTarget = renderTarget;
+				pipelineConfig.pipelineLayout = layout;
+			}
 		);
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout;
-		vulkEngPipeline = std::make_unique<VulkEngPipeline>(
+		activePipeline = &pipelineVariants->get();
+	}
+
+	void VulkEngRenderSystem::createDepthPrepassPipeline() {
+		assert(
+			config.depthPrepassTarget.depthFormat != VK_FORMAT_UNDEFINED && config.depthPrepassTarget.colorFormats.empty() &&
+			"Cannot create depth prepass pipeline: the prepass must render into a depth attachment only");
+
+		VkPipelineLayout layout = pipelineLayout;
+		VkCullModeFlags cullMode = config.cullMode;
+		RenderTargetInfo renderTarget = config.depthPrepassTarget;
+		depthPrepassVariants = std::make_unique<VulkEngPipelineVariants>(
 			vulkanDevice,
-			"shaders/simpleShader.vert.spv",
-			"shaders/simpleShader.frag.spv",
-			pipelineConfig
+			DEPTH_ONLY_VERT_SHADER_PATH,
+			"",
+			[renderTarget, layout, cullMode](PipelineConfigInfo& pipelineConfig) {
+				VulkEngPipeline::defaultPipelineConfigInfo(pipelineConfig);
+				pipelineConfig.rasterizationInfo.cullMode = cullMode;
+				pipelineConfig.bindingDescriptions = VulkEngModel::Vertex::getPositionBindingDescriptions();
+				pipelineConfig.attributeDescriptions = VulkEngModel::Vertex::getPositionAttributeDescriptions();
+				pipelineConfig.colorBlendInfo.attachmentCount = 0;
+				pipelineConfig.renderTarget = renderTarget;
+				pipelineConfig.pipelineLayout = layout;
+			}
 		);
+		depthPrepassPipeline = &depthPrepassVariants->get();
+	}
+
+	void VulkEngRenderSystem::setShaderFeatures(const SpecializationConstants& features) {
+		activePipeline = &pipelineVariants->get(features);
+	}
+
+	void VulkEngRenderSystem::prepareFrame(VulkEngJobSystem& jobSystem, const std::vector<VulkEngGameObj>& gameObjects) {
+		VulkEngCpuScope cpuScope{ "render system prepareFrame" };
+		objectTransforms.resize(gameObjects.size());
+		jobSystem.parallelFor("objectTransforms", static_cast<uint32_t>(gameObjects.size()), VulkEngJobSystem::DEFAULT_GRAIN_SIZE,
+			[this, &gameObjects](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++) {
+					// mat4() is not const, it is computed from a copy
+					TransformComponent transform = gameObjects[i].transform;
+					objectTransforms[i] = transform.mat4();
+				}
+			});
 	}
 
 	void VulkEngRenderSystem::renderGameObjects(VkCommandBuffer commandBuffer, std::vector<VulkEngGameObj>& gameObjects) {
-		int i = 0;
-		for (auto& obj : gameObjects) {
-			i += 1;
-			obj.transform.rotationRadians.y =
-				glm::mod<float>(obj.transform.rotationRadians.y + 0.001f * i, 2.f * glm::pi<float>());
-			obj.transform.rotationRadians.x =
-				glm::mod<float>(obj.transform.rotationRadians.x + 0.001f * i, 2.f * glm::pi<float>());
+		assert(objectTransforms.size() == gameObjects.size() && "Game objects changed since prepareFrame");
+		VulkEngCpuScope cpuScope{ "renderGameObjects" };
+		VulkEngGpuScope scope{ gpuProfiler, commandBuffer, "game objects" };
+		activePipeline->bind(commandBuffer);
+		for (size_t i = 0; i < gameObjects.size(); i++) {
+			pushObjectConstants(commandBuffer, gameObjects[i], objectTransforms[i]);
+			gameObjects[i].model->bind(commandBuffer);
+			gameObjects[i].model->draw(commandBuffer);
 		}
+	}
 
-		vulkEngPipeline->bind(commandBuffer);
-		for (auto& obj : gameObjects) {
-			SimplePushConstantData push{};
-			push.color = obj.color;
-			push.transform = obj.transform.mat4();
-
-			vkCmdPushConstants(
-				commandBuffer,
-				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof(SimplePushConstantData),
-				&push);
-			obj.model->bind(commandBuffer);
-			obj.model->draw(commandBuffer);
+	void VulkEngRenderSystem::renderDepthPrepass(VkCommandBuffer commandBuffer, std::vector<VulkEngGameObj>& gameObjects) {
+		assert(depthPrepassPipeline != nullptr && "Cannot render a depth prepass the render system was not configured for");
+		VulkEngCpuScope cpuScope{ "renderDepthPrepass" };
+		VulkEngGpuScope scope{ gpuProfiler, commandBuffer, "game object depth" };
+		assert(objectTransforms.size() == gameObjects.size() && "Game objects changed since prepareFrame");
+		depthPrepassPipeline->bind(commandBuffer);
+		for (size_t i = 0; i < gameObjects.size(); i++) {
+			pushObjectConstants(commandBuffer, gameObjects[i], objectTransforms[i]);
+			gameObjects[i].model->bindPositions(commandBuffer);
+			gameObjects[i].model->draw(commandBuffer);
 		}
 	}
+
+	void VulkEngRenderSystem::pushObjectConstants(VkCommandBuffer commandBuffer, const VulkEngGameObj& obj, const glm::mat4& transform) {
+		SimplePushConstantData push{};
+		push.color = obj.color;
+		push.transform = transform;
+
+		vkCmdPushConstants(
+			commandBuffer,
+			pipelineLayout,
+			pushConstantStages,
+			0,
+			sizeof(SimplePushConstantData),
+			&push);
+	}
 } // namespace VulkanEngine
\ No newline at end of file
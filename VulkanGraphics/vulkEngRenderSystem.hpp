@@ -1,8 +1,10 @@
 #pragma once
 
-#include "vulkEngPipeline.hpp"
+#include "vulkEngPipelineVariants.hpp"
 #include "vulkEngDevice.hpp"
 #include "vulkEngGameObj.hpp"
+#include "vulkEngGpuProfiler.hpp"
+#include "vulkEngJobSystem.hpp"
 
 //std
 #include <memory>
@@ -10,25 +12,65 @@
 
 namespace VulkanEngine {
 
+	// constant_id of the feature toggles simpleShader declares, for setShaderFeatures
+	constexpr uint32_t SHADER_FEATURE_OBJECT_COLOR = 0;
+
+	struct RenderSystemConfig {
+		VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+		// Lays depth down first with renderDepthPrepass, drawing into depthPrepassTarget; the shading
+		// pipelines then test EQUAL without writing depth, so every pixel is shaded once.
+		bool depthPrepass = false;
+		RenderTargetInfo depthPrepassTarget;
+	};
+
 	class VulkEngRenderSystem {
 
 	public:
-		VulkEngRenderSystem(VulkEngDevice& device, VkRenderPass renderPass);
+		VulkEngRenderSystem(
+			VulkEngDevice& device,
+			const RenderTargetInfo& renderTarget,
+			VulkEngGpuProfiler& profiler,
+			const RenderSystemConfig& config = {});
 		~VulkEngRenderSystem();
 
 		VulkEngRenderSystem(const VulkEngRenderSystem&) = delete;
 		VulkEngRenderSystem& operator=(const VulkEngRenderSystem&) = delete;
 
+		// Per frame, before the graph executes: computes the objects' transforms across the job system's
+		// threads, so recording only copies them into push constants. gameObjects must not change until
+		// the frame has been recorded.
+		void prepareFrame(VulkEngJobSystem& jobSystem, const std::vector<VulkEngGameObj>& gameObjects);
+
 		void renderGameObjects(VkCommandBuffer commandBuffer, std::vector<VulkEngGameObj> &gameObjects);
+		// Only with config.depthPrepass, in a pass before the one rendering the game objects. The
+		// models must have been created with a position stream.
+		void renderDepthPrepass(VkCommandBuffer commandBuffer, std::vector<VulkEngGameObj> &gameObjects);
+
+		// Selects the pipeline variant specialized with these constants, building it if needed.
+		void setShaderFeatures(const SpecializationConstants& features);
+		VulkEngPipelineVariants& getPipelineVariants() { return *pipelineVariants; }
+		// null without a depth prepass
+		VulkEngPipelineVariants* getDepthPrepassVariants() { return depthPrepassVariants.get(); }
 
 	private:
 		void createPipelineLayout();
-		void createPipeline(VkRenderPass renderPass);
+		void createPipeline(const RenderTargetInfo& renderTarget);
+		void createDepthPrepassPipeline();
+		void pushObjectConstants(VkCommandBuffer commandBuffer, const VulkEngGameObj& obj, const glm::mat4& transform);
 
 		VulkEngDevice& vulkanDevice;
+		VulkEngGpuProfiler& gpuProfiler;
+		RenderSystemConfig config;
 
-		std::unique_ptr<VulkEngPipeline> vulkEngPipeline;
+		std::unique_ptr<VulkEngPipelineVariants> pipelineVariants;
+		VulkEngPipeline* activePipeline = nullptr;
+		std::unique_ptr<VulkEngPipelineVariants> depthPrepassVariants;
+		VulkEngPipeline* depthPrepassPipeline = nullptr;
+		// owned by the device's layout cache
 		VkPipelineLayout pipelineLayout;
+		VkShaderStageFlags pushConstantStages;
+		// of the objects prepareFrame was given, in order
+		std::vector<glm::mat4> objectTransforms;
 	};
 
 } // namespace VulkanEngine
\ No newline at end of file
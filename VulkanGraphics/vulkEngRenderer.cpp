@@ -1,4 +1,5 @@
 #include "vulkEngRenderer.hpp"
+#include "vulkEngCpuProfiler.hpp"
 
 //std
 #include <stdexcept>
@@ -7,8 +8,18 @@
 
 namespace VulkanEngine
 {
-	VulkEngRenderer::VulkEngRenderer(VulkEngWindow& window, VulkEngDevice& device) 
-		: vulkanWindow{ window }, vulkanDevice{ device }
+	VulkEngRenderer::VulkEngRenderer(
+		VulkEngWindow& window,
+		VulkEngDevice& device,
+		PresentPolicy policy,
+		uint32_t msaaSamples,
+		bool swapChainPass
+	) : vulkanWindow{ window },
+		vulkanDevice{ device },
+		gpuProfiler{ device, VulkEngSwapChain::MAX_FRAMES_IN_FLIGHT },
+		presentPolicy{ policy },
+		sampleCount{ device.getUsableSampleCount(msaaSamples) },
+		swapChainPass{ swapChainPass }
 	{
 		recreateSwapChain();
 		createCommandBuffers();
@@ -16,25 +27,35 @@ namespace VulkanEngine
 
 	VulkEngRenderer::~VulkEngRenderer() { freeCommandBuffers(); }
 
-	void VulkEngRenderer::recreateSwapChain() {
+	bool VulkEngRenderer::recreateSwapChain() {
+		VulkEngCpuScope scope{ "recreateSwapChain" };
 		auto extent = vulkanWindow.getExtent();
-		while (extent.width == 0 || extent.height == 0) {
-			extent = vulkanWindow.getExtent();
-			glfwWaitEvents();
+		if (vulkSwapChain == nullptr) {
+			while (extent.width == 0 || extent.height == 0) {
+				vulkanWindow.waitEvents();
+				extent = vulkanWindow.getExtent();
+			}
+			vulkSwapChain = std::make_unique<VulkEngSwapChain>(vulkanDevice, extent, presentPolicy, sampleCount, swapChainPass);
+			return true;
 		}
 
-		vkDeviceWaitIdle(vulkanDevice.device());
-
-		if (vulkSwapChain == nullptr) {
-			vulkSwapChain = std::make_unique<VulkEngSwapChain>(vulkanDevice, extent);
+		// minimized, try again on a later frame
+		if (extent.width == 0 || extent.height == 0) {
+			swapChainOutOfDate = true;
+			return false;
 		}
-		else {
-			std::shared_ptr<VulkEngSwapChain> oldSwapChain = std::move(vulkSwapChain);
-			vulkSwapChain = std::make_unique<VulkEngSwapChain>(vulkanDevice, extent, oldSwapChain);
-			 if (!oldSwapChain->compareSwapFormats(*vulkSwapChain.get())) {
-				 throw std::runtime_error("Swap chain image or depth format has changed!");
-			 }
+
+		std::shared_ptr<VulkEngSwapChain> oldSwapChain = std::move(vulkSwapChain);
+		vulkSwapChain = std::make_unique<VulkEngSwapChain>(
+			vulkanDevice, extent, presentPolicy, sampleCount, swapChainPass, oldSwapChain);
+		if (!oldSwapChain->compareSwapFormats(*vulkSwapChain.get())) {
+			throw std::runtime_error("Swap chain image or depth format has changed!");
 		}
+
+		// frames still in flight may reference the old swap chain's images and framebuffers
+		vulkanDevice.deferDestruction([retired = std::move(oldSwapChain)]() mutable { retired.reset(); });
+		swapChainOutOfDate = false;
+		return true;
 	}
 
 	void VulkEngRenderer::createCommandBuffers() {
@@ -74,10 +95,35 @@ namespace VulkanEngine
 		commandBuffers.clear();
 	}
 
+	void VulkEngRenderer::setPresentPolicy(PresentPolicy policy) {
+		if (policy != presentPolicy) {
+			presentPolicy = policy;
+			presentPolicyChanged = true;
+		}
+	}
+
 	VkCommandBuffer VulkEngRenderer::beginFrame() {
+		VulkEngCpuScope scope{ "beginFrame" };
 		assert(!isFrameStarted && "Cannot call beginFrame while already in progress");
 
+		if (presentPolicyChanged) {
+			presentPolicyChanged = false;
+			swapChainOutOfDate = true;
+		}
+		if (swapChainOutOfDate && !recreateSwapChain()) {
+			return nullptr;
+		}
+
 		VkResult result = vulkSwapChain->acquireNextImage(&currentImageIndex);
+
+		// acquireNextImage waited on this frame slot's fence, so every frame submitted
+		// MAX_FRAMES_IN_FLIGHT or more frames ago has finished on the GPU
+		constexpr uint64_t framesInFlight = VulkEngSwapChain::MAX_FRAMES_IN_FLIGHT;
+		uint64_t submittedFrames = vulkanDevice.getSubmittedFrameCount();
+		if (submittedFrames + 1 > framesInFlight) {
+			vulkanDevice.releaseCompletedFrames(submittedFrames + 1 - framesInFlight);
+		}
+
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			recreateSwapChain();
 			return nullptr;
@@ -97,16 +143,22 @@ namespace VulkanEngine
 		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
 			throw std::runtime_error("failed to begin recording command buffer!");
 		}
+
+		gpuProfiler.beginFrame(commandBuffer, static_cast<uint32_t>(currentFrameIndex));
+		frameScope = gpuProfiler.beginScope(commandBuffer, "frame");
 		return commandBuffer;
 	}
 	void VulkEngRenderer::endFrame() {
+		VulkEngCpuScope scope{ "endFrame" };
 		assert(isFrameStarted && "Cannot call endFrame while frame not in progress");
 		VkCommandBuffer commandBuffer = getCurrentCommandBuffer();
+		gpuProfiler.endScope(commandBuffer, frameScope);
 		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
 			throw std::runtime_error("failed to record command buffer!");
 		}
 
 		auto result = vulkSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+		vulkanDevice.markFrameSubmitted();
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || vulkanWindow.wasWindowResized()) {
 			vulkanWindow.resetWindowResizedFlag();
 			recreateSwapChain();
@@ -121,22 +173,32 @@ namespace VulkanEngine
 	void VulkEngRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
 		assert(isFrameStarted && "Cannot call beginSwapChainRenderPass if frame not in progress");
 		assert(commandBuffer == getCurrentCommandBuffer() && "Cannot begin render pass on command buffer from a different frame");
-
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = vulkSwapChain->getRenderPass();
-		renderPassInfo.framebuffer = vulkSwapChain->getFrameBuffer(currentImageIndex);
-
-		renderPassInfo.renderArea.offset = { 0, 0 };
-		renderPassInfo.renderArea.extent = vulkSwapChain->getSwapChainExtent();
+		assert(swapChainPass && "Cannot begin the swap chain render pass of a renderer created without it");
 
 		std::array<VkClearValue, 2> clearValues{};
 		clearValues[0].color = { {0.01f, 0.01f, 0.01f, 1.0f} };
 		clearValues[1].depthStencil = { 1.0f, 0 };
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
 
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkExtent2D extent = vulkSwapChain->getSwapChainExtent();
+		renderPassScope = gpuProfiler.beginScope(
+			commandBuffer, "swap chain pass", true, static_cast<uint64_t>(extent.width) * extent.height);
+		if (vulkSwapChain->usesDynamicRendering()) {
+			beginSwapChainRendering(commandBuffer, clearValues);
+		}
+		else {
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = vulkSwapChain->getRenderPass();
+			renderPassInfo.framebuffer = vulkSwapChain->getFrameBuffer(currentImageIndex, currentFrameIndex);
+
+			renderPassInfo.renderArea.offset = { 0, 0 };
+			renderPassInfo.renderArea.extent = vulkSwapChain->getSwapChainExtent();
+
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+			renderPassInfo.pClearValues = clearValues.data();
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		}
 
 		VkViewport viewport{};
 		viewport.x = 0.0f;
@@ -155,7 +217,151 @@ namespace VulkanEngine
 		assert(isFrameStarted && "Cannot call endSwapChainRenderPass if frame not in progress");
 		assert(commandBuffer == getCurrentCommandBuffer() && "Cannot end render pass on command buffer from a different frame");
 
-		vkCmdEndRenderPass(commandBuffer);
+		if (vulkSwapChain->usesDynamicRendering()) {
+			endSwapChainRendering(commandBuffer);
+		}
+		else {
+			vkCmdEndRenderPass(commandBuffer);
+		}
+		gpuProfiler.endScope(commandBuffer, renderPassScope);
+	}
+
+	RenderGraphImage VulkEngRenderer::importSwapChain(VulkEngRenderGraph& graph) const {
+		bool headless = vulkanDevice.isHeadless();
+		RenderGraphImport import{};
+		import.format = vulkSwapChain->getSwapChainImageFormat();
+		import.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// where the submission waits for the image to be acquired
+		import.initialStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		import.finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		import.finalStages = headless ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		import.finalAccess = headless ? VK_ACCESS_TRANSFER_READ_BIT : 0;
+		return graph.importImage("swap chain", import);
+	}
+
+	void VulkEngRenderer::executeRenderGraph(VkCommandBuffer commandBuffer, VulkEngRenderGraph& graph, RenderGraphImage swapChainImage) {
+		assert(isFrameStarted && "Cannot execute a render graph if frame not in progress");
+		assert(commandBuffer == getCurrentCommandBuffer() && "Cannot execute a render graph on command buffer from a different frame");
+
+		graph.setFrameExtent(vulkSwapChain->getSwapChainExtent());
+		graph.setImportedImage(
+			swapChainImage,
+			vulkSwapChain->getImage(currentImageIndex),
+			vulkSwapChain->getImageView(currentImageIndex));
+		graph.execute(commandBuffer, &gpuProfiler);
+	}
+
+	RenderTargetInfo VulkEngRenderer::getSwapChainRenderTarget() const {
+		assert(swapChainPass && "Cannot target the swap chain render pass of a renderer created without it");
+		RenderTargetInfo renderTarget{};
+		renderTarget.renderPass = vulkSwapChain->getRenderPass();
+		renderTarget.colorFormats = { vulkSwapChain->getSwapChainImageFormat() };
+		renderTarget.depthFormat = vulkSwapChain->getSwapChainDepthFormat();
+		renderTarget.samples = sampleCount;
+		return renderTarget;
+	}
+
+	// The layout transitions and dependencies below are the ones the classic render pass declares
+	// through its attachment layouts and external subpass dependency.
+	void VulkEngRenderer::beginSwapChainRendering(VkCommandBuffer commandBuffer, const std::array<VkClearValue, 2>& clearValues) {
+		VkFormat depthFormat = vulkSwapChain->getSwapChainDepthFormat();
+		bool hasStencil = depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT;
+
+		// every attachment is cleared or resolved into, so their previous contents can be discarded
+		std::array<VkImageMemoryBarrier, 3> barriers{};
+		barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barriers[0].srcAccessMask = 0;
+		barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].image = vulkSwapChain->getImage(currentImageIndex);
+		barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		barriers[1] = barriers[0];
+		barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		barriers[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		barriers[1].image = vulkSwapChain->getDepthImage(currentFrameIndex);
+		barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+		// the multisampled color image may be shared with the previous frame, like depth
+		barriers[2] = barriers[0];
+		barriers[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		bool multisampled = vulkSwapChain->usesMultisampling();
+		if (multisampled) {
+			barriers[2].image = vulkSwapChain->getColorImage(currentFrameIndex);
+		}
+
+		// COLOR_ATTACHMENT_OUTPUT is also where the submission waits for the image to be acquired
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			multisampled ? 3 : 2, barriers.data());
+
+		VkRenderingAttachmentInfo colorAttachment{};
+		colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		colorAttachment.imageView = vulkSwapChain->getImageView(currentImageIndex);
+		colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.clearValue = clearValues[0];
+		if (multisampled) {
+			// the samples are averaged into the swap chain image as the rendering ends
+			colorAttachment.imageView = vulkSwapChain->getColorImageView(currentFrameIndex);
+			colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+			colorAttachment.resolveImageView = vulkSwapChain->getImageView(currentImageIndex);
+			colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		}
+
+		VkRenderingAttachmentInfo depthAttachment{};
+		depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		depthAttachment.imageView = vulkSwapChain->getDepthImageView(currentFrameIndex);
+		depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.clearValue = clearValues[1];
+
+		VkRenderingInfo renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+		renderingInfo.renderArea.offset = { 0, 0 };
+		renderingInfo.renderArea.extent = vulkSwapChain->getSwapChainExtent();
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+		renderingInfo.pDepthAttachment = &depthAttachment;
+
+		vkCmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+
+	void VulkEngRenderer::endSwapChainRendering(VkCommandBuffer commandBuffer) {
+		vkCmdEndRendering(commandBuffer);
+
+		// headless images are read back with transfers instead of being presented
+		bool headless = vulkanDevice.isHeadless();
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		barrier.dstAccessMask = headless ? VK_ACCESS_TRANSFER_READ_BIT : 0;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		barrier.newLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = vulkSwapChain->getImage(currentImageIndex);
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			headless ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
 	}
 
 } // namespace VulkanEngine
\ No newline at end of file
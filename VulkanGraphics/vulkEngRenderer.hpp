@@ -3,8 +3,12 @@
 #include "vulkEngWindow.hpp"
 #include "vulkEngDevice.hpp"
 #include "vulkEngSwapChain.hpp"
+#include "vulkEngPipeline.hpp"
+#include "vulkEngRenderGraph.hpp"
+#include "vulkEngGpuProfiler.hpp"
 
 //std
+#include <array>
 #include <memory>
 #include <vector>
 #include <cassert>
@@ -14,15 +18,35 @@ namespace VulkanEngine {
 	class VulkEngRenderer {
 
 	public:
-		VulkEngRenderer(VulkEngWindow& window, VulkEngDevice& device);
+		// msaaSamples is capped to what the device supports, see getSampleCount. Renderers that only
+		// execute render graphs pass swapChainPass false, so the swap chain does not allocate the
+		// attachments beginSwapChainRenderPass draws into.
+		VulkEngRenderer(
+			VulkEngWindow& window,
+			VulkEngDevice& device,
+			PresentPolicy policy = PresentPolicy::LowLatency,
+			uint32_t msaaSamples = 1,
+			bool swapChainPass = true);
 		~VulkEngRenderer();
 
 		VulkEngRenderer(const VulkEngRenderer&) = delete;
 		VulkEngRenderer& operator=(const VulkEngRenderer&) = delete;
 
 		VkRenderPass getSwapChainRenderPass() const { return vulkSwapChain->getRenderPass(); }
+		// for pipelines drawn between beginSwapChainRenderPass and endSwapChainRenderPass
+		RenderTargetInfo getSwapChainRenderTarget() const;
 		bool isFrameInProgress() const { return isFrameStarted; }
 
+		// The new policy takes effect at the start of the next frame.
+		void setPresentPolicy(PresentPolicy policy);
+		PresentPolicy getPresentPolicy() const { return presentPolicy; }
+		VkPresentModeKHR getPresentMode() const { return vulkSwapChain->getPresentMode(); }
+		size_t getSwapChainImageCount() const { return vulkSwapChain->imageCount(); }
+		VkExtent2D getSwapChainExtent() const { return vulkSwapChain->getSwapChainExtent(); }
+		VulkEngGpuProfiler& getGpuProfiler() { return gpuProfiler; }
+		// of the swap chain pass; render graphs create their multisampled images with it
+		VkSampleCountFlagBits getSampleCount() const { return sampleCount; }
+
 		VkCommandBuffer getCurrentCommandBuffer() const {
 			assert(isFrameStarted && "Cannot get command buffer when frame not in progress");
 			return commandBuffers[currentFrameIndex];
@@ -38,19 +62,47 @@ namespace VulkanEngine {
 		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+		// The swap chain image as a render graph import, left ready to be presented (read back when
+		// headless). Its handle is bound to the acquired image by executeRenderGraph.
+		RenderGraphImage importSwapChain(VulkEngRenderGraph& graph) const;
+		VkFormat getSwapChainDepthFormat() const { return vulkSwapChain->getSwapChainDepthFormat(); }
+		VkFormat getSwapChainImageFormat() const { return vulkSwapChain->getSwapChainImageFormat(); }
+		// whether graph passes may write the swap chain image with transferDestination
+		bool canTransferToSwapChain() const {
+			return (vulkSwapChain->getImageUsage() & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+		}
+		// whether graph passes may read the swap chain image with transferSource
+		bool canReadBackSwapChain() const {
+			return (vulkSwapChain->getImageUsage() & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+		}
+		// Records graph into the current frame, instead of beginSwapChainRenderPass and endSwapChainRenderPass.
+		void executeRenderGraph(VkCommandBuffer commandBuffer, VulkEngRenderGraph& graph, RenderGraphImage swapChainImage);
+
 	private:
 		void createCommandBuffers();
 		void freeCommandBuffers();
-		void recreateSwapChain();
+		bool recreateSwapChain();
+		void beginSwapChainRendering(VkCommandBuffer commandBuffer, const std::array<VkClearValue, 2>& clearValues);
+		void endSwapChainRendering(VkCommandBuffer commandBuffer);
 
 		VulkEngWindow& vulkanWindow;
 		VulkEngDevice& vulkanDevice;
 		std::unique_ptr<VulkEngSwapChain> vulkSwapChain;
 		std::vector<VkCommandBuffer> commandBuffers;
+		bool swapChainOutOfDate = false;
+
+		VulkEngGpuProfiler gpuProfiler;
+		uint32_t frameScope = VulkEngGpuProfiler::INVALID_SCOPE;
+		uint32_t renderPassScope = VulkEngGpuProfiler::INVALID_SCOPE;
+
+		PresentPolicy presentPolicy;
+		bool presentPolicyChanged = false;
+		VkSampleCountFlagBits sampleCount;
+		bool swapChainPass;
 
-		uint32_t currentImageIndex;
-		int currentFrameIndex;
-		bool isFrameStarted;
+		uint32_t currentImageIndex = 0;
+		int currentFrameIndex = 0;
+		bool isFrameStarted = false;
 	};
 
 } // namespace VulkanEngine
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "vulkEngSamplerCache.hpp"
+
+//std
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace VulkanEngine {
+
+	namespace {
+		uint32_t floatBits(float value) {
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+	}
+
+	VulkEngSamplerCache::VulkEngSamplerCache(VkDevice device, float maxAnisotropy)
+		: device{ device }, maxAnisotropy{ maxAnisotropy } {}
+
+	VulkEngSamplerCache::~VulkEngSamplerCache() {
+		for (auto& [key, sampler] : samplers) {
+			vkDestroySampler(device, sampler, nullptr);
+		}
+	}
+
+	VkSampler VulkEngSamplerCache::getSampler(const VkSamplerCreateInfo& samplerInfo) {
+		if (samplerInfo.pNext != nullptr) {
+			throw std::runtime_error("failed to cache sampler: pNext chains are not supported!");
+		}
+
+		VkSamplerCreateInfo info = samplerInfo;
+		info.maxAnisotropy = info.anisotropyEnable == VK_TRUE ? std::clamp(info.maxAnisotropy, 1.0f, maxAnisotropy) : 1.0f;
+
+		std::vector<uint32_t> key{
+			static_cast<uint32_t>(info.flags),
+			static_cast<uint32_t>(info.magFilter),
+			static_cast<uint32_t>(info.minFilter),
+			static_cast<uint32_t>(info.mipmapMode),
+			static_cast<uint32_t>(info.addressModeU),
+			static_cast<uint32_t>(info.addressModeV),
+			static_cast<uint32_t>(info.addressModeW),
+			floatBits(info.mipLodBias),
+			info.anisotropyEnable,
+			floatBits(info.maxAnisotropy),
+			info.compareEnable,
+			static_cast<uint32_t>(info.compareOp),
+			floatBits(info.minLod),
+			floatBits(info.maxLod),
+			static_cast<uint32_t>(info.borderColor),
+			info.unnormalizedCoordinates };
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto cached = samplers.find(key);
+		if (cached != samplers.end()) {
+			return cached->second;
+		}
+
+		VkSampler sampler;
+		if (vkCreateSampler(device, &info, nullptr, &sampler) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create sampler!");
+		}
+		samplers.emplace(std::move(key), sampler);
+		return sampler;
+	}
+
+	size_t VulkEngSamplerCache::size() const {
+		std::lock_guard<std::mutex> lock{ mutex };
+		return samplers.size();
+	}
+
+} // namespace VulkanEngine
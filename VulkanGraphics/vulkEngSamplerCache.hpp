@@ -0,0 +1,39 @@
+#pragma once
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+//std
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace VulkanEngine {
+
+	// Device-level cache of samplers. Identical create infos share one handle, so every texture
+	// sampled the same way costs one sampler, well below maxSamplerAllocationCount. Samplers live
+	// as long as the cache. Safe to use from any thread.
+	class VulkEngSamplerCache {
+
+	public:
+		// maxAnisotropy of the device, samplers asking for more are clamped to it
+		VulkEngSamplerCache(VkDevice device, float maxAnisotropy);
+		~VulkEngSamplerCache();
+
+		VulkEngSamplerCache(const VulkEngSamplerCache&) = delete;
+		VulkEngSamplerCache& operator=(const VulkEngSamplerCache&) = delete;
+
+		// samplerInfo must not chain a pNext structure
+		VkSampler getSampler(const VkSamplerCreateInfo& samplerInfo);
+
+		size_t size() const;
+
+	private:
+		VkDevice device;
+		float maxAnisotropy;
+		mutable std::mutex mutex;
+		std::map<std::vector<uint32_t>, VkSampler> samplers;
+	};
+
+} // namespace VulkanEngine
@@ -0,0 +1,157 @@
+#include "vulkEngShaderCache.hpp"
+#include "vulkEngMappedFile.hpp"
+
+#ifdef VULKENG_EMBED_SHADERS
+#include "vulkEngEmbeddedShaders.hpp"
+#endif
+
+//std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace VulkanEngine {
+
+	VulkEngShaderModule::VulkEngShaderModule(VkDevice device, const uint32_t* code, size_t codeSize, uint64_t hash)
+		: device{ device },
+		hash{ hash },
+		code(code, code + codeSize / sizeof(uint32_t)),
+		reflection{ ShaderReflection::fromSpirv(code, codeSize) }
+	{
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = codeSize;
+		createInfo.pCode = code;
+
+		if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shader module!");
+		}
+	}
+
+	VulkEngShaderModule::~VulkEngShaderModule() {
+		vkDestroyShaderModule(device, shaderModule, nullptr);
+	}
+
+	bool VulkEngShaderModule::hasCode(const uint32_t* otherCode, size_t otherCodeSize) const {
+		return otherCodeSize == getCodeSize() && std::memcmp(otherCode, code.data(), otherCodeSize) == 0;
+	}
+
+	VulkEngShaderCache::VulkEngShaderCache(VkDevice device) : device{ device } {}
+
+	VulkEngShaderCache::~VulkEngShaderCache() {
+		assert(getLiveModuleCount() == 0 && "Shader modules must be released before the device is destroyed");
+	}
+
+	uint64_t VulkEngShaderCache::hashCode(const uint32_t* code, size_t codeSize) {
+		uint64_t hash = 14695981039346656037ull ^ codeSize;
+		for (size_t i = 0; i < codeSize / sizeof(uint32_t); i++) {
+			hash ^= code[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	std::shared_ptr<VulkEngShaderModule> VulkEngShaderCache::loadModule(const std::string& filepath) {
+#ifdef VULKENG_EMBED_SHADERS
+		bool reloaded;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			reloaded = reloadedFiles.count(filepath) != 0;
+		}
+		for (const auto& entry : EmbeddedShaders::entries) {
+			if (!reloaded && entry.path == filepath) {
+				return getModule(entry.code, entry.size);
+			}
+		}
+#endif
+		std::error_code error;
+		FileStamp stamp{};
+		stamp.size = std::filesystem::file_size(filepath, error);
+		if (!error) stamp.writeTime = std::filesystem::last_write_time(filepath, error);
+		if (error) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			auto known = fileStamps.find(filepath);
+			if (known != fileStamps.end() &&
+				known->second.size == stamp.size && known->second.writeTime == stamp.writeTime) {
+				if (auto module = known->second.module.lock()) {
+					return module;
+				}
+			}
+		}
+
+		VulkEngMappedFile file{ filepath };
+		if (file.size() % sizeof(uint32_t) != 0) {
+			throw std::runtime_error("invalid SPIR-V size in file: " + filepath);
+		}
+		auto code = static_cast<const uint32_t*>(file.data());
+		uint64_t hash = hashCode(code, file.size());
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto module = findOrCreate(code, file.size(), hash);
+		stamp.module = module;
+		fileStamps[filepath] = stamp;
+		return module;
+	}
+
+	std::shared_ptr<VulkEngShaderModule> VulkEngShaderCache::getModule(const uint32_t* code, size_t codeSize) {
+		uint64_t hash = hashCode(code, codeSize);
+		std::lock_guard<std::mutex> lock{ mutex };
+		return findOrCreate(code, codeSize, hash);
+	}
+
+	void VulkEngShaderCache::reloadFromFile(const std::string& filepath) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		fileStamps.erase(filepath);
+		reloadedFiles.insert(filepath);
+	}
+
+	std::shared_ptr<VulkEngShaderModule> VulkEngShaderCache::findOrCreate(
+		const uint32_t* code,
+		size_t codeSize,
+		uint64_t hash
+	) {
+		// the hash only narrows the search; the code decides
+		auto found = modules.find(hash);
+		if (found != modules.end()) {
+			for (const auto& candidate : found->second) {
+				auto module = candidate.lock();
+				if (module && module->hasCode(code, codeSize)) {
+					return module;
+				}
+			}
+		}
+
+		pruneExpired();
+		auto module = std::make_shared<VulkEngShaderModule>(device, code, codeSize, hash);
+		modules[hash].push_back(module);
+		return module;
+	}
+
+	void VulkEngShaderCache::pruneExpired() {
+		for (auto it = modules.begin(); it != modules.end();) {
+			auto& candidates = it->second;
+			candidates.erase(
+				std::remove_if(candidates.begin(), candidates.end(), [](const auto& module) { return module.expired(); }),
+				candidates.end());
+			it = candidates.empty() ? modules.erase(it) : std::next(it);
+		}
+	}
+
+	size_t VulkEngShaderCache::getLiveModuleCount() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		size_t count = 0;
+		for (const auto& [hash, candidates] : modules) {
+			for (const auto& module : candidates) {
+				if (!module.expired()) count++;
+			}
+		}
+		return count;
+	}
+
+} // namespace VulkanEngine
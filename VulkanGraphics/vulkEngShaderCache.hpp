@@ -0,0 +1,91 @@
+#pragma once
+
+#include "vulkEngShaderReflection.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+//std
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace VulkanEngine {
+
+	// A VkShaderModule shared between every pipeline built from the same SPIR-V, along with the
+	// interface reflected from that SPIR-V when it was loaded. The module is destroyed when the last
+	// reference goes away; pipelines already created from it are unaffected.
+	class VulkEngShaderModule {
+
+	public:
+		VulkEngShaderModule(VkDevice device, const uint32_t* code, size_t codeSize, uint64_t hash);
+		~VulkEngShaderModule();
+
+		VulkEngShaderModule(const VulkEngShaderModule&) = delete;
+		VulkEngShaderModule& operator=(const VulkEngShaderModule&) = delete;
+
+		VkShaderModule getHandle() const { return shaderModule; }
+		uint64_t getHash() const { return hash; }
+		size_t getCodeSize() const { return code.size() * sizeof(uint32_t); }
+		bool hasCode(const uint32_t* otherCode, size_t otherCodeSize) const;
+		const ShaderReflection& getReflection() const { return reflection; }
+
+	private:
+		VkDevice device;
+		VkShaderModule shaderModule = VK_NULL_HANDLE;
+		uint64_t hash;
+		// kept to tell apart modules whose hashes collide
+		std::vector<uint32_t> code;
+		ShaderReflection reflection;
+	};
+
+	// Device-level cache of shader modules looked up by a hash of their SPIR-V and matched on the code
+	// itself, so identical code loaded from any path, or from the binary itself, ends up in one module. Files are memory mapped and
+	// handed to the driver directly, and a file whose size and write time have not changed since it
+	// was last hashed is not opened again while its module is alive. Safe to use from any thread.
+	class VulkEngShaderCache {
+
+	public:
+		explicit VulkEngShaderCache(VkDevice device);
+		~VulkEngShaderCache();
+
+		VulkEngShaderCache(const VulkEngShaderCache&) = delete;
+		VulkEngShaderCache& operator=(const VulkEngShaderCache&) = delete;
+
+		// Resolves filepath against the SPIR-V embedded by the build first, then the file system.
+		std::shared_ptr<VulkEngShaderModule> loadModule(const std::string& filepath);
+		std::shared_ptr<VulkEngShaderModule> getModule(const uint32_t* code, size_t codeSize);
+
+		// Makes the next loadModule(filepath) read the file again, and read it from disk from then
+		// on even when the build embedded a copy. Used after a shader has been recompiled.
+		void reloadFromFile(const std::string& filepath);
+
+		size_t getLiveModuleCount();
+
+		// FNV-1a over the words, seeded with the size
+		static uint64_t hashCode(const uint32_t* code, size_t codeSize);
+
+	private:
+		std::shared_ptr<VulkEngShaderModule> findOrCreate(const uint32_t* code, size_t codeSize, uint64_t hash);
+		void pruneExpired();
+
+		struct FileStamp {
+			uintmax_t size = 0;
+			std::filesystem::file_time_type writeTime{};
+			std::weak_ptr<VulkEngShaderModule> module;
+		};
+
+		VkDevice device;
+		std::mutex mutex;
+		// every live module with a hash, almost always one
+		std::unordered_map<uint64_t, std::vector<std::weak_ptr<VulkEngShaderModule>>> modules;
+		std::unordered_map<std::string, FileStamp> fileStamps;
+		std::unordered_set<std::string> reloadedFiles;
+	};
+
+} // namespace VulkanEngine
@@ -0,0 +1,286 @@
+#include "vulkEngShaderHotReload.hpp"
+#include "vulkEngShaderCache.hpp"
+#include "vulkEngCpuProfiler.hpp"
+
+//std
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace VulkanEngine {
+
+	namespace {
+		constexpr auto POLL_INTERVAL = std::chrono::milliseconds(500);
+		constexpr auto WAKE_INTERVAL = std::chrono::milliseconds(100);
+		// editors often write a file in several steps; changes closer together than this are merged
+		constexpr auto SETTLE_TIME = std::chrono::milliseconds(50);
+	}
+
+	VulkEngShaderHotReload::VulkEngShaderHotReload(
+		VulkEngDevice& device,
+		const std::string& sourceDirectory,
+		const std::string& outputDirectory,
+		const std::string& compiler
+	) : vulkanDevice{ device },
+		sourceDirectory{ sourceDirectory },
+		outputDirectory{ outputDirectory },
+		compiler{ compiler.empty() ? defaultCompiler() : compiler }
+	{
+		if (!std::filesystem::is_directory(this->sourceDirectory)) {
+			throw std::runtime_error("shader hot reload: not a directory: " + sourceDirectory);
+		}
+
+#ifdef __linux__
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotifyFd >= 0 && inotify_add_watch(inotifyFd, sourceDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+			close(inotifyFd);
+			inotifyFd = -1;
+		}
+#endif
+		if (inotifyFd < 0) {
+			// baseline, so shaders are not all recompiled on the first poll
+			pollModificationTimes();
+		}
+
+		worker = std::thread{ &VulkEngShaderHotReload::run, this };
+	}
+
+	VulkEngShaderHotReload::~VulkEngShaderHotReload() {
+		stopping = true;
+		worker.join();
+#ifdef __linux__
+		if (inotifyFd >= 0) {
+			close(inotifyFd);
+		}
+#endif
+		// rebuilt pipelines that were never swapped in can go right away, no frame has used them
+		pending.clear();
+	}
+
+	void VulkEngShaderHotReload::watch(VulkEngPipelineVariants& variants) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		watched.push_back(&variants);
+	}
+
+	size_t VulkEngShaderHotReload::applyPendingReloads() {
+		std::vector<PendingReload> ready;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			ready.swap(pending);
+		}
+
+		for (auto& reload : ready) {
+			reload.variants->replace(reload.replacement);
+			// the replacement now owns the pipeline that in-flight frames may still be using
+			std::shared_ptr<VulkEngPipeline> retired = std::move(reload.replacement.pipeline);
+			vulkanDevice.deferDestruction([retired]() mutable { retired.reset(); });
+		}
+		return ready.size();
+	}
+
+	void VulkEngShaderHotReload::run() {
+		VulkEngCpuProfiler::setThreadName("shader hot reload");
+		while (!stopping) {
+			std::vector<std::filesystem::path> changed = waitForChanges();
+			if (changed.empty()) {
+				continue;
+			}
+
+			VulkEngCpuScope scope{ "shader hot reload" };
+			std::vector<std::string> compiled;
+			for (const auto& source : expandIncludes(changed)) {
+				std::string spirvPath;
+				if (compile(source, spirvPath)) {
+					compiled.push_back(spirvPath);
+				}
+			}
+			if (!compiled.empty()) {
+				rebuildPipelines(compiled);
+			}
+		}
+	}
+
+	std::vector<std::filesystem::path> VulkEngShaderHotReload::waitForChanges() {
+		if (inotifyFd < 0) {
+			auto wakeAt = std::chrono::steady_clock::now() + POLL_INTERVAL;
+			while (!stopping && std::chrono::steady_clock::now() < wakeAt) {
+				std::this_thread::sleep_for(WAKE_INTERVAL);
+			}
+			return stopping ? std::vector<std::filesystem::path>{} : pollModificationTimes();
+		}
+
+#ifdef __linux__
+		pollfd descriptor{ inotifyFd, POLLIN, 0 };
+		if (poll(&descriptor, 1, static_cast<int>(WAKE_INTERVAL.count())) <= 0) {
+			return {};
+		}
+		std::vector<std::filesystem::path> changed = readInotifyEvents();
+		std::this_thread::sleep_for(SETTLE_TIME);
+		for (auto& path : readInotifyEvents()) {
+			changed.push_back(std::move(path));
+		}
+		std::sort(changed.begin(), changed.end());
+		changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+		return changed;
+#else
+		return {};
+#endif
+	}
+
+	std::vector<std::filesystem::path> VulkEngShaderHotReload::readInotifyEvents() {
+		std::vector<std::filesystem::path> changed;
+#ifdef __linux__
+		alignas(inotify_event) char buffer[4096];
+		for (;;) {
+			ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+			if (length <= 0) {
+				break;
+			}
+			for (char* cursor = buffer; cursor < buffer + length;) {
+				auto* event = reinterpret_cast<inotify_event*>(cursor);
+				if (event->len > 0) {
+					std::filesystem::path path = sourceDirectory / event->name;
+					if (isShaderSource(path) || path.extension() == ".glsl") {
+						changed.push_back(path);
+					}
+				}
+				cursor += sizeof(inotify_event) + event->len;
+			}
+		}
+#endif
+		return changed;
+	}
+
+	std::vector<std::filesystem::path> VulkEngShaderHotReload::pollModificationTimes() {
+		std::vector<std::filesystem::path> changed;
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator{ sourceDirectory, error }) {
+			const auto& path = entry.path();
+			if (!isShaderSource(path) && path.extension() != ".glsl") {
+				continue;
+			}
+			auto writeTime = entry.last_write_time(error);
+			if (error) {
+				continue;
+			}
+			auto known = modificationTimes.find(path);
+			if (known != modificationTimes.end() && known->second != writeTime) {
+				changed.push_back(path);
+			}
+			modificationTimes[path] = writeTime;
+		}
+		return changed;
+	}
+
+	std::vector<std::filesystem::path> VulkEngShaderHotReload::expandIncludes(
+		const std::vector<std::filesystem::path>& changed
+	) {
+		bool includeChanged = std::any_of(changed.begin(), changed.end(),
+			[](const std::filesystem::path& path) { return path.extension() == ".glsl"; });
+		if (!includeChanged) {
+			return changed;
+		}
+
+		// no dependency tracking, anything may include the file
+		std::vector<std::filesystem::path> sources;
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator{ sourceDirectory, error }) {
+			if (isShaderSource(entry.path())) {
+				sources.push_back(entry.path());
+			}
+		}
+		return sources;
+	}
+
+	bool VulkEngShaderHotReload::compile(const std::filesystem::path& source, std::string& spirvPath) {
+		spirvPath = outputDirectory + "/" + source.filename().string() + ".spv";
+		std::string temporaryPath = spirvPath + ".tmp";
+
+		std::string command = "\"" + compiler + "\" \"" + source.string() + "\" -o \"" + temporaryPath + "\"";
+#ifdef _WIN32
+		// cmd.exe strips the outer quotes of the whole line
+		command = "\"" + command + "\"";
+#endif
+		if (std::system(command.c_str()) != 0) {
+			std::cerr << "shader hot reload: failed to compile " << source.string() << std::endl;
+			std::error_code error;
+			std::filesystem::remove(temporaryPath, error);
+			return false;
+		}
+
+		// replace the old binary in one step, so it is never mapped half written
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, spirvPath, error);
+		if (error) {
+			std::cerr << "shader hot reload: failed to write " << spirvPath << ": " << error.message() << std::endl;
+			return false;
+		}
+		vulkanDevice.shaderCache().reloadFromFile(spirvPath);
+		return true;
+	}
+
+	void VulkEngShaderHotReload::rebuildPipelines(const std::vector<std::string>& spirvPaths) {
+		std::vector<VulkEngPipelineVariants*> affected;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			for (auto* variants : watched) {
+				for (const auto& path : spirvPaths) {
+					if (variants->usesShader(path)) {
+						affected.push_back(variants);
+						break;
+					}
+				}
+			}
+		}
+
+		for (auto* variants : affected) {
+			std::vector<VulkEngPipelineVariants::Replacement> replacements;
+			try {
+				replacements = variants->buildReplacements();
+			}
+			catch (const std::exception& e) {
+				std::cerr << "shader hot reload: keeping the old pipelines: " << e.what() << std::endl;
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock{ mutex };
+			for (auto& replacement : replacements) {
+				pending.push_back({ variants, std::move(replacement) });
+			}
+		}
+
+		for (const auto& path : spirvPaths) {
+			std::cout << "shader hot reload: compiled " << path << std::endl;
+		}
+	}
+
+	bool VulkEngShaderHotReload::isShaderSource(const std::filesystem::path& path) {
+		static const std::set<std::string> extensions{ ".vert", ".frag", ".comp", ".geom", ".tesc", ".tese" };
+		return extensions.count(path.extension().string()) != 0;
+	}
+
+	std::string VulkEngShaderHotReload::defaultCompiler() {
+		if (const char* sdk = std::getenv("VULKAN_SDK")) {
+#ifdef _WIN32
+			std::filesystem::path glslc = std::filesystem::path{ sdk } / "Bin" / "glslc.exe";
+#else
+			std::filesystem::path glslc = std::filesystem::path{ sdk } / "bin" / "glslc";
+#endif
+			if (std::filesystem::exists(glslc)) {
+				return glslc.string();
+			}
+		}
+		return "glslc";
+	}
+
+} // namespace VulkanEngine
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "vulkEngDevice.hpp"
+#include "vulkEngPipelineVariants.hpp"
+
+//std
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace VulkanEngine {
+
+	// Watches a directory of GLSL sources and, on a background thread, recompiles changed shaders
+	// with glslc into outputDirectory and rebuilds every watched pipeline that uses them. Rebuilt
+	// pipelines are only swapped in by applyPendingReloads, between frames, and the pipelines they
+	// displace are destroyed once the frames using them have finished. A shader that fails to
+	// compile, or no longer fits its pipeline layout, is reported and the old pipeline kept.
+	//
+	// Uses inotify on Linux and polls modification times elsewhere, or if inotify is unavailable.
+	// Editing an included file (.glsl) recompiles every shader in the directory.
+	class VulkEngShaderHotReload {
+
+	public:
+		// outputDirectory is where the engine loads SPIR-V from, the "shaders" in "shaders/x.vert.spv".
+		// compiler defaults to glslc from VULKAN_SDK, or the one on PATH.
+		VulkEngShaderHotReload(
+			VulkEngDevice& device,
+			const std::string& sourceDirectory,
+			const std::string& outputDirectory = "shaders",
+			const std::string& compiler = "");
+		~VulkEngShaderHotReload();
+
+		VulkEngShaderHotReload(const VulkEngShaderHotReload&) = delete;
+		VulkEngShaderHotReload& operator=(const VulkEngShaderHotReload&) = delete;
+
+		// variants must outlive this object
+		void watch(VulkEngPipelineVariants& variants);
+
+		// Call on the rendering thread between frames. Returns the number of pipelines swapped.
+		size_t applyPendingReloads();
+
+		bool isUsingInotify() const { return inotifyFd >= 0; }
+
+	private:
+		struct PendingReload {
+			VulkEngPipelineVariants* variants;
+			VulkEngPipelineVariants::Replacement replacement;
+		};
+
+		void run();
+		std::vector<std::filesystem::path> waitForChanges();
+		std::vector<std::filesystem::path> readInotifyEvents();
+		std::vector<std::filesystem::path> pollModificationTimes();
+		std::vector<std::filesystem::path> expandIncludes(const std::vector<std::filesystem::path>& changed);
+		bool compile(const std::filesystem::path& source, std::string& spirvPath);
+		void rebuildPipelines(const std::vector<std::string>& spirvPaths);
+
+		static bool isShaderSource(const std::filesystem::path& path);
+		static std::string defaultCompiler();
+
+		VulkEngDevice& vulkanDevice;
+		std::filesystem::path sourceDirectory;
+		std::string outputDirectory;
+		std::string compiler;
+
+		int inotifyFd = -1;
+		std::map<std::filesystem::path, std::filesystem::file_time_type> modificationTimes;
+
+		std::mutex mutex;
+		std::vector<VulkEngPipelineVariants*> watched;
+		std::vector<PendingReload> pending;
+
+		std::atomic<bool> stopping{ false };
+		std::thread worker;
+	};
+
+} // namespace VulkanEngine
@@ -0,0 +1,410 @@
+#include "vulkEngShaderReflection.hpp"
+
+//std
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace VulkanEngine {
+
+	namespace {
+
+		constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+		constexpr uint32_t SPIRV_HEADER_WORDS = 5;
+		constexpr uint32_t NO_VALUE = std::numeric_limits<uint32_t>::max();
+
+		// the subset of the SPIR-V specification the reflection reads
+		enum SpirvOp : uint32_t {
+			OpName = 5,
+			OpEntryPoint = 15,
+			OpTypeInt = 21,
+			OpTypeFloat = 22,
+			OpTypeVector = 23,
+			OpTypeMatrix = 24,
+			OpTypeImage = 25,
+			OpTypeSampler = 26,
+			OpTypeSampledImage = 27,
+			OpTypeArray = 28,
+			OpTypeRuntimeArray = 29,
+			OpTypeStruct = 30,
+			OpTypePointer = 32,
+			OpConstant = 43,
+			OpSpecConstant = 50,
+			OpVariable = 59,
+			OpDecorate = 71,
+			OpMemberDecorate = 72,
+		};
+
+		enum SpirvDecoration : uint32_t {
+			DecorationSpecId = 1,
+			DecorationBlock = 2,
+			DecorationBufferBlock = 3,
+			DecorationArrayStride = 6,
+			DecorationMatrixStride = 7,
+			DecorationBuiltIn = 11,
+			DecorationLocation = 30,
+			DecorationBinding = 33,
+			DecorationDescriptorSet = 34,
+			DecorationOffset = 35,
+		};
+
+		enum SpirvStorageClass : uint32_t {
+			StorageUniformConstant = 0,
+			StorageInput = 1,
+			StorageUniform = 2,
+			StoragePushConstant = 9,
+			StorageStorageBuffer = 12,
+		};
+
+		struct MemberInfo {
+			uint32_t offset = 0;
+			uint32_t matrixStride = 0;
+		};
+
+		struct IdInfo {
+			// the instruction that defines the id, starting at its opcode word
+			const uint32_t* words = nullptr;
+			uint32_t opcode = 0;
+			std::string name;
+			uint32_t location = NO_VALUE;
+			uint32_t binding = 0;
+			uint32_t set = 0;
+			uint32_t arrayStride = 0;
+			bool builtIn = false;
+			bool block = false;
+			bool bufferBlock = false;
+			std::vector<MemberInfo> members;
+		};
+
+		class SpirvModule {
+		public:
+			SpirvModule(const uint32_t* code, size_t wordCount) {
+				if (wordCount < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC) {
+					throw std::runtime_error("failed to reflect shader: not a SPIR-V module!");
+				}
+				ids.resize(code[3]);
+
+				size_t offset = SPIRV_HEADER_WORDS;
+				while (offset < wordCount) {
+					const uint32_t* words = code + offset;
+					uint32_t instructionWords = words[0] >> 16;
+					if (instructionWords == 0 || offset + instructionWords > wordCount) {
+						throw std::runtime_error("failed to reflect shader: truncated SPIR-V instruction!");
+					}
+					parseInstruction(words, instructionWords);
+					offset += instructionWords;
+				}
+			}
+
+			const IdInfo& id(uint32_t value) const {
+				if (value >= ids.size()) {
+					throw std::runtime_error("failed to reflect shader: SPIR-V id out of range!");
+				}
+				return ids[value];
+			}
+
+			uint32_t constantValue(uint32_t value) const {
+				const IdInfo& info = id(value);
+				if (info.opcode != OpConstant && info.opcode != OpSpecConstant) {
+					throw std::runtime_error("failed to reflect shader: array length is not a constant!");
+				}
+				return info.words[3];
+			}
+
+			// byte size of a type laid out in a block; matrixStride comes from the enclosing member
+			uint32_t typeSize(uint32_t typeId, uint32_t matrixStride = 0) const {
+				const IdInfo& type = id(typeId);
+				switch (type.opcode) {
+				case OpTypeInt:
+				case OpTypeFloat:
+					return type.words[2] / 8;
+				case OpTypeVector:
+					return typeSize(type.words[2]) * type.words[3];
+				case OpTypeMatrix:
+					return (matrixStride != 0 ? matrixStride : typeSize(type.words[2])) * type.words[3];
+				case OpTypeArray: {
+					uint32_t stride = type.arrayStride != 0 ? type.arrayStride : typeSize(type.words[2], matrixStride);
+					return stride * constantValue(type.words[3]);
+				}
+				case OpTypeStruct: {
+					uint32_t size = 0;
+					uint32_t memberCount = (type.words[0] >> 16) - 2;
+					for (uint32_t i = 0; i < memberCount; i++) {
+						MemberInfo member = i < type.members.size() ? type.members[i] : MemberInfo{};
+						size = std::max(size, member.offset + typeSize(type.words[2 + i], member.matrixStride));
+					}
+					return size;
+				}
+				default:
+					// runtime arrays and opaque types have no static size
+					return 0;
+				}
+			}
+
+			std::vector<uint32_t> variables;
+			std::vector<uint32_t> specIds;
+			VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+			bool hasEntryPoint = false;
+
+		private:
+			IdInfo& mutableId(uint32_t value) {
+				if (value >= ids.size()) {
+					throw std::runtime_error("failed to reflect shader: SPIR-V id out of range!");
+				}
+				return ids[value];
+			}
+
+			void define(const uint32_t* words, uint32_t opcode, uint32_t resultId) {
+				IdInfo& info = mutableId(resultId);
+				info.words = words;
+				info.opcode = opcode;
+			}
+
+			void parseInstruction(const uint32_t* words, uint32_t instructionWords) {
+				uint32_t opcode = words[0] & 0xffff;
+				switch (opcode) {
+				case OpName:
+					mutableId(words[1]).name = reinterpret_cast<const char*>(words + 2);
+					break;
+				case OpEntryPoint:
+					// modules with several entry points are reflected as their first one
+					if (!hasEntryPoint) {
+						stage = executionModelStage(words[1]);
+						hasEntryPoint = true;
+					}
+					break;
+				case OpTypeInt:
+				case OpTypeFloat:
+				case OpTypeVector:
+				case OpTypeMatrix:
+				case OpTypeImage:
+				case OpTypeSampler:
+				case OpTypeSampledImage:
+				case OpTypeArray:
+				case OpTypeRuntimeArray:
+				case OpTypeStruct:
+				case OpTypePointer:
+					define(words, opcode, words[1]);
+					break;
+				case OpConstant:
+				case OpSpecConstant:
+					define(words, opcode, words[2]);
+					break;
+				case OpVariable:
+					define(words, opcode, words[2]);
+					variables.push_back(words[2]);
+					break;
+				case OpDecorate:
+					if (instructionWords >= 3) decorate(mutableId(words[1]), words[2], instructionWords > 3 ? words[3] : 0);
+					if (instructionWords >= 4 && words[2] == DecorationSpecId) specIds.push_back(words[3]);
+					break;
+				case OpMemberDecorate:
+					if (instructionWords >= 4) decorateMember(mutableId(words[1]), words[2], words[3], instructionWords > 4 ? words[4] : 0);
+					break;
+				default:
+					break;
+				}
+			}
+
+			static void decorate(IdInfo& info, uint32_t decoration, uint32_t value) {
+				switch (decoration) {
+				case DecorationBlock: info.block = true; break;
+				case DecorationBufferBlock: info.bufferBlock = true; break;
+				case DecorationArrayStride: info.arrayStride = value; break;
+				case DecorationBuiltIn: info.builtIn = true; break;
+				case DecorationLocation: info.location = value; break;
+				case DecorationBinding: info.binding = value; break;
+				case DecorationDescriptorSet: info.set = value; break;
+				default: break;
+				}
+			}
+
+			static void decorateMember(IdInfo& info, uint32_t member, uint32_t decoration, uint32_t value) {
+				if (info.members.size() <= member) info.members.resize(member + 1);
+				if (decoration == DecorationOffset) info.members[member].offset = value;
+				else if (decoration == DecorationMatrixStride) info.members[member].matrixStride = value;
+			}
+
+			static VkShaderStageFlagBits executionModelStage(uint32_t model) {
+				switch (model) {
+				case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+				case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+				case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+				case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+				case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+				case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+				default: throw std::runtime_error("failed to reflect shader: unsupported execution model!");
+				}
+			}
+
+			std::vector<IdInfo> ids;
+		};
+
+		VkFormat vertexInputFormat(const SpirvModule& module, uint32_t typeId) {
+			const IdInfo* type = &module.id(typeId);
+			uint32_t components = 1;
+			if (type->opcode == OpTypeVector) {
+				components = type->words[3];
+				type = &module.id(type->words[2]);
+			}
+			if ((type->opcode != OpTypeFloat && type->opcode != OpTypeInt) || type->words[2] != 32 || components > 4) {
+				return VK_FORMAT_UNDEFINED;
+			}
+
+			static constexpr VkFormat floatFormats[] = {
+				VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+			static constexpr VkFormat sintFormats[] = {
+				VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+			static constexpr VkFormat uintFormats[] = {
+				VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+			if (type->opcode == OpTypeFloat) return floatFormats[components - 1];
+			return type->words[3] != 0 ? sintFormats[components - 1] : uintFormats[components - 1];
+		}
+
+		VkDescriptorType descriptorType(const SpirvModule& module, uint32_t storageClass, const IdInfo& type) {
+			if (storageClass == StorageStorageBuffer) return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			if (storageClass == StorageUniform) {
+				return type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			}
+
+			switch (type.opcode) {
+			case OpTypeSampler:
+				return VK_DESCRIPTOR_TYPE_SAMPLER;
+			case OpTypeSampledImage: {
+				// a sampled buffer image is a uniform texel buffer even when combined
+				const IdInfo& image = module.id(type.words[2]);
+				return image.words[3] == 5 ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			}
+			case OpTypeImage: {
+				// words: opcode, id, sampled type, dim, depth, arrayed, ms, sampled
+				uint32_t dim = type.words[3];
+				uint32_t sampled = type.words[7];
+				if (dim == 6) return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				if (dim == 5) return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			}
+			default:
+				return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+			}
+		}
+
+		enum class NumericClass { Float, SInt, UInt, Unknown };
+
+		NumericClass formatNumericClass(VkFormat format) {
+			switch (format) {
+			case VK_FORMAT_R32_SINT: case VK_FORMAT_R32G32_SINT: case VK_FORMAT_R32G32B32_SINT: case VK_FORMAT_R32G32B32A32_SINT:
+			case VK_FORMAT_R16_SINT: case VK_FORMAT_R16G16_SINT: case VK_FORMAT_R16G16B16A16_SINT:
+			case VK_FORMAT_R8_SINT: case VK_FORMAT_R8G8_SINT: case VK_FORMAT_R8G8B8A8_SINT:
+				return NumericClass::SInt;
+			case VK_FORMAT_R32_UINT: case VK_FORMAT_R32G32_UINT: case VK_FORMAT_R32G32B32_UINT: case VK_FORMAT_R32G32B32A32_UINT:
+			case VK_FORMAT_R16_UINT: case VK_FORMAT_R16G16_UINT: case VK_FORMAT_R16G16B16A16_UINT:
+			case VK_FORMAT_R8_UINT: case VK_FORMAT_R8G8_UINT: case VK_FORMAT_R8G8B8A8_UINT:
+				return NumericClass::UInt;
+			case VK_FORMAT_R32_SFLOAT: case VK_FORMAT_R32G32_SFLOAT: case VK_FORMAT_R32G32B32_SFLOAT: case VK_FORMAT_R32G32B32A32_SFLOAT:
+			case VK_FORMAT_R16_SFLOAT: case VK_FORMAT_R16G16_SFLOAT: case VK_FORMAT_R16G16B16A16_SFLOAT:
+			case VK_FORMAT_R16G16_UNORM: case VK_FORMAT_R16G16B16A16_UNORM: case VK_FORMAT_R16G16_SNORM: case VK_FORMAT_R16G16B16A16_SNORM:
+			case VK_FORMAT_R8G8B8A8_UNORM: case VK_FORMAT_R8G8B8A8_SNORM: case VK_FORMAT_B8G8R8A8_UNORM:
+			case VK_FORMAT_A2B10G10R10_UNORM_PACK32: case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
+				return NumericClass::Float;
+			default:
+				return NumericClass::Unknown;
+			}
+		}
+
+	} // namespace
+
+	ShaderReflection ShaderReflection::fromSpirv(const uint32_t* code, size_t codeSize) {
+		SpirvModule module{ code, codeSize / sizeof(uint32_t) };
+		if (!module.hasEntryPoint) {
+			throw std::runtime_error("failed to reflect shader: no entry point!");
+		}
+
+		ShaderReflection reflection{};
+		reflection.stage = module.stage;
+
+		for (uint32_t variableId : module.variables) {
+			const IdInfo& variable = module.id(variableId);
+			uint32_t storageClass = variable.words[3];
+			const IdInfo& pointer = module.id(variable.words[1]);
+			uint32_t typeId = pointer.words[3];
+
+			if (storageClass == StorageInput) {
+				if (reflection.stage != VK_SHADER_STAGE_VERTEX_BIT || variable.builtIn || module.id(typeId).builtIn) continue;
+				// gl_PerVertex style blocks carry BuiltIn on their members only
+				if (module.id(typeId).opcode == OpTypeStruct) continue;
+				if (variable.location == NO_VALUE) {
+					throw std::runtime_error("failed to reflect shader: vertex input '" + variable.name + "' has no location!");
+				}
+				VkFormat format = vertexInputFormat(module, typeId);
+				if (format == VK_FORMAT_UNDEFINED) {
+					throw std::runtime_error(
+						"failed to reflect shader: unsupported type for vertex input '" + variable.name + "'!");
+				}
+				reflection.vertexInputs.push_back({ variable.location, format, variable.name });
+			}
+			else if (storageClass == StoragePushConstant) {
+				const IdInfo& block = module.id(typeId);
+				uint32_t memberCount = (block.words[0] >> 16) - 2;
+				uint32_t begin = std::numeric_limits<uint32_t>::max();
+				uint32_t end = 0;
+				for (uint32_t i = 0; i < memberCount; i++) {
+					MemberInfo member = i < block.members.size() ? block.members[i] : MemberInfo{};
+					begin = std::min(begin, member.offset);
+					end = std::max(end, member.offset + module.typeSize(block.words[2 + i], member.matrixStride));
+				}
+				if (end > begin) {
+					reflection.pushConstantOffset = begin;
+					reflection.pushConstantSize = end - begin;
+				}
+			}
+			else if (storageClass == StorageUniformConstant || storageClass == StorageUniform || storageClass == StorageStorageBuffer) {
+				uint32_t count = 1;
+				const IdInfo* type = &module.id(typeId);
+				while (type->opcode == OpTypeArray || type->opcode == OpTypeRuntimeArray) {
+					if (type->opcode == OpTypeArray) count *= module.constantValue(type->words[3]);
+					type = &module.id(type->words[2]);
+				}
+				VkDescriptorType descriptor = descriptorType(module, storageClass, *type);
+				if (descriptor == VK_DESCRIPTOR_TYPE_MAX_ENUM) continue;
+				std::string name = !variable.name.empty() ? variable.name : type->name;
+				reflection.descriptorBindings.push_back({ variable.set, variable.binding, descriptor, count, name });
+			}
+		}
+
+		reflection.specializationConstantIds = module.specIds;
+		std::sort(reflection.specializationConstantIds.begin(), reflection.specializationConstantIds.end());
+		std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(),
+			[](const ShaderVertexInput& a, const ShaderVertexInput& b) { return a.location < b.location; });
+		std::sort(reflection.descriptorBindings.begin(), reflection.descriptorBindings.end(),
+			[](const ShaderDescriptorBinding& a, const ShaderDescriptorBinding& b) {
+				return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+			});
+		return reflection;
+	}
+
+	bool ShaderReflection::hasSameResourceInterface(const ShaderReflection& other) const {
+		if (stage != other.stage ||
+			pushConstantOffset != other.pushConstantOffset ||
+			pushConstantSize != other.pushConstantSize ||
+			descriptorBindings.size() != other.descriptorBindings.size()) {
+			return false;
+		}
+		// both lists are sorted by set and binding
+		for (size_t i = 0; i < descriptorBindings.size(); i++) {
+			const auto& a = descriptorBindings[i];
+			const auto& b = other.descriptorBindings[i];
+			if (a.set != b.set || a.binding != b.binding || a.type != b.type || a.count != b.count) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool ShaderReflection::isCompatibleVertexFormat(VkFormat shaderFormat, VkFormat attributeFormat) {
+		NumericClass shaderClass = formatNumericClass(shaderFormat);
+		NumericClass attributeClass = formatNumericClass(attributeFormat);
+		// formats the table does not know about are left to the validation layers
+		return shaderClass == NumericClass::Unknown || attributeClass == NumericClass::Unknown || shaderClass == attributeClass;
+	}
+
+} // namespace VulkanEngine
@@ -0,0 +1,53 @@
+#pragma once
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+//std
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace VulkanEngine {
+
+	struct ShaderVertexInput {
+		uint32_t location;
+		VkFormat format;
+		std::string name;
+	};
+
+	struct ShaderDescriptorBinding {
+		uint32_t set;
+		uint32_t binding;
+		VkDescriptorType type;
+		uint32_t count;
+		std::string name;
+	};
+
+	// The interface a SPIR-V module expects from the pipeline that uses it. Only what the engine
+	// needs to build layouts and check the C++ side is extracted: the stage, vertex inputs (vertex
+	// stage only), descriptor bindings, specialization constant ids and the byte range of the push
+	// constant block.
+	struct ShaderReflection {
+		VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+		std::vector<ShaderVertexInput> vertexInputs;
+		std::vector<ShaderDescriptorBinding> descriptorBindings;
+		// size is 0 when the module declares no push constant block
+		uint32_t pushConstantOffset = 0;
+		uint32_t pushConstantSize = 0;
+		// constant_id of every specialization constant, sorted
+		std::vector<uint32_t> specializationConstantIds;
+
+		// Throws if code is not a SPIR-V module or uses a vertex input type the engine cannot feed.
+		static ShaderReflection fromSpirv(const uint32_t* code, size_t codeSize);
+
+		// true when both use the same descriptor bindings and push constant range, so a pipeline
+		// built from one can replace a pipeline built from the other under the same layout
+		bool hasSameResourceInterface(const ShaderReflection& other) const;
+
+		// Vulkan requires a vertex attribute and the shader input it feeds to share their numeric
+		// type (float, signed or unsigned integer); component counts may differ.
+		static bool isCompatibleVertexFormat(VkFormat shaderFormat, VkFormat attributeFormat);
+	};
+
+} // namespace VulkanEngine
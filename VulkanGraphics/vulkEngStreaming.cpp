@@ -0,0 +1,394 @@
+#include "vulkEngStreaming.hpp"
+#include "vulkEngUploadBatch.hpp"
+#include "vulkEngCpuProfiler.hpp"
+
+//std
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace VulkanEngine {
+
+	namespace {
+		// a level index longer than this describes an image larger than Vulkan allows
+		constexpr size_t MAX_KTX2_LEVELS = 32;
+	}
+
+	VulkEngStreaming::VulkEngStreaming(VulkEngDevice& device, const StreamingConfig& config)
+		: vulkanDevice{ device }, config{ config }
+	{
+		if (config.ioThreads == 0 || config.maxPendingLoads == 0) {
+			throw std::runtime_error("failed to create streaming: needs at least one I/O thread and pending load!");
+		}
+		for (uint32_t i = 0; i < config.ioThreads; i++) {
+			workers.emplace_back(&VulkEngStreaming::run, this);
+		}
+	}
+
+	VulkEngStreaming::~VulkEngStreaming() {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+		jobAdded.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+		// the transfers must finish before the resources they write are destroyed
+		for (const Upload& upload : uploads) {
+			vulkanDevice.waitForUpload(upload.ticket);
+		}
+	}
+
+	StreamedTexture VulkEngStreaming::addTexture(const std::string& ktx2Path, const TextureOptions& options) {
+		Resource resource{};
+		resource.kind = Kind::Texture;
+		resource.path = ktx2Path;
+		resource.options = options;
+		resources.push_back(std::move(resource));
+		return { static_cast<uint32_t>(resources.size() - 1) };
+	}
+
+	StreamedMesh VulkEngStreaming::addMesh(uint32_t lodCount, MeshLoader loader) {
+		if (lodCount == 0 || !loader) {
+			throw std::runtime_error("failed to add streamed mesh: needs a loader and at least one LOD!");
+		}
+		Resource resource{};
+		resource.kind = Kind::Mesh;
+		resource.loader = std::move(loader);
+		resource.lodCount = lodCount;
+		resource.lodBytes.resize(lodCount, 0);
+		resources.push_back(std::move(resource));
+		return { static_cast<uint32_t>(resources.size() - 1) };
+	}
+
+	void VulkEngStreaming::requestTexture(StreamedTexture texture, float screenSize) {
+		Resource& resource = resources[texture.index];
+		resource.screenSize = resource.requested ? std::max(resource.screenSize, screenSize) : screenSize;
+		resource.requested = true;
+		resource.lastRequested = frameNumber;
+	}
+
+	void VulkEngStreaming::requestMesh(StreamedMesh mesh, uint32_t lod) {
+		Resource& resource = resources[mesh.index];
+		lod = std::min(lod, resource.lodCount - 1);
+		resource.wantedDetail = resource.requested ? std::min(resource.wantedDetail, lod) : lod;
+		resource.requested = true;
+		resource.lastRequested = frameNumber;
+	}
+
+	void VulkEngStreaming::update() {
+		VulkEngCpuScope scope{ "streaming" };
+		swapInFinishedUploads();
+		uploadCompletedLoads();
+		updateBudget();
+		evict();
+		startLoads();
+
+		for (Resource& resource : resources) {
+			resource.requested = false;
+		}
+		frameNumber++;
+	}
+
+	std::shared_ptr<VulkEngTexture> VulkEngStreaming::getTexture(StreamedTexture texture) const {
+		return resources[texture.index].texture;
+	}
+
+	std::shared_ptr<VulkEngModel> VulkEngStreaming::getMesh(StreamedMesh mesh) const {
+		return resources[mesh.index].mesh;
+	}
+
+	uint32_t VulkEngStreaming::getMeshLod(StreamedMesh mesh) const {
+		return resources[mesh.index].residentDetail;
+	}
+
+	void VulkEngStreaming::swapInFinishedUploads() {
+		auto finished = std::stable_partition(uploads.begin(), uploads.end(), [this](const Upload& upload) {
+			return !vulkanDevice.isUploadComplete(upload.ticket);
+		});
+		for (auto it = finished; it != uploads.end(); ++it) {
+			Resource& resource = resources[it->resource];
+			// an eviction may have happened meanwhile, leaving nothing resident
+			if (resource.residentDetail == NOT_RESIDENT || it->detail < resource.residentDetail) {
+				residentBytes -= resource.residentBytes;
+				resource.texture = std::move(it->texture);
+				resource.mesh = std::move(it->mesh);
+				resource.residentDetail = it->detail;
+				resource.residentBytes = it->bytes;
+				residentBytes += it->bytes;
+			}
+			resource.loading = false;
+			uploadingBytes -= it->bytes;
+			pendingLoads--;
+		}
+		uploads.erase(finished, uploads.end());
+	}
+
+	void VulkEngStreaming::uploadCompletedLoads() {
+		std::vector<LoadResult> completed;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			completed.swap(results);
+		}
+		if (completed.empty()) return;
+
+		VulkEngUploadBatch batch{ vulkanDevice };
+		size_t firstUpload = uploads.size();
+		for (LoadResult& result : completed) {
+			Resource& resource = resources[result.resource];
+			pendingBytes -= resource.loadingBytes;
+			resource.loadingBytes = 0;
+
+			Upload upload{};
+			upload.resource = result.resource;
+			upload.detail = result.detail;
+			if (!result.failed) {
+				try {
+					if (resource.kind == Kind::Texture) {
+						resource.info = std::move(result.info);
+						resource.hasInfo = true;
+						TextureOptions options = resource.options;
+						options.skipLevels = result.detail;
+						upload.texture = std::make_shared<VulkEngTexture>(vulkanDevice, batch, resource.info, result.levelData.data(), options);
+						upload.bytes = upload.texture->getMemorySize();
+					}
+					else {
+						upload.mesh = std::make_shared<VulkEngModel>(vulkanDevice, batch, result.vertices, config.meshPositionStreams);
+						upload.bytes = upload.mesh->getMemorySize();
+						resource.lodBytes[result.detail] = upload.bytes;
+					}
+				}
+				catch (const std::exception& e) {
+					std::cerr << "streaming: " << e.what() << std::endl;
+					result.failed = true;
+				}
+			}
+
+			if (result.failed) {
+				// not retried; the resident version, if any, stays
+				resource.failed = true;
+				resource.loading = false;
+				pendingLoads--;
+				continue;
+			}
+			uploadingBytes += upload.bytes;
+			uploads.push_back(std::move(upload));
+		}
+
+		if (!batch.isEmpty()) {
+			UploadTicket ticket = batch.submit();
+			for (size_t i = firstUpload; i < uploads.size(); i++) {
+				uploads[i].ticket = ticket;
+			}
+		}
+	}
+
+	void VulkEngStreaming::updateBudget() {
+		if (config.budget != 0) {
+			budget = config.budget;
+			return;
+		}
+		// the driver's usage includes what is streamed; only the rest is taken off the budget
+		MemoryBudget deviceBudget = vulkanDevice.getDeviceLocalBudget();
+		VkDeviceSize streamed = residentBytes + uploadingBytes;
+		VkDeviceSize others = deviceBudget.usage > streamed ? deviceBudget.usage - streamed : 0;
+		VkDeviceSize available = deviceBudget.budget > others ? deviceBudget.budget - others : 0;
+		budget = static_cast<VkDeviceSize>(static_cast<double>(available) * config.budgetFraction);
+	}
+
+	void VulkEngStreaming::evict() {
+		while (residentBytes + uploadingBytes + pendingBytes > budget) {
+			Resource* victim = nullptr;
+			for (Resource& resource : resources) {
+				if (resource.residentDetail == NOT_RESIDENT || resource.loading) continue;
+				if (frameNumber - resource.lastRequested <= config.evictionDelay) continue;
+				if (victim == nullptr || resource.lastRequested < victim->lastRequested) {
+					victim = &resource;
+				}
+			}
+			// everything resident is still in use
+			if (victim == nullptr) return;
+
+			// frames still in flight keep using it; the destructors defer destruction
+			victim->texture.reset();
+			victim->mesh.reset();
+			victim->residentDetail = NOT_RESIDENT;
+			residentBytes -= victim->residentBytes;
+			victim->residentBytes = 0;
+		}
+	}
+
+	void VulkEngStreaming::startLoads() {
+		std::vector<uint32_t> candidates;
+		for (uint32_t i = 0; i < resources.size(); i++) {
+			Resource& resource = resources[i];
+			if (!resource.requested || resource.loading || resource.failed) continue;
+			if (resource.kind == Kind::Texture) {
+				resource.wantedDetail = resource.hasInfo ? skipForScreenSize(resource.info, resource.screenSize) : 0;
+			}
+			if (resource.residentDetail == NOT_RESIDENT || resource.wantedDetail < resource.residentDetail) {
+				candidates.push_back(i);
+			}
+		}
+
+		// missing resources first, then the largest gain in detail
+		std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+			const Resource& first = resources[a];
+			const Resource& second = resources[b];
+			bool firstMissing = first.residentDetail == NOT_RESIDENT;
+			bool secondMissing = second.residentDetail == NOT_RESIDENT;
+			if (firstMissing != secondMissing) return firstMissing;
+			return first.residentDetail - first.wantedDetail > second.residentDetail - second.wantedDetail;
+		});
+
+		std::vector<Job> newJobs;
+		for (uint32_t index : candidates) {
+			if (pendingLoads >= config.maxPendingLoads) break;
+			Resource& resource = resources[index];
+			VkDeviceSize used = residentBytes + uploadingBytes + pendingBytes;
+			VkDeviceSize free = budget > used ? budget - used : 0;
+
+			// the most detail that fits, but never less than what is resident
+			uint32_t coarsest = resource.kind == Kind::Texture
+				? (resource.hasInfo ? static_cast<uint32_t>(resource.info.levels.size()) - 1 : 0)
+				: resource.lodCount - 1;
+			if (resource.residentDetail != NOT_RESIDENT) {
+				coarsest = std::min(coarsest, resource.residentDetail - 1);
+			}
+			uint32_t detail = resource.wantedDetail;
+			while (detail < coarsest && estimateBytes(resource, detail) > free) {
+				detail++;
+			}
+			VkDeviceSize bytes = estimateBytes(resource, detail);
+			if (bytes > free) continue;
+
+			Job job{};
+			job.resource = index;
+			job.kind = resource.kind;
+			job.detail = resource.kind == Kind::Texture && !resource.hasInfo ? LEVEL_FROM_SCREEN_SIZE : detail;
+			job.screenSize = resource.screenSize;
+			job.path = resource.path;
+			job.loader = resource.loader;
+			newJobs.push_back(std::move(job));
+
+			resource.loading = true;
+			resource.loadingBytes = bytes;
+			pendingBytes += bytes;
+			pendingLoads++;
+		}
+
+		if (newJobs.empty()) return;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			for (Job& job : newJobs) {
+				jobs.push_back(std::move(job));
+			}
+		}
+		jobAdded.notify_all();
+	}
+
+	VkDeviceSize VulkEngStreaming::estimateBytes(const Resource& resource, uint32_t detail) const {
+		if (resource.kind == Kind::Mesh) {
+			return resource.lodBytes[detail];
+		}
+		if (!resource.hasInfo) {
+			return 0;
+		}
+		// the file's levels are close to their size in memory
+		VkDeviceSize bytes = 0;
+		for (size_t level = resource.info.clampSkip(detail); level < resource.info.levels.size(); level++) {
+			bytes += resource.info.levels[level].length;
+		}
+		// a single level grows by a third once its chain is generated
+		if (resource.info.levels.size() == 1 && resource.options.generateMips) {
+			bytes += bytes / 3;
+		}
+		return bytes;
+	}
+
+	uint32_t VulkEngStreaming::skipForScreenSize(const Ktx2Info& info, float screenSize) {
+		uint32_t size = std::max(info.width, info.height);
+		uint32_t skip = 0;
+		while (skip + 1 < info.levels.size() && static_cast<float>(size >> (skip + 1)) >= std::max(1.0f, screenSize)) {
+			skip++;
+		}
+		return skip;
+	}
+
+	void VulkEngStreaming::run() {
+		VulkEngCpuProfiler::setThreadName("streaming io");
+		while (true) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				jobAdded.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (stopping) return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+
+			LoadResult result{};
+			result.resource = job.resource;
+			result.detail = job.detail;
+			try {
+				VulkEngCpuScope scope{ "streamLoad" };
+				load(job, result);
+			}
+			catch (const std::exception& e) {
+				std::cerr << "streaming: " << e.what() << std::endl;
+				result.failed = true;
+			}
+
+			std::lock_guard<std::mutex> lock{ mutex };
+			results.push_back(std::move(result));
+		}
+	}
+
+	void VulkEngStreaming::load(const Job& job, LoadResult& result) {
+		if (job.kind == Kind::Texture) {
+			readTexture(job, result);
+			return;
+		}
+		result.vertices = job.loader(job.detail);
+	}
+
+	// Reads the header and level index, then only the levels kept, never the whole file.
+	void VulkEngStreaming::readTexture(const Job& job, LoadResult& result) {
+		std::ifstream file{ job.path, std::ios::binary };
+		if (!file) {
+			throw std::runtime_error("failed to open texture " + job.path + "!");
+		}
+
+		std::vector<uint8_t> header(Ktx2Info::HEADER_SIZE);
+		file.read(reinterpret_cast<char*>(header.data()), header.size());
+		size_t headerRead = static_cast<size_t>(file.gcount());
+		if (headerRead == Ktx2Info::HEADER_SIZE) {
+			size_t indexSize = std::min(Ktx2Info::levelIndexSize(header.data()), MAX_KTX2_LEVELS * Ktx2Info::LEVEL_INDEX_ENTRY_SIZE);
+			header.resize(Ktx2Info::HEADER_SIZE + indexSize);
+			file.read(reinterpret_cast<char*>(header.data()) + Ktx2Info::HEADER_SIZE, indexSize);
+			headerRead += static_cast<size_t>(file.gcount());
+		}
+		result.info = Ktx2Info::read(header.data(), headerRead, job.path);
+
+		uint32_t skip = job.detail == LEVEL_FROM_SCREEN_SIZE
+			? skipForScreenSize(result.info, job.screenSize)
+			: result.info.clampSkip(job.detail);
+		Ktx2Info::Level range = result.info.levelRange(skip);
+		file.clear();
+		file.seekg(0, std::ios::end);
+		// checked before allocating, a bogus level index may ask for any length
+		if (range.offset + range.length > static_cast<uint64_t>(file.tellg())) {
+			throw std::runtime_error("failed to load texture " + job.path + ": truncated level data!");
+		}
+		result.levelData.resize(range.length);
+		file.seekg(static_cast<std::streamoff>(range.offset));
+		file.read(reinterpret_cast<char*>(result.levelData.data()), range.length);
+		if (static_cast<uint64_t>(file.gcount()) != range.length) {
+			throw std::runtime_error("failed to load texture " + job.path + ": truncated level data!");
+		}
+		result.detail = skip;
+	}
+
+} // namespace VulkanEngine
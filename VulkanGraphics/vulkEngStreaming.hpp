@@ -0,0 +1,188 @@
+#pragma once
+
+#include "vulkEngDevice.hpp"
+#include "vulkEngModel.hpp"
+#include "vulkEngTexture.hpp"
+
+//std
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace VulkanEngine {
+
+	struct StreamingConfig {
+		// bytes of device local memory streamed resources may use; 0 derives it from the device's
+		// memory budget every frame
+		VkDeviceSize budget = 0;
+		// of the device local memory left after everything else the process allocated
+		float budgetFraction = 0.8f;
+		uint32_t ioThreads = 2;
+		// frames a resource stays resident after it was last requested, even when over budget
+		uint32_t evictionDelay = 120;
+		// loads being read or uploaded at once
+		uint32_t maxPendingLoads = 8;
+		// builds meshes with the position only stream a depth prepass draws with, see VulkEngModel
+		bool meshPositionStreams = false;
+	};
+
+	// Identify resources of one VulkEngStreaming.
+	struct StreamedTexture {
+		uint32_t index = ~0u;
+	};
+
+	struct StreamedMesh {
+		uint32_t index = ~0u;
+	};
+
+	// Keeps textures and meshes resident in device local memory only while something asks for
+	// them. Each frame the renderer requests what it is about to draw, with the detail it needs on
+	// screen; update then starts loading the mips or LODs missing, as far as the memory budget allows,
+	// and evicts the least recently requested resources once over it. Files are read, and meshes
+	// built, on background threads; resources are created and uploaded on the thread calling update.
+	//
+	// A resource keeps its resident version until a more detailed one has finished uploading, so it
+	// never disappears while it is being drawn.
+	class VulkEngStreaming {
+
+	public:
+		// Builds the vertices of one LOD, 0 being the most detailed. Called on an I/O thread; throws
+		// to fail the load.
+		using MeshLoader = std::function<std::vector<VulkEngModel::Vertex>(uint32_t lod)>;
+
+		VulkEngStreaming(VulkEngDevice& device, const StreamingConfig& config = {});
+		~VulkEngStreaming();
+
+		VulkEngStreaming(const VulkEngStreaming&) = delete;
+		VulkEngStreaming& operator=(const VulkEngStreaming&) = delete;
+
+		// Registers a KTX2 file, see VulkEngTexture; nothing is read until it is requested.
+		// options.skipLevels is ignored, the streamer picks the levels.
+		StreamedTexture addTexture(const std::string& ktx2Path, const TextureOptions& options = {});
+		StreamedMesh addMesh(uint32_t lodCount, MeshLoader loader);
+
+		// screenSize is the most pixels the texture spans on screen along either axis; levels larger
+		// than that are not loaded.
+		void requestTexture(StreamedTexture texture, float screenSize);
+		void requestMesh(StreamedMesh mesh, uint32_t lod);
+
+		// Call once per frame on the rendering thread, after VulkEngRenderer::beginFrame. Swaps in
+		// the uploads that have finished, evicts and starts new loads.
+		void update();
+
+		// null until the first load has finished, or after eviction; the pointer keeps the resource
+		// alive for as long as it is held
+		std::shared_ptr<VulkEngTexture> getTexture(StreamedTexture texture) const;
+		std::shared_ptr<VulkEngModel> getMesh(StreamedMesh mesh) const;
+		// of the resident version, ~0u when none is
+		uint32_t getMeshLod(StreamedMesh mesh) const;
+
+		VkDeviceSize getBudget() const { return budget; }
+		VkDeviceSize getResidentBytes() const { return residentBytes; }
+		size_t getPendingLoadCount() const { return pendingLoads; }
+
+	private:
+		static constexpr uint32_t NOT_RESIDENT = ~0u;
+		// the I/O thread picks the level, from the file's header
+		static constexpr uint32_t LEVEL_FROM_SCREEN_SIZE = ~0u;
+
+		enum class Kind { Texture, Mesh };
+
+		// The detail is the skipped mip levels of a texture or the LOD of a mesh; lower is more detailed.
+		struct Resource {
+			Kind kind;
+			std::string path;
+			TextureOptions options;
+			MeshLoader loader;
+			uint32_t lodCount = 1;
+
+			std::shared_ptr<VulkEngTexture> texture;
+			std::shared_ptr<VulkEngModel> mesh;
+			uint32_t residentDetail = NOT_RESIDENT;
+			VkDeviceSize residentBytes = 0;
+
+			uint64_t lastRequested = 0;
+			bool requested = false;
+			uint32_t wantedDetail = 0;
+			float screenSize = 0.0f;
+
+			bool loading = false;
+			// what the load in progress was expected to take, until it is uploaded
+			VkDeviceSize loadingBytes = 0;
+			bool failed = false;
+			// known after the first load
+			bool hasInfo = false;
+			Ktx2Info info{};
+			// device memory of every LOD loaded so far, 0 if never
+			std::vector<VkDeviceSize> lodBytes;
+		};
+
+		struct Job {
+			uint32_t resource;
+			Kind kind;
+			uint32_t detail;
+			float screenSize;
+			// copies, so the I/O threads never touch resources
+			std::string path;
+			MeshLoader loader;
+		};
+
+		// what an I/O thread hands back for the rendering thread to upload
+		struct LoadResult {
+			uint32_t resource;
+			uint32_t detail;
+			bool failed = false;
+			Ktx2Info info{};
+			std::vector<uint8_t> levelData;
+			std::vector<VulkEngModel::Vertex> vertices;
+		};
+
+		struct Upload {
+			uint32_t resource;
+			uint32_t detail;
+			UploadTicket ticket;
+			std::shared_ptr<VulkEngTexture> texture;
+			std::shared_ptr<VulkEngModel> mesh;
+			VkDeviceSize bytes;
+		};
+
+		void uploadCompletedLoads();
+		void swapInFinishedUploads();
+		void updateBudget();
+		void evict();
+		void startLoads();
+		// bytes a load at detail needs; 0 when it cannot be known before loading
+		VkDeviceSize estimateBytes(const Resource& resource, uint32_t detail) const;
+		static uint32_t skipForScreenSize(const Ktx2Info& info, float screenSize);
+
+		void run();
+		void load(const Job& job, LoadResult& result);
+		void readTexture(const Job& job, LoadResult& result);
+
+		VulkEngDevice& vulkanDevice;
+		StreamingConfig config;
+		std::vector<Resource> resources;
+		std::vector<Upload> uploads;
+		uint64_t frameNumber = 0;
+		VkDeviceSize budget = 0;
+		VkDeviceSize residentBytes = 0;
+		// loads being read, by estimate, and being uploaded
+		VkDeviceSize pendingBytes = 0;
+		VkDeviceSize uploadingBytes = 0;
+		size_t pendingLoads = 0;
+
+		std::mutex mutex;
+		std::condition_variable jobAdded;
+		std::deque<Job> jobs;
+		std::vector<LoadResult> results;
+		bool stopping = false;
+		std::vector<std::thread> workers;
+	};
+
+} // namespace VulkanEngine
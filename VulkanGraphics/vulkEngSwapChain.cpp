@@ -1,23 +1,44 @@
 #include "vulkEngSwapChain.hpp"
+#include "vulkEngCpuProfiler.hpp"
 
 // std
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <limits>
 #include <set>
 #include <stdexcept>
 
 namespace VulkanEngine {
 
-VulkEngSwapChain::VulkEngSwapChain(VulkEngDevice &deviceRef, VkExtent2D extent)
-    : device{deviceRef}, windowExtent{extent} {
+VulkEngSwapChain::VulkEngSwapChain(
+    VulkEngDevice &deviceRef,
+    VkExtent2D extent,
+    PresentPolicy policy,
+    VkSampleCountFlagBits samples,
+    bool passAttachments)
+    : presentPolicy{policy},
+      sampleCount{samples},
+      passAttachments{passAttachments},
+      device{deviceRef},
+      windowExtent{extent} {
     init();
 }
 
-VulkEngSwapChain::VulkEngSwapChain(VulkEngDevice& deviceRef, VkExtent2D extent, std::shared_ptr<VulkEngSwapChain> previous)
-    : device{ deviceRef }, windowExtent{ extent }, oldSwapChain{ previous } {
+VulkEngSwapChain::VulkEngSwapChain(
+    VulkEngDevice &deviceRef,
+    VkExtent2D extent,
+    PresentPolicy policy,
+    VkSampleCountFlagBits samples,
+    bool passAttachments,
+    std::shared_ptr<VulkEngSwapChain> previous)
+    : presentPolicy{policy},
+      sampleCount{samples},
+      passAttachments{passAttachments},
+      device{deviceRef},
+      windowExtent{extent},
+      oldSwapChain{previous} {
     init();
 
 	//clean up old swap chain since it's no longer needed
@@ -27,9 +48,18 @@ VulkEngSwapChain::VulkEngSwapChain(VulkEngDevice& deviceRef, VkExtent2D extent,
 void VulkEngSwapChain::init() {
   createSwapChain();
   createImageViews();
-  createRenderPass();
-  createDepthResources();
-  createFramebuffers();
+  // render graphs create their depth images in this format
+  swapChainDepthFormat = findDepthFormat();
+  if (passAttachments) {
+    createDepthResources();
+    createColorResources();
+  }
+  // with dynamic rendering the renderer begins rendering straight into the image views, so a
+  // resize only recreates the images
+  if (passAttachments && !device.supportsDynamicRendering()) {
+    createRenderPass();
+    createFramebuffers();
+  }
   createSyncObjects();
 }
 
@@ -44,20 +74,34 @@ VulkEngSwapChain::~VulkEngSwapChain() {
     swapChain = nullptr;
   }
 
+  for (size_t i = 0; i < offscreenImageMemorys.size(); i++) {
+    vkDestroyImage(device.device(), swapChainImages[i], nullptr);
+    vkFreeMemory(device.device(), offscreenImageMemorys[i], nullptr);
+  }
+
   for (int i = 0; i < depthImages.size(); i++) {
     vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
     vkDestroyImage(device.device(), depthImages[i], nullptr);
     vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
   }
 
+  for (size_t i = 0; i < colorImages.size(); i++) {
+    vkDestroyImageView(device.device(), colorImageViews[i], nullptr);
+    vkDestroyImage(device.device(), colorImages[i], nullptr);
+    vkFreeMemory(device.device(), colorImageMemorys[i], nullptr);
+  }
+
   for (auto framebuffer : swapChainFramebuffers) {
     vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
   }
 
-  vkDestroyRenderPass(device.device(), renderPass, nullptr);
+  if (renderPass != VK_NULL_HANDLE) {
+    vkDestroyRenderPass(device.device(), renderPass, nullptr);
+  }
 
   // cleanup synchronization objects
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  // a retired swap chain has handed these over to its successor and owns none
+  for (size_t i = 0; i < inFlightFences.size(); i++) {
     vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
     vkDestroyFence(device.device(), inFlightFences[i], nullptr);
@@ -65,13 +109,22 @@ VulkEngSwapChain::~VulkEngSwapChain() {
 }
 
 VkResult VulkEngSwapChain::acquireNextImage(uint32_t *imageIndex) {
-  vkWaitForFences(
-      device.device(),
-      1,
-      &inFlightFences[currentFrame],
-      VK_TRUE,
-      std::numeric_limits<uint64_t>::max());
+  {
+    VulkEngCpuScope scope{"waitForFrameFence"};
+    vkWaitForFences(
+        device.device(),
+        1,
+        &inFlightFences[currentFrame],
+        VK_TRUE,
+        std::numeric_limits<uint64_t>::max());
+  }
 
+  if (device.isHeadless()) {
+    *imageIndex = static_cast<uint32_t>(currentFrame % swapChainImages.size());
+    return VK_SUCCESS;
+  }
+
+  VulkEngCpuScope scope{"vkAcquireNextImageKHR"};
   VkResult result = vkAcquireNextImageKHR(
       device.device(),
       swapChain,
@@ -86,6 +139,7 @@ VkResult VulkEngSwapChain::acquireNextImage(uint32_t *imageIndex) {
 VkResult VulkEngSwapChain::submitCommandBuffers(
     const VkCommandBuffer *buffers, uint32_t *imageIndex) {
   if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
+    VulkEngCpuScope scope{"waitForImageFence"};
     vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
   }
   imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
@@ -93,9 +147,10 @@ VkResult VulkEngSwapChain::submitCommandBuffers(
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+  // nothing is acquired or presented without a surface
   VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
   VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
+  submitInfo.waitSemaphoreCount = device.isHeadless() ? 0 : 1;
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
 
@@ -103,13 +158,21 @@ VkResult VulkEngSwapChain::submitCommandBuffers(
   submitInfo.pCommandBuffers = buffers;
 
   VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.signalSemaphoreCount = device.isHeadless() ? 0 : 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
   vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-  if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to submit draw command buffer!");
+  {
+    VulkEngCpuScope scope{"vkQueueSubmit"};
+    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to submit draw command buffer!");
+    }
+  }
+
+  if (device.isHeadless()) {
+    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    return VK_SUCCESS;
   }
 
   VkPresentInfoKHR presentInfo = {};
@@ -124,7 +187,11 @@ VkResult VulkEngSwapChain::submitCommandBuffers(
 
   presentInfo.pImageIndices = imageIndex;
 
-  auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+  VkResult result;
+  {
+    VulkEngCpuScope scope{"vkQueuePresentKHR"};
+    result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+  }
 
   currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
@@ -132,17 +199,17 @@ VkResult VulkEngSwapChain::submitCommandBuffers(
 }
 
 void VulkEngSwapChain::createSwapChain() {
+  if (device.isHeadless()) {
+    createOffscreenImages();
+    return;
+  }
+
   SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
   VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-  VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+  presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
   VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
-
-  uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-  if (swapChainSupport.capabilities.maxImageCount > 0 &&
-      imageCount > swapChainSupport.capabilities.maxImageCount) {
-    imageCount = swapChainSupport.capabilities.maxImageCount;
-  }
+  uint32_t imageCount = chooseImageCount(swapChainSupport.capabilities);
 
   VkSwapchainCreateInfoKHR createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -153,7 +220,12 @@ void VulkEngSwapChain::createSwapChain() {
   createInfo.imageColorSpace = surfaceFormat.colorSpace;
   createInfo.imageExtent = extent;
   createInfo.imageArrayLayers = 1;
-  createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  // a transfer destination for frames rendered at a lower resolution and blitted up, and a
+  // transfer source for frames read back
+  imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+               (swapChainSupport.capabilities.supportedUsageFlags &
+                (VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT));
+  createInfo.imageUsage = imageUsage;
 
   QueueFamilyIndices indices = device.findPhysicalQueueFamilies();
   uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.presentFamily};
@@ -192,6 +264,40 @@ void VulkEngSwapChain::createSwapChain() {
   swapChainExtent = extent;
 }
 
+void VulkEngSwapChain::createOffscreenImages() {
+  swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+  swapChainExtent = windowExtent;
+  presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+  imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+               VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+  swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+  offscreenImageMemorys.resize(MAX_FRAMES_IN_FLIGHT);
+  for (size_t i = 0; i < swapChainImages.size(); i++) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = swapChainExtent.width;
+    imageInfo.extent.height = swapChainExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = swapChainImageFormat;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = imageUsage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.flags = 0;
+
+    device.createImageWithInfo(
+        imageInfo,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        swapChainImages[i],
+        offscreenImageMemorys[i]);
+  }
+}
+
 void VulkEngSwapChain::createImageViews() {
   swapChainImageViews.resize(swapChainImages.size());
   for (size_t i = 0; i < swapChainImages.size(); i++) {
@@ -216,7 +322,7 @@ void VulkEngSwapChain::createImageViews() {
 void VulkEngSwapChain::createRenderPass() {
   VkAttachmentDescription depthAttachment{};
   depthAttachment.format = findDepthFormat();
-  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.samples = sampleCount;
   depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
   depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
@@ -236,33 +342,51 @@ void VulkEngSwapChain::createRenderPass() {
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  colorAttachment.finalLayout = device.isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                                    : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
   VkAttachmentReference colorAttachmentRef = {};
   colorAttachmentRef.attachment = 0;
   colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+  // Multisampled, attachment 0 is the multisampled color image, only ever in tile memory, and the
+  // swap chain image becomes attachment 2, written by the resolve at the end of the subpass.
+  VkAttachmentDescription resolveAttachment = colorAttachment;
+  resolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  VkAttachmentReference resolveAttachmentRef = {};
+  resolveAttachmentRef.attachment = 2;
+  resolveAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  if (usesMultisampling()) {
+    colorAttachment.samples = sampleCount;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  }
+
   VkSubpassDescription subpass = {};
   subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
   subpass.colorAttachmentCount = 1;
   subpass.pColorAttachments = &colorAttachmentRef;
+  subpass.pResolveAttachments = usesMultisampling() ? &resolveAttachmentRef : nullptr;
   subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
   VkSubpassDependency dependency = {};
   dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.srcAccessMask = 0;
-  dependency.srcStageMask =
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  // the multisampled color image may be shared with the previous frame, like depth
+  dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                             (usesMultisampling() ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0);
+  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
   dependency.dstSubpass = 0;
   dependency.dstStageMask =
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
   dependency.dstAccessMask =
       VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
-  std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+  std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, resolveAttachment};
   VkRenderPassCreateInfo renderPassInfo = {};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+  renderPassInfo.attachmentCount = usesMultisampling() ? 3 : 2;
   renderPassInfo.pAttachments = attachments.data();
   renderPassInfo.subpassCount = 1;
   renderPassInfo.pSubpasses = &subpass;
@@ -275,15 +399,21 @@ void VulkEngSwapChain::createRenderPass() {
 }
 
 void VulkEngSwapChain::createFramebuffers() {
-  swapChainFramebuffers.resize(imageCount());
-  for (size_t i = 0; i < imageCount(); i++) {
-    std::array<VkImageView, 2> attachments = {swapChainImageViews[i], depthImageViews[i]};
+  // one per pairing of swap chain image and depth image, see getFrameBuffer
+  swapChainFramebuffers.resize(imageCount() * depthImages.size());
+  for (size_t f = 0; f < swapChainFramebuffers.size(); f++) {
+    size_t i = f % imageCount();
+    size_t d = f / imageCount();
+    std::array<VkImageView, 3> attachments = {swapChainImageViews[i], depthImageViews[d], VK_NULL_HANDLE};
+    if (usesMultisampling()) {
+      attachments = {colorImageViews[d], depthImageViews[d], swapChainImageViews[i]};
+    }
 
     VkExtent2D swapChainExtent = getSwapChainExtent();
     VkFramebufferCreateInfo framebufferInfo = {};
     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     framebufferInfo.renderPass = renderPass;
-    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.attachmentCount = usesMultisampling() ? 3 : 2;
     framebufferInfo.pAttachments = attachments.data();
     framebufferInfo.width = swapChainExtent.width;
     framebufferInfo.height = swapChainExtent.height;
@@ -293,22 +423,135 @@ void VulkEngSwapChain::createFramebuffers() {
             device.device(),
             &framebufferInfo,
             nullptr,
-            &swapChainFramebuffers[i]) != VK_SUCCESS) {
+            &swapChainFramebuffers[f]) != VK_SUCCESS) {
       throw std::runtime_error("failed to create framebuffer!");
     }
   }
 }
 
 void VulkEngSwapChain::createDepthResources() {
-  VkFormat depthFormat = findDepthFormat();
-  swapChainDepthFormat = depthFormat;
+  VkFormat depthFormat = swapChainDepthFormat;
+
+  // Depth is cleared and discarded every frame, so it never needs one image per swap chain image.
+  // Where memory can be lazily allocated (tile based GPUs) a single image lives in tile memory
+  // only; elsewhere every frame in flight gets its own, so consecutive frames can still overlap.
+  VkImage firstImage = createDepthImage(depthFormat);
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device.device(), firstImage, &memRequirements);
+  uint32_t lazyType;
+  lazilyAllocatedDepth = device.tryFindMemoryType(
+      memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, lazyType);
+  size_t depthImageCount = lazilyAllocatedDepth ? 1 : MAX_FRAMES_IN_FLIGHT;
+
+  depthImages.resize(depthImageCount);
+  depthImageMemorys.resize(depthImageCount);
+  depthImageMemorySizes.resize(depthImageCount);
+  depthImageMemoryTypes.resize(depthImageCount);
+  depthImageViews.resize(depthImageCount);
+
+  for (size_t i = 0; i < depthImages.size(); i++) {
+    depthImages[i] = i == 0 ? firstImage : createDepthImage(depthFormat);
+    bindDepthImageMemory(i);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = depthImages[i];
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = depthFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device.device(), &viewInfo, nullptr, &depthImageViews[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create texture image view!");
+    }
+  }
+}
+
+VkImage VulkEngSwapChain::createDepthImage(VkFormat depthFormat) {
   VkExtent2D swapChainExtent = getSwapChainExtent();
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = swapChainExtent.width;
+  imageInfo.extent.height = swapChainExtent.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = depthFormat;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage =
+      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+  imageInfo.samples = sampleCount;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.flags = 0;
+
+  VkImage image;
+  if (vkCreateImage(device.device(), &imageInfo, nullptr, &image) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create image!");
+  }
+  return image;
+}
 
-  depthImages.resize(imageCount());
-  depthImageMemorys.resize(imageCount());
-  depthImageViews.resize(imageCount());
+void VulkEngSwapChain::bindDepthImageMemory(size_t index) {
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device.device(), depthImages[index], &memRequirements);
+
+  // Take over the previous swap chain's allocation when the new image fits into it (the usual
+  // case when a window shrinks). Depth is cleared every frame and the render pass dependency
+  // orders depth writes against earlier submissions, so aliasing the retired image is safe.
+  if (oldSwapChain != nullptr && index < oldSwapChain->depthImageMemorys.size()) {
+    VkDeviceMemory &previous = oldSwapChain->depthImageMemorys[index];
+    uint32_t previousType = oldSwapChain->depthImageMemoryTypes[index];
+    if (previous != VK_NULL_HANDLE &&
+        oldSwapChain->depthImageMemorySizes[index] >= memRequirements.size &&
+        (memRequirements.memoryTypeBits & (1u << previousType))) {
+      depthImageMemorys[index] = previous;
+      depthImageMemorySizes[index] = oldSwapChain->depthImageMemorySizes[index];
+      depthImageMemoryTypes[index] = previousType;
+      previous = VK_NULL_HANDLE;
+    }
+  }
 
-  for (int i = 0; i < depthImages.size(); i++) {
+  if (depthImageMemorys[index] == VK_NULL_HANDLE) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = device.findMemoryType(
+        memRequirements.memoryTypeBits,
+        lazilyAllocatedDepth ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
+                             : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkAllocateMemory(device.device(), &allocInfo, nullptr, &depthImageMemorys[index]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate image memory!");
+    }
+    depthImageMemorySizes[index] = allocInfo.allocationSize;
+    depthImageMemoryTypes[index] = allocInfo.memoryTypeIndex;
+  }
+
+  if (vkBindImageMemory(device.device(), depthImages[index], depthImageMemorys[index], 0) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to bind image memory!");
+  }
+}
+
+void VulkEngSwapChain::createColorResources() {
+  if (!usesMultisampling()) {
+    return;
+  }
+
+  // The multisampled samples are only needed until they are resolved at the end of the pass, so
+  // like depth they are never stored and can live in lazily allocated memory. One image per depth
+  // image keeps the framebuffer pairing of getFrameBuffer.
+  VkExtent2D swapChainExtent = getSwapChainExtent();
+  colorImages.resize(depthImages.size());
+  colorImageMemorys.resize(depthImages.size());
+  colorImageViews.resize(depthImages.size());
+  for (size_t i = 0; i < colorImages.size(); i++) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -317,42 +560,74 @@ void VulkEngSwapChain::createDepthResources() {
     imageInfo.extent.depth = 1;
     imageInfo.mipLevels = 1;
     imageInfo.arrayLayers = 1;
-    imageInfo.format = depthFormat;
+    imageInfo.format = swapChainImageFormat;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    imageInfo.samples = sampleCount;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.flags = 0;
 
-    device.createImageWithInfo(
-        imageInfo,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        depthImages[i],
-        depthImageMemorys[i]);
+    if (vkCreateImage(device.device(), &imageInfo, nullptr, &colorImages[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device.device(), colorImages[i], &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    if (!device.tryFindMemoryType(
+            memRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+            allocInfo.memoryTypeIndex)) {
+      allocInfo.memoryTypeIndex = device.findMemoryType(
+          memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    if (vkAllocateMemory(device.device(), &allocInfo, nullptr, &colorImageMemorys[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate image memory!");
+    }
+    if (vkBindImageMemory(device.device(), colorImages[i], colorImageMemorys[i], 0) != VK_SUCCESS) {
+      throw std::runtime_error("failed to bind image memory!");
+    }
 
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = depthImages[i];
+    viewInfo.image = colorImages[i];
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = depthFormat;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.format = swapChainImageFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     viewInfo.subresourceRange.baseMipLevel = 0;
     viewInfo.subresourceRange.levelCount = 1;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
-    if (vkCreateImageView(device.device(), &viewInfo, nullptr, &depthImageViews[i]) != VK_SUCCESS) {
+    if (vkCreateImageView(device.device(), &viewInfo, nullptr, &colorImageViews[i]) != VK_SUCCESS) {
       throw std::runtime_error("failed to create texture image view!");
     }
   }
 }
 
 void VulkEngSwapChain::createSyncObjects() {
+  imagesInFlight.assign(imageCount(), VK_NULL_HANDLE);
+
+  // Continue the previous swap chain's frame sequence with its semaphores and fences, so the
+  // next frame still waits on the work the retired swap chain submitted for that frame slot.
+  if (oldSwapChain != nullptr) {
+    imageAvailableSemaphores = std::move(oldSwapChain->imageAvailableSemaphores);
+    renderFinishedSemaphores = std::move(oldSwapChain->renderFinishedSemaphores);
+    inFlightFences = std::move(oldSwapChain->inFlightFences);
+    oldSwapChain->imageAvailableSemaphores.clear();
+    oldSwapChain->renderFinishedSemaphores.clear();
+    oldSwapChain->inFlightFences.clear();
+    currentFrame = oldSwapChain->currentFrame;
+    return;
+  }
+
   imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -386,21 +661,27 @@ VkSurfaceFormatKHR VulkEngSwapChain::chooseSwapSurfaceFormat(
 
 VkPresentModeKHR VulkEngSwapChain::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
-  for (const auto &availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      std::cout << "Present mode: Mailbox" << std::endl;
-      return availablePresentMode;
-    }
+  std::vector<VkPresentModeKHR> preferred;
+  switch (presentPolicy) {
+    case PresentPolicy::LowLatency:
+      preferred = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+      break;
+    case PresentPolicy::Uncapped:
+      preferred = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+      break;
+    case PresentPolicy::PowerSaving:
+    case PresentPolicy::VSync:
+      break;
   }
 
-  // for (const auto &availablePresentMode : availablePresentModes) {
-  //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-  //     std::cout << "Present mode: Immediate" << std::endl;
-  //     return availablePresentMode;
-  //   }
-  // }
+  for (VkPresentModeKHR mode : preferred) {
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(), mode) !=
+        availablePresentModes.end()) {
+      return mode;
+    }
+  }
 
-  std::cout << "Present mode: V-Sync" << std::endl;
+  // fifo is the only mode every implementation is required to support
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -420,6 +701,20 @@ VkExtent2D VulkEngSwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &ca
   }
 }
 
+uint32_t VulkEngSwapChain::chooseImageCount(const VkSurfaceCapabilitiesKHR &capabilities) {
+  // mailbox and immediate need a spare image to never block; fifo with fewer images means
+  // less queued work, which is what power saving and latency-bound fifo fallback want
+  uint32_t imageCount = capabilities.minImageCount + 1;
+  if (presentPolicy == PresentPolicy::PowerSaving ||
+      (presentPolicy == PresentPolicy::LowLatency && presentMode == VK_PRESENT_MODE_FIFO_KHR)) {
+    imageCount = capabilities.minImageCount;
+  }
+  if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+    imageCount = capabilities.maxImageCount;
+  }
+  return imageCount;
+}
+
 VkFormat VulkEngSwapChain::findDepthFormat() {
   return device.findSupportedFormat(
       {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
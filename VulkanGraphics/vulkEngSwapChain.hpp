@@ -12,25 +12,70 @@
 
 namespace VulkanEngine {
 
+// Latency/throughput trade-off used to pick the present mode and image count.
+enum class PresentPolicy {
+  LowLatency,   // mailbox, then immediate, then fifo
+  PowerSaving,  // fifo with as few images as the surface allows
+  Uncapped,     // immediate, then mailbox, then fifo (benchmarking)
+  VSync         // fifo
+};
+
 class VulkEngSwapChain {
  public:
   static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
-  VulkEngSwapChain(VulkEngDevice& deviceRef, VkExtent2D windowExtent);
-  VulkEngSwapChain(VulkEngDevice &deviceRef, VkExtent2D windowExtent,std::shared_ptr<VulkEngSwapChain> previous);
+  // samples above 1 render into multisampled color and depth images, resolved into the swap
+  // chain image at the end of the pass; see VulkEngDevice::getUsableSampleCount. Without
+  // passAttachments the depth and multisampled color images, render pass and framebuffers are not
+  // created, for callers that render through a render graph, which has attachments of its own.
+  VulkEngSwapChain(
+      VulkEngDevice &deviceRef,
+      VkExtent2D windowExtent,
+      PresentPolicy policy,
+      VkSampleCountFlagBits samples,
+      bool passAttachments);
+  VulkEngSwapChain(
+      VulkEngDevice &deviceRef,
+      VkExtent2D windowExtent,
+      PresentPolicy policy,
+      VkSampleCountFlagBits samples,
+      bool passAttachments,
+      std::shared_ptr<VulkEngSwapChain> previous);
   ~VulkEngSwapChain();
 
   VulkEngSwapChain(const VulkEngSwapChain &) = delete;
   VulkEngSwapChain &operator=(const VulkEngSwapChain &) = delete;
 
-  VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
+  // both null when the device renders dynamically, see usesDynamicRendering
+  VkFramebuffer getFrameBuffer(int imageIndex, int frameIndex) {
+    return swapChainFramebuffers[depthIndex(frameIndex) * imageCount() + imageIndex];
+  }
   VkRenderPass getRenderPass() { return renderPass; }
+  bool usesDynamicRendering() const { return device.supportsDynamicRendering(); }
+  bool hasPassAttachments() const { return passAttachments; }
+  VkImage getImage(int index) { return swapChainImages[index]; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+  // Depth images belong to frames in flight, not swap chain images: one per frame in flight, or a
+  // single one in lazily allocated memory where the device has it.
+  VkImage getDepthImage(int frameIndex) { return depthImages[depthIndex(frameIndex)]; }
+  VkImageView getDepthImageView(int frameIndex) { return depthImageViews[depthIndex(frameIndex)]; }
+  size_t depthImageCount() const { return depthImages.size(); }
+  // Multisampled color images, paired with the depth images; only when usesMultisampling.
+  VkImage getColorImage(int frameIndex) { return colorImages[depthIndex(frameIndex)]; }
+  VkImageView getColorImageView(int frameIndex) { return colorImageViews[depthIndex(frameIndex)]; }
+  VkSampleCountFlagBits getSampleCount() const { return sampleCount; }
+  bool usesMultisampling() const { return sampleCount != VK_SAMPLE_COUNT_1_BIT; }
+  bool isDepthLazilyAllocated() const { return lazilyAllocatedDepth; }
+  VkFormat getSwapChainDepthFormat() { return swapChainDepthFormat; }
   size_t imageCount() { return swapChainImages.size(); }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
   VkExtent2D getSwapChainExtent() { return swapChainExtent; }
   uint32_t width() { return swapChainExtent.width; }
   uint32_t height() { return swapChainExtent.height; }
+  PresentPolicy getPresentPolicy() const { return presentPolicy; }
+  VkPresentModeKHR getPresentMode() const { return presentMode; }
+  // always a color attachment; a transfer destination too where the surface allows it
+  VkImageUsageFlags getImageUsage() const { return imageUsage; }
 
   float extentAspectRatio() {
     return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
@@ -48,8 +93,12 @@ class VulkEngSwapChain {
  private:
   void init();
   void createSwapChain();
+  void createOffscreenImages();
   void createImageViews();
   void createDepthResources();
+  void createColorResources();
+  VkImage createDepthImage(VkFormat depthFormat);
+  void bindDepthImageMemory(size_t index);
   void createRenderPass();
   void createFramebuffers();
   void createSyncObjects();
@@ -60,24 +109,39 @@ class VulkEngSwapChain {
   VkPresentModeKHR chooseSwapPresentMode(
       const std::vector<VkPresentModeKHR> &availablePresentModes);
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
+  uint32_t chooseImageCount(const VkSurfaceCapabilitiesKHR &capabilities);
+  size_t depthIndex(int frameIndex) const { return frameIndex % depthImages.size(); }
 
   VkFormat swapChainImageFormat;
   VkFormat swapChainDepthFormat;
   VkExtent2D swapChainExtent;
+  PresentPolicy presentPolicy;
+  VkPresentModeKHR presentMode;
+  VkSampleCountFlagBits sampleCount;
+  bool passAttachments;
+  VkImageUsageFlags imageUsage;
 
   std::vector<VkFramebuffer> swapChainFramebuffers;
-  VkRenderPass renderPass;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
 
   std::vector<VkImage> depthImages;
   std::vector<VkDeviceMemory> depthImageMemorys;
+  std::vector<VkDeviceSize> depthImageMemorySizes;
+  std::vector<uint32_t> depthImageMemoryTypes;
   std::vector<VkImageView> depthImageViews;
+  bool lazilyAllocatedDepth = false;
+  std::vector<VkImage> colorImages;
+  std::vector<VkDeviceMemory> colorImageMemorys;
+  std::vector<VkImageView> colorImageViews;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
+  // headless only: the images stand in for swap chain images and are owned here
+  std::vector<VkDeviceMemory> offscreenImageMemorys;
 
   VulkEngDevice &device;
   VkExtent2D windowExtent;
 
-  VkSwapchainKHR swapChain;
+  VkSwapchainKHR swapChain = VK_NULL_HANDLE;
   std::shared_ptr<VulkEngSwapChain> oldSwapChain;
 
   std::vector<VkSemaphore> imageAvailableSemaphores;
@@ -0,0 +1,431 @@
+#include "vulkEngTexture.hpp"
+#include "vulkEngMappedFile.hpp"
+#include "vulkEngSamplerCache.hpp"
+#include "vulkEngCpuProfiler.hpp"
+
+//std
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace VulkanEngine {
+
+	namespace {
+		constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+		constexpr uint32_t BYTES_PER_RGBA_PIXEL = 4;
+
+		// KTX2 is little endian, like every platform the engine runs on
+		uint32_t read32(const uint8_t* bytes, size_t offset) {
+			uint32_t value;
+			std::memcpy(&value, bytes + offset, sizeof(value));
+			return value;
+		}
+
+		uint64_t read64(const uint8_t* bytes, size_t offset) {
+			uint64_t value;
+			std::memcpy(&value, bytes + offset, sizeof(value));
+			return value;
+		}
+
+		// bytes of one texel, or of one block of a block compressed format; 0 if unknown
+		uint32_t texelBlockSize(VkFormat format) {
+			auto in = [format](VkFormat first, VkFormat last) { return format >= first && format <= last; };
+			if (format == VK_FORMAT_R4G4_UNORM_PACK8 || in(VK_FORMAT_R8_UNORM, VK_FORMAT_R8_SRGB)) return 1;
+			if (in(VK_FORMAT_R4G4B4A4_UNORM_PACK16, VK_FORMAT_A1R5G5B5_UNORM_PACK16)) return 2;
+			if (in(VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8_SRGB)) return 2;
+			if (in(VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_B8G8R8_SRGB)) return 3;
+			if (in(VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_A2B10G10R10_SINT_PACK32)) return 4;
+			if (in(VK_FORMAT_R16_UNORM, VK_FORMAT_R16_SFLOAT)) return 2;
+			if (in(VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16_SFLOAT)) return 4;
+			if (in(VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16_SFLOAT)) return 6;
+			if (in(VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_R16G16B16A16_SFLOAT)) return 8;
+			if (in(VK_FORMAT_R32_UINT, VK_FORMAT_R32_SFLOAT)) return 4;
+			if (in(VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32_SFLOAT)) return 8;
+			if (in(VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32_SFLOAT)) return 12;
+			if (in(VK_FORMAT_R32G32B32A32_UINT, VK_FORMAT_R32G32B32A32_SFLOAT)) return 16;
+			if (in(VK_FORMAT_R64_UINT, VK_FORMAT_R64_SFLOAT)) return 8;
+			if (in(VK_FORMAT_R64G64_UINT, VK_FORMAT_R64G64_SFLOAT)) return 16;
+			if (in(VK_FORMAT_R64G64B64_UINT, VK_FORMAT_R64G64B64_SFLOAT)) return 24;
+			if (in(VK_FORMAT_R64G64B64A64_UINT, VK_FORMAT_R64G64B64A64_SFLOAT)) return 32;
+			if (in(VK_FORMAT_B10G11R11_UFLOAT_PACK32, VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)) return 4;
+			// 4x4 blocks of 64 bits: BC1, BC4, ETC2 without full alpha and EAC R11
+			if (in(VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK)
+				|| in(VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC4_SNORM_BLOCK)
+				|| in(VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK)
+				|| in(VK_FORMAT_EAC_R11_UNORM_BLOCK, VK_FORMAT_EAC_R11_SNORM_BLOCK)) return 8;
+			// the other BC, ETC2 and EAC formats and every ASTC block size are 128 bits
+			if (in(VK_FORMAT_BC2_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK)
+				|| in(VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK)
+				|| in(VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK)
+				|| in(VK_FORMAT_EAC_R11G11_UNORM_BLOCK, VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+				|| in(VK_FORMAT_ASTC_4x4_SFLOAT_BLOCK, VK_FORMAT_ASTC_12x12_SFLOAT_BLOCK)) return 16;
+			return 0;
+		}
+
+		// texels one block of texelBlockSize covers
+		VkExtent2D texelBlockExtent(VkFormat format) {
+			// in the order of the VkFormat values, each as UNORM and SRGB, and once as SFLOAT
+			constexpr VkExtent2D ASTC_BLOCKS[] = {
+				{ 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+				{ 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 } };
+			if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK) {
+				return ASTC_BLOCKS[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+			}
+			if (format >= VK_FORMAT_ASTC_4x4_SFLOAT_BLOCK && format <= VK_FORMAT_ASTC_12x12_SFLOAT_BLOCK) {
+				return ASTC_BLOCKS[format - VK_FORMAT_ASTC_4x4_SFLOAT_BLOCK];
+			}
+			if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK) {
+				return { 4, 4 };
+			}
+			return { 1, 1 };
+		}
+
+		// saturates instead of wrapping, so sizes too large for memory still compare as too large
+		uint64_t multiplySaturated(uint64_t a, uint64_t b) {
+			return a != 0 && b > UINT64_MAX / a ? UINT64_MAX : a * b;
+		}
+
+		uint32_t fullMipChain(uint32_t width, uint32_t height) {
+			uint32_t levels = 1;
+			for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+				levels++;
+			}
+			return levels;
+		}
+	}
+
+	VkSamplerCreateInfo TextureOptions::defaultSamplerInfo() {
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		// the sampler cache clamps this to the device limit
+		samplerInfo.anisotropyEnable = VK_TRUE;
+		samplerInfo.maxAnisotropy = 16.0f;
+		samplerInfo.compareEnable = VK_FALSE;
+		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		samplerInfo.unnormalizedCoordinates = VK_FALSE;
+		return samplerInfo;
+	}
+
+	Ktx2Info Ktx2Info::read(const void* data, size_t size, const std::string& name) {
+		auto error = [&name](const std::string& reason) {
+			return std::runtime_error("failed to load texture " + name + ": " + reason + "!");
+		};
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		if (size < HEADER_SIZE || std::memcmp(bytes, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+			throw error("not a KTX2 file");
+		}
+		if (size < HEADER_SIZE + levelIndexSize(data)) {
+			throw error("truncated level index");
+		}
+
+		Ktx2Info info{};
+		info.format = static_cast<VkFormat>(read32(bytes, 12));
+		info.width = read32(bytes, 20);
+		info.height = read32(bytes, 24);
+		uint32_t depth = read32(bytes, 28);
+		info.layerCount = std::max(1u, read32(bytes, 32));
+		uint32_t faces = read32(bytes, 36);
+		uint32_t levelCount = read32(bytes, 40);
+		uint32_t supercompressionScheme = read32(bytes, 44);
+
+		if (info.format == VK_FORMAT_UNDEFINED) {
+			throw error("Basis Universal payloads must be transcoded first");
+		}
+		info.blockSize = texelBlockSize(info.format);
+		if (info.blockSize == 0) {
+			throw error("unsupported format");
+		}
+		VkExtent2D blockExtent = texelBlockExtent(info.format);
+		info.blockWidth = blockExtent.width;
+		info.blockHeight = blockExtent.height;
+		if (supercompressionScheme != 0) {
+			throw error("supercompressed files are not supported");
+		}
+		if (info.width == 0 || info.height == 0 || depth > 1 || faces > 1) {
+			throw error("only 2D textures and texture arrays are supported");
+		}
+
+		if (levelCount > fullMipChain(info.width, info.height)) {
+			throw error("more levels than the image has");
+		}
+
+		// 0 asks for the levels to be generated
+		info.generateMips = levelCount == 0;
+		info.levels.resize(std::max(1u, levelCount));
+		for (uint32_t level = 0; level < info.levels.size(); level++) {
+			size_t entry = HEADER_SIZE + level * LEVEL_INDEX_ENTRY_SIZE;
+			Level& range = info.levels[level];
+			range = { read64(bytes, entry), read64(bytes, entry + 8) };
+			if (range.length > UINT64_MAX - range.offset) {
+				throw error("level range out of bounds");
+			}
+			// what the copy region of the level reads, rows and layers being tightly packed
+			uint64_t blocksWide = (std::max(1u, info.width >> level) + info.blockWidth - 1) / info.blockWidth;
+			uint64_t blocksHigh = (std::max(1u, info.height >> level) + info.blockHeight - 1) / info.blockHeight;
+			uint64_t needed = multiplySaturated(
+				multiplySaturated(blocksWide * blocksHigh, info.blockSize), info.layerCount);
+			if (range.length < needed) {
+				throw error("level data shorter than the level");
+			}
+		}
+		return info;
+	}
+
+	size_t Ktx2Info::levelIndexSize(const void* header) {
+		return std::max(1u, read32(static_cast<const uint8_t*>(header), 40)) * LEVEL_INDEX_ENTRY_SIZE;
+	}
+
+	// the file stores the smallest level first, but no order is relied on
+	Ktx2Info::Level Ktx2Info::levelRange(uint32_t skipLevels) const {
+		uint64_t rangeStart = UINT64_MAX;
+		uint64_t rangeEnd = 0;
+		for (size_t level = clampSkip(skipLevels); level < levels.size(); level++) {
+			rangeStart = std::min(rangeStart, levels[level].offset);
+			rangeEnd = std::max(rangeEnd, levels[level].offset + levels[level].length);
+		}
+		return { rangeStart, rangeEnd - rangeStart };
+	}
+
+	VulkEngTexture::VulkEngTexture(
+		VulkEngDevice& device,
+		VulkEngUploadBatch& batch,
+		const std::string& ktx2Path,
+		const TextureOptions& options
+	) : vulkanDevice{ device } {
+		VulkEngCpuScope scope{ "loadKtx2" };
+		VulkEngMappedFile file{ ktx2Path };
+		Ktx2Info info = Ktx2Info::read(file.data(), file.size(), ktx2Path);
+		Ktx2Info::Level range = info.levelRange(options.skipLevels);
+		if (range.offset + range.length > file.size()) {
+			throw std::runtime_error("failed to load texture " + ktx2Path + ": truncated level data!");
+		}
+		// uploaded straight from the mapping
+		loadKtx2(batch, info, static_cast<const uint8_t*>(file.data()) + range.offset, options);
+	}
+
+	VulkEngTexture::VulkEngTexture(
+		VulkEngDevice& device,
+		VulkEngUploadBatch& batch,
+		const Ktx2Info& info,
+		const void* levelData,
+		const TextureOptions& options
+	) : vulkanDevice{ device } {
+		loadKtx2(batch, info, levelData, options);
+	}
+
+	VulkEngTexture::VulkEngTexture(
+		VulkEngDevice& device,
+		VulkEngUploadBatch& batch,
+		const void* pixels,
+		uint32_t width,
+		uint32_t height,
+		const TextureOptions& options
+	) : vulkanDevice{ device } {
+		format = options.srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		extent = { width, height };
+
+		UploadLevels upload{};
+		upload.data = pixels;
+		upload.size = static_cast<VkDeviceSize>(width) * height * BYTES_PER_RGBA_PIXEL;
+		upload.blockSize = BYTES_PER_RGBA_PIXEL;
+		VkBufferImageCopy region{};
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageExtent = { width, height, 1 };
+		upload.regions.push_back(region);
+		upload.totalLevels = options.generateMips && canGenerateMips() ? fullMipChain(width, height) : 1;
+		create(batch, upload, options);
+	}
+
+	VulkEngTexture::~VulkEngTexture() {
+		// frames still in flight may sample it
+		VkDevice device = vulkanDevice.device();
+		vulkanDevice.deferDestruction([device, view = imageView, image = image, memory = imageMemory]() {
+			vkDestroyImageView(device, view, nullptr);
+			vkDestroyImage(device, image, nullptr);
+			vkFreeMemory(device, memory, nullptr);
+		});
+	}
+
+	void VulkEngTexture::loadKtx2(VulkEngUploadBatch& batch, const Ktx2Info& info, const void* levelData, const TextureOptions& options) {
+		format = info.format;
+		if ((vulkanDevice.getOptimalTilingFeatures(format) & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0) {
+			throw std::runtime_error("failed to load texture: its format cannot be sampled on this device!");
+		}
+		layerCount = info.layerCount;
+		uint32_t skip = info.clampSkip(options.skipLevels);
+		uint32_t fileLevels = static_cast<uint32_t>(info.levels.size());
+		extent = { std::max(1u, info.width >> skip), std::max(1u, info.height >> skip) };
+
+		Ktx2Info::Level range = info.levelRange(skip);
+		UploadLevels upload{};
+		upload.data = levelData;
+		upload.size = range.length;
+		// KTX2 aligns every level to the block size and to 4, so offsets from the first one stay aligned
+		upload.blockSize = info.blockSize;
+		for (uint32_t level = skip; level < fileLevels; level++) {
+			VkBufferImageCopy region{};
+			region.bufferOffset = info.levels[level].offset - range.offset;
+			// rows and layers are tightly packed, in whole blocks for compressed formats
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - skip, 0, layerCount };
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { std::max(1u, info.width >> level), std::max(1u, info.height >> level), 1 };
+			upload.regions.push_back(region);
+		}
+
+		uint32_t keptLevels = fileLevels - skip;
+		bool generate = (info.generateMips || options.generateMips) && canGenerateMips();
+		upload.totalLevels = generate ? std::max(keptLevels, fullMipChain(extent.width, extent.height)) : keptLevels;
+		create(batch, upload, options);
+	}
+
+	void VulkEngTexture::create(VulkEngUploadBatch& batch, const UploadLevels& levels, const TextureOptions& options) {
+		uint32_t uploadedLevels = static_cast<uint32_t>(levels.regions.size());
+		mipLevels = levels.totalLevels;
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = format;
+		imageInfo.extent = { extent.width, extent.height, 1 };
+		imageInfo.mipLevels = mipLevels;
+		imageInfo.arrayLayers = layerCount;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (uploadedLevels < mipLevels) {
+			imageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		vulkanDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(vulkanDevice.device(), image, &memRequirements);
+		memorySize = memRequirements.size;
+
+		// every level is written, by the copies or by the blits
+		transitionLevels(
+			batch.getTransferCommandBuffer(), 0, mipLevels,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		batch.uploadImage(levels.data, levels.size, levels.blockSize, image, levels.regions, mipLevels, layerCount);
+
+		// blits need the graphics queue
+		VkCommandBuffer graphicsCommands = batch.getGraphicsCommandBuffer();
+		if (uploadedLevels < mipLevels) {
+			generateMips(graphicsCommands, uploadedLevels);
+		}
+		else {
+			transitionLevels(
+				graphicsCommands, 0, mipLevels,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		}
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, layerCount };
+		if (vkCreateImageView(vulkanDevice.device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create texture image view!");
+		}
+
+		sampler = vulkanDevice.samplerCache().getSampler(options.sampler);
+	}
+
+	// Each level is blitted from the one above it, which is done with and handed to the shaders
+	// as soon as it has been read.
+	void VulkEngTexture::generateMips(VkCommandBuffer commandBuffer, uint32_t firstLevel) {
+		if (firstLevel > 1) {
+			transitionLevels(
+				commandBuffer, 0, firstLevel - 1,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		}
+
+		for (uint32_t level = firstLevel; level < mipLevels; level++) {
+			transitionLevels(
+				commandBuffer, level - 1, 1,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+			VkImageBlit blit{};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, layerCount };
+			blit.srcOffsets[1] = {
+				static_cast<int32_t>(std::max(1u, extent.width >> (level - 1))),
+				static_cast<int32_t>(std::max(1u, extent.height >> (level - 1))),
+				1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, layerCount };
+			blit.dstOffsets[1] = {
+				static_cast<int32_t>(std::max(1u, extent.width >> level)),
+				static_cast<int32_t>(std::max(1u, extent.height >> level)),
+				1 };
+			vkCmdBlitImage(
+				commandBuffer,
+				image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &blit,
+				VK_FILTER_LINEAR);
+
+			transitionLevels(
+				commandBuffer, level - 1, 1,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		}
+
+		transitionLevels(
+			commandBuffer, mipLevels - 1, 1,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
+
+	void VulkEngTexture::transitionLevels(
+		VkCommandBuffer commandBuffer,
+		uint32_t baseLevel,
+		uint32_t levelCount,
+		VkImageLayout oldLayout,
+		VkImageLayout newLayout,
+		VkAccessFlags srcAccess,
+		VkAccessFlags dstAccess,
+		VkPipelineStageFlags srcStages,
+		VkPipelineStageFlags dstStages) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, layerCount };
+		vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	bool VulkEngTexture::canGenerateMips() const {
+		// block compressed formats are never blit destinations
+		const VkFormatFeatureFlags needed =
+			VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		return (vulkanDevice.getOptimalTilingFeatures(format) & needed) == needed;
+	}
+
+} // namespace VulkanEngine
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "vulkEngDevice.hpp"
+#include "vulkEngUploadBatch.hpp"
+
+//std
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace VulkanEngine {
+
+	struct TextureOptions {
+		// mip levels of a KTX2 file dropped from the top of its chain, each halving the width and
+		// height, to fit a memory budget; at least the file's smallest level is kept
+		uint32_t skipLevels = 0;
+		// generates the levels the source lacks with linear blits, where the format allows blitting;
+		// block compressed formats keep only the levels they come with
+		bool generateMips = true;
+		// for RGBA8 pixels; KTX2 files name their own format
+		bool srgb = true;
+		// looked up in the device's sampler cache
+		VkSamplerCreateInfo sampler = defaultSamplerInfo();
+
+		// trilinear, repeating, with as much anisotropic filtering as the device allows
+		static VkSamplerCreateInfo defaultSamplerInfo();
+	};
+
+	// The header and level index of a KTX2 file, all that is needed to read its levels selectively.
+	struct Ktx2Info {
+		// bytes of the header and level index, at the start of the file
+		static constexpr size_t HEADER_SIZE = 80;
+		static constexpr size_t LEVEL_INDEX_ENTRY_SIZE = 24;
+
+		struct Level {
+			uint64_t offset;
+			uint64_t length;
+		};
+
+		VkFormat format;
+		// bytes of one texel, or of one block of a block compressed format, and the texels it covers
+		uint32_t blockSize;
+		uint32_t blockWidth;
+		uint32_t blockHeight;
+		uint32_t width;
+		uint32_t height;
+		uint32_t layerCount;
+		// levels the file holds, at least 1; level 0 is the largest
+		std::vector<Level> levels;
+		// the file asks for its missing levels to be generated
+		bool generateMips;
+
+		// Parses the header and level index from the first bytes of a file; size must cover at least
+		// HEADER_SIZE and then the whole level index. Throws if name is not a usable KTX2 file,
+		// including when a level is too short for its copy region or lies outside any file.
+		static Ktx2Info read(const void* bytes, size_t size, const std::string& name);
+		// index entries needed after HEADER_SIZE, from the first HEADER_SIZE bytes
+		static size_t levelIndexSize(const void* header);
+
+		// the levels kept when skipping skipLevels, clamped to keep the smallest
+		uint32_t clampSkip(uint32_t skipLevels) const { return std::min(skipLevels, static_cast<uint32_t>(levels.size()) - 1); }
+		// the file range holding every level from skipLevels down
+		Level levelRange(uint32_t skipLevels) const;
+	};
+
+	// A sampled 2D (array) texture in device local memory. Uploads are recorded into a batch; the
+	// texture must not be sampled before the batch completes, and is left in
+	// SHADER_READ_ONLY_OPTIMAL for fragment shaders.
+	class VulkEngTexture {
+
+	public:
+		// Loads a KTX2 file without supercompression, in any format the device can sample, which
+		// includes the BC and ASTC families when the device supports them. Its data is uploaded as
+		// is, straight from a mapping of the file. Throws if the file cannot be used.
+		VulkEngTexture(VulkEngDevice& device, VulkEngUploadBatch& batch, const std::string& ktx2Path, const TextureOptions& options = {});
+		// From KTX2 levels read separately: levelData holds info.levelRange(options.skipLevels).
+		VulkEngTexture(
+			VulkEngDevice& device,
+			VulkEngUploadBatch& batch,
+			const Ktx2Info& info,
+			const void* levelData,
+			const TextureOptions& options = {});
+		// pixels are tightly packed 8 bit RGBA rows
+		VulkEngTexture(
+			VulkEngDevice& device,
+			VulkEngUploadBatch& batch,
+			const void* pixels,
+			uint32_t width,
+			uint32_t height,
+			const TextureOptions& options = {});
+		~VulkEngTexture();
+
+		VulkEngTexture(const VulkEngTexture&) = delete;
+		VulkEngTexture& operator=(const VulkEngTexture&) = delete;
+
+		VkImage getImage() const { return image; }
+		VkImageView getImageView() const { return imageView; }
+		VkSampler getSampler() const { return sampler; }
+		VkFormat getFormat() const { return format; }
+		VkExtent2D getExtent() const { return extent; }
+		uint32_t getMipLevels() const { return mipLevels; }
+		uint32_t getLayerCount() const { return layerCount; }
+		// of the image's device memory allocation
+		VkDeviceSize getMemorySize() const { return memorySize; }
+
+		VkDescriptorImageInfo getDescriptorInfo() const {
+			return { sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		}
+
+	private:
+		// levels data holds, one region each, and the full chain to create
+		struct UploadLevels {
+			const void* data;
+			VkDeviceSize size;
+			uint32_t blockSize;
+			std::vector<VkBufferImageCopy> regions;
+			uint32_t totalLevels;
+		};
+
+		void loadKtx2(VulkEngUploadBatch& batch, const Ktx2Info& info, const void* levelData, const TextureOptions& options);
+		void create(VulkEngUploadBatch& batch, const UploadLevels& levels, const TextureOptions& options);
+		void generateMips(VkCommandBuffer commandBuffer, uint32_t firstLevel);
+		void transitionLevels(
+			VkCommandBuffer commandBuffer,
+			uint32_t baseLevel,
+			uint32_t levelCount,
+			VkImageLayout oldLayout,
+			VkImageLayout newLayout,
+			VkAccessFlags srcAccess,
+			VkAccessFlags dstAccess,
+			VkPipelineStageFlags srcStages,
+			VkPipelineStageFlags dstStages);
+		bool canGenerateMips() const;
+
+		VulkEngDevice& vulkanDevice;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent{ 0, 0 };
+		uint32_t mipLevels = 1;
+		uint32_t layerCount = 1;
+		VkDeviceSize memorySize = 0;
+	};
+
+} // namespace VulkanEngine
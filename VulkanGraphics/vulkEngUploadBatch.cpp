@@ -0,0 +1,259 @@
+#include "vulkEngUploadBatch.hpp"
+
+//std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace VulkanEngine
+{
+	namespace {
+		// uploads larger than this get a staging buffer of their own
+		constexpr VkDeviceSize STAGING_CHUNK_SIZE = 4 * 1024 * 1024;
+	}
+
+	VulkEngUploadBatch::VulkEngUploadBatch(VulkEngDevice& device) : vulkanDevice{ device } {}
+
+	VulkEngUploadBatch::~VulkEngUploadBatch() {
+		if (!submitted && !isEmpty()) {
+			submit();
+		}
+	}
+
+	VkCommandBuffer VulkEngUploadBatch::getTransferCommandBuffer() {
+		assert(!submitted && "Cannot record into an upload batch after it was submitted");
+		if (transferCommands == VK_NULL_HANDLE) {
+			transferCommands = vulkanDevice.beginPooledCommands(vulkanDevice.getTransferCommandPool());
+		}
+		return transferCommands;
+	}
+
+	VkCommandBuffer VulkEngUploadBatch::getGraphicsCommandBuffer() {
+		assert(!submitted && "Cannot record into an upload batch after it was submitted");
+		if (!vulkanDevice.hasDedicatedTransferQueue()) {
+			return getTransferCommandBuffer();
+		}
+		if (graphicsCommands == VK_NULL_HANDLE) {
+			graphicsCommands = vulkanDevice.beginPooledCommands(vulkanDevice.getCommandPool());
+		}
+		return graphicsCommands;
+	}
+
+	void VulkEngUploadBatch::onComplete(std::function<void()> callback) {
+		completionCallbacks.push_back(std::move(callback));
+	}
+
+	VulkEngUploadBatch::StagingAllocation VulkEngUploadBatch::stage(const void* data, VkDeviceSize size, VkDeviceSize alignment) {
+		assert(!submitted && "Cannot stage data for an upload batch after it was submitted");
+		assert(alignment > 0 && "Staging alignment must not be 0");
+
+		StagingChunk* chunk = nullptr;
+		VkDeviceSize offset = 0;
+		if (!stagingChunks.empty()) {
+			StagingChunk& last = stagingChunks.back();
+			// not necessarily a power of two, image copies of 3 byte texels need multiples of 12
+			offset = (last.used + alignment - 1) / alignment * alignment;
+			if (offset + size <= last.size) {
+				chunk = &last;
+			}
+		}
+		if (chunk == nullptr) {
+			StagingChunk newChunk{};
+			newChunk.size = std::max(size, STAGING_CHUNK_SIZE);
+			vulkanDevice.createBuffer(
+				newChunk.size,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				newChunk.buffer,
+				newChunk.memory
+			);
+			void* mapped;
+			vkMapMemory(vulkanDevice.device(), newChunk.memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+			newChunk.mapped = static_cast<uint8_t*>(mapped);
+
+			VkDevice device = vulkanDevice.device();
+			onComplete([device, buffer = newChunk.buffer, memory = newChunk.memory]() {
+				vkUnmapMemory(device, memory);
+				vkDestroyBuffer(device, buffer, nullptr);
+				vkFreeMemory(device, memory, nullptr);
+			});
+			stagingChunks.push_back(newChunk);
+			chunk = &stagingChunks.back();
+			offset = 0;
+		}
+
+		memcpy(chunk->mapped + offset, data, static_cast<size_t>(size));
+		chunk->used = offset + size;
+		return { chunk->buffer, offset };
+	}
+
+	void VulkEngUploadBatch::uploadBuffer(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset) {
+		StagingAllocation staging = stage(data, size);
+		copyBuffer(staging.buffer, dstBuffer, size, staging.offset, dstOffset);
+	}
+
+	void VulkEngUploadBatch::copyBuffer(
+		VkBuffer srcBuffer,
+		VkBuffer dstBuffer,
+		VkDeviceSize size,
+		VkDeviceSize srcOffset,
+		VkDeviceSize dstOffset) {
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = srcOffset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(getTransferCommandBuffer(), srcBuffer, dstBuffer, 1, &copyRegion);
+
+		releaseBuffer(dstBuffer, dstOffset, size);
+	}
+
+	void VulkEngUploadBatch::copyBufferToImage(
+		VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
+		VkBufferImageCopy region{};
+		region.bufferOffset = 0;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = layerCount;
+
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { width, height, 1 };
+
+		vkCmdCopyBufferToImage(
+			getTransferCommandBuffer(),
+			buffer,
+			image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1,
+			&region);
+
+		releaseImage(image, 1, layerCount);
+	}
+
+	void VulkEngUploadBatch::uploadImage(
+		const void* data,
+		VkDeviceSize size,
+		uint32_t texelBlockSize,
+		VkImage image,
+		const std::vector<VkBufferImageCopy>& regions,
+		uint32_t levelCount,
+		uint32_t layerCount) {
+		VkDeviceSize alignment = std::lcm(static_cast<VkDeviceSize>(texelBlockSize), VkDeviceSize{ 4 });
+		StagingAllocation staging = stage(data, size, alignment);
+		std::vector<VkBufferImageCopy> stagedRegions = regions;
+		for (auto& region : stagedRegions) {
+			assert(region.bufferOffset % alignment == 0 && "Image copy offsets must be multiples of the texel block size and 4");
+			region.bufferOffset += staging.offset;
+		}
+
+		vkCmdCopyBufferToImage(
+			getTransferCommandBuffer(),
+			staging.buffer,
+			image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(stagedRegions.size()),
+			stagedRegions.data());
+
+		releaseImage(image, levelCount, layerCount);
+	}
+
+	// Queue family ownership transfer: the release is recorded on the transfer queue right after
+	// the copy, the matching acquire on the graphics queue, which waits for the transfer submission.
+	void VulkEngUploadBatch::releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+		if (!vulkanDevice.hasDedicatedTransferQueue()) {
+			return;
+		}
+		const QueueFamilyIndices& families = vulkanDevice.queueFamilyIndices();
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = families.transferFamily;
+		barrier.dstQueueFamilyIndex = families.graphicsFamily;
+		barrier.buffer = buffer;
+		barrier.offset = offset;
+		barrier.size = size;
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(
+			getTransferCommandBuffer(),
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			getGraphicsCommandBuffer(),
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	void VulkEngUploadBatch::releaseImage(VkImage image, uint32_t levelCount, uint32_t layerCount) {
+		if (!vulkanDevice.hasDedicatedTransferQueue()) {
+			return;
+		}
+		const QueueFamilyIndices& families = vulkanDevice.queueFamilyIndices();
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = families.transferFamily;
+		barrier.dstQueueFamilyIndex = families.graphicsFamily;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = levelCount;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = layerCount;
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(
+			getTransferCommandBuffer(),
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			getGraphicsCommandBuffer(),
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	UploadTicket VulkEngUploadBatch::submit() {
+		assert(!submitted && "Upload batch was already submitted");
+		submitted = true;
+		if (isEmpty()) {
+			for (auto& callback : completionCallbacks) {
+				callback();
+			}
+			return {};
+		}
+
+		// make the transfer writes visible to whatever the graphics queue submits next
+		VkCommandBuffer lastCommands = graphicsCommands != VK_NULL_HANDLE ? graphicsCommands : transferCommands;
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(
+			lastCommands,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		return vulkanDevice.submitUpload(transferCommands, graphicsCommands, std::move(completionCallbacks));
+	}
+
+} // namespace VulkanEngine
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "vulkEngDevice.hpp"
+
+//std
+#include <functional>
+#include <vector>
+
+namespace VulkanEngine {
+
+	// Records any number of transfers into one command buffer and submits them with a single fence.
+	// On devices with a dedicated transfer queue every destination is released by the transfer
+	// family and acquired by the graphics family inside the batch, so it is ready for rendering on
+	// the graphics queue once the returned ticket completes.
+	class VulkEngUploadBatch {
+
+	public:
+		VulkEngUploadBatch(VulkEngDevice& device);
+		~VulkEngUploadBatch();
+
+		VulkEngUploadBatch(const VulkEngUploadBatch&) = delete;
+		VulkEngUploadBatch& operator=(const VulkEngUploadBatch&) = delete;
+
+		// Where stage put a copy of the caller's data.
+		struct StagingAllocation {
+			VkBuffer buffer;
+			VkDeviceSize offset;
+		};
+
+		// Copies data into staging memory that is freed once the batch has completed. Small uploads
+		// share staging buffers, so a batch of many of them allocates a handful of buffers, not one each.
+		// offset is a multiple of alignment.
+		StagingAllocation stage(const void* data, VkDeviceSize size, VkDeviceSize alignment = 16);
+
+		// Copies data through staging memory, see stage.
+		void uploadBuffer(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+		void copyBuffer(
+			VkBuffer srcBuffer,
+			VkBuffer dstBuffer,
+			VkDeviceSize size,
+			VkDeviceSize srcOffset = 0,
+			VkDeviceSize dstOffset = 0);
+		// image must be in TRANSFER_DST_OPTIMAL and is left in it
+		void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
+		// Stages data and copies it into image with regions, whose buffer offsets are relative to
+		// data and, as Vulkan requires, multiples of both texelBlockSize and 4. image must be in
+		// TRANSFER_DST_OPTIMAL and is left in it; levelCount and layerCount cover every subresource
+		// the regions write.
+		void uploadImage(
+			const void* data,
+			VkDeviceSize size,
+			uint32_t texelBlockSize,
+			VkImage image,
+			const std::vector<VkBufferImageCopy>& regions,
+			uint32_t levelCount,
+			uint32_t layerCount);
+
+		// Raw recording for work the helpers do not cover. Graphics commands run after the transfer
+		// commands and see every destination handed over so far. Without a dedicated transfer queue
+		// both return the same command buffer.
+		VkCommandBuffer getTransferCommandBuffer();
+		VkCommandBuffer getGraphicsCommandBuffer();
+
+		// Runs on the thread that retires the ticket, after the GPU has finished the batch.
+		void onComplete(std::function<void()> callback);
+
+		bool isEmpty() const { return transferCommands == VK_NULL_HANDLE && graphicsCommands == VK_NULL_HANDLE; }
+
+		// A batch that is destroyed with recorded work submits it.
+		UploadTicket submit();
+
+	private:
+		struct StagingChunk {
+			VkBuffer buffer;
+			VkDeviceMemory memory;
+			uint8_t* mapped;
+			VkDeviceSize size;
+			VkDeviceSize used;
+		};
+
+		void releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+		void releaseImage(VkImage image, uint32_t levelCount, uint32_t layerCount);
+
+		VulkEngDevice& vulkanDevice;
+		std::vector<StagingChunk> stagingChunks;
+		VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+		VkCommandBuffer graphicsCommands = VK_NULL_HANDLE;
+		std::vector<std::function<void()>> completionCallbacks;
+		bool submitted = false;
+	};
+
+} // namespace VulkanEngine
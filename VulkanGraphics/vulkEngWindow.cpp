@@ -4,15 +4,20 @@
 #include "vulkEngDevice.hpp"
 
 namespace VulkanEngine {
-	VulkEngWindow::VulkEngWindow(int w, int h, std::string name) : width{ w }, height{ h }, windowName{ name } {
-		initWindow();
+	VulkEngWindow::VulkEngWindow(int w, int h, std::string name, bool headless)
+		: width{ w }, height{ h }, windowName{ name }, headless{ headless } {
+		if (!headless) {
+			initWindow();
+		}
 	}
 	VulkEngWindow::~VulkEngWindow() {
 		if (window) {
 			glfwDestroyWindow(window);
 		}
 		// Terminate GLFW if it was initialized; glfwTerminate is safe to call even if window is null
-		glfwTerminate();
+		if (!headless) {
+			glfwTerminate();
+		}
 	}
 	void VulkEngWindow::initWindow() {
 		if (!glfwInit()) {
@@ -31,6 +36,15 @@ namespace VulkanEngine {
 		}
 	}
 
+	void VulkEngWindow::resizeHeadless(int w, int h) {
+		if (!headless) {
+			return;
+		}
+		framebufferResized = true;
+		width = w;
+		height = h;
+	}
+
 	void VulkEngWindow::createWindowSurface(VkInstance instance, VkSurfaceKHR* surface) {
 		if (glfwCreateWindowSurface(instance, window, nullptr, surface) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create window surface");
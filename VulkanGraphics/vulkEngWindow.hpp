@@ -9,18 +9,25 @@ namespace VulkanEngine {
 	class VulkEngWindow {
 
 	public:
-		VulkEngWindow(int w, int h, std::string name);
+		// A headless window never opens: it only reports a fixed extent, and the device and swap chain
+		// created for it render offscreen without presenting.
+		VulkEngWindow(int w, int h, std::string name, bool headless = false);
 		~VulkEngWindow();
 
 		bool shouldClose() const { return window && glfwWindowShouldClose(window); }
 
 		void pollEvents() { if (window) glfwPollEvents(); }
+		void waitEvents() { if (window) glfwWaitEvents(); }
 
 		VkExtent2D getExtent() { return { static_cast<uint32_t>(width), static_cast<uint32_t>(height) }; }
 
+		bool isMinimized() const { return width == 0 || height == 0; }
 		bool wasWindowResized() { return framebufferResized; }
 		void resetWindowResizedFlag() { framebufferResized = false; }
 
+		bool isHeadless() const { return headless; }
+		// Stands in for a framebuffer resize callback on a headless window.
+		void resizeHeadless(int w, int h);
 		void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
 
 	private:
@@ -33,6 +40,7 @@ namespace VulkanEngine {
 		bool framebufferResized = false;
 
 		std::string windowName;
+		bool headless;
 
 		GLFWwindow* window = nullptr;
 	};
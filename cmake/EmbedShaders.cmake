@@ -0,0 +1,58 @@
+# Script mode helper: cmake -DOUTPUT=<header> -DSHADER_ROOT=<dir> -DSHADERS="<spv>;..." -P EmbedShaders.cmake
+#
+# Writes a header with every SPIR-V binary as an inline constexpr uint32_t array plus a
+# table keyed by the path the engine asks for ("shaders/<name>.spv"), so the pipeline
+# can create its shader modules without touching the file system.
+
+if(NOT OUTPUT OR NOT SHADER_ROOT OR NOT SHADERS)
+	message(FATAL_ERROR "EmbedShaders.cmake needs OUTPUT, SHADER_ROOT and SHADERS")
+endif()
+
+set(arrays "")
+set(entries "")
+foreach(spv IN LISTS SHADERS)
+	file(READ "${spv}" hex HEX)
+	string(LENGTH "${hex}" hexLength)
+	math(EXPR remainder "${hexLength} % 8")
+	if(hexLength EQUAL 0 OR NOT remainder EQUAL 0)
+		message(FATAL_ERROR "${spv} is not a SPIR-V binary (size is not a multiple of 4)")
+	endif()
+
+	# SPIR-V is a stream of little-endian words, reorder each group of four bytes
+	string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u," words "${hex}")
+	# eight words per line; CMake regular expressions have no {n} repetition
+	set(word "0x........u,")
+	string(REGEX REPLACE "(${word}${word}${word}${word}${word}${word}${word}${word})" "\\1\n\t\t" words "${words}")
+	string(REGEX REPLACE "\n\t\t$" "" words "${words}")
+
+	file(RELATIVE_PATH relativePath "${SHADER_ROOT}" "${spv}")
+	string(MAKE_C_IDENTIFIER "${relativePath}" identifier)
+
+	string(APPEND arrays "\tinline constexpr uint32_t ${identifier}[] = {\n\t\t${words}\n\t};\n\n")
+	string(APPEND entries "\t\t{ \"${relativePath}\", ${identifier}, sizeof(${identifier}) },\n")
+endforeach()
+
+set(content "// Generated by cmake/EmbedShaders.cmake, do not edit.
+#pragma once
+
+//std
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace VulkanEngine::EmbeddedShaders {
+
+	struct Entry {
+		std::string_view path;
+		const uint32_t* code;
+		size_t size;
+	};
+
+${arrays}	inline constexpr Entry entries[] = {
+${entries}	};
+
+} // namespace VulkanEngine::EmbeddedShaders
+")
+
+# only touch the header when it changes so dependents are not rebuilt needlessly
+file(CONFIGURE OUTPUT "${OUTPUT}" CONTENT "${content}" @ONLY)